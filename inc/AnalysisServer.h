@@ -0,0 +1,75 @@
+#pragma once
+#include "Eval.h"
+#include "ThreadPool.h"
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define SERVER_DEFAULT_HASH_MB 16
+#define SERVER_DEFAULT_DEPTH 12 // Used when a search request gives no budget at all.
+#define SERVER_MAX_LINE (1 << 20) // Longer request lines close the connection.
+
+struct ServerSettings {
+    uint engines = ThreadPool::defaultThreadCount();
+    uint hashMegabytes = SERVER_DEFAULT_HASH_MB;
+    u64 maxMoveTime = 0; // Upper bound on every search's time in milliseconds, 0 for none.
+};
+
+// Long-running analysis server on a local TCP port or Unix socket. Clients send one JSON object
+// per line and get one JSON object per line back, tagged with the request's id:
+//   {"id": 1, "type": "search", "fen": "...", "moves": ["e2e4"], "depth": 12, "nodes": 0, "movetime": 0, "multipv": 1}
+//   {"id": 2, "type": "evaluate", "fens": ["...", "..."]}
+//   {"id": 3, "type": "moves", "fens": ["..."]}
+//   {"id": 4, "type": "cancel", "target": 1}
+// "fen" may be "startpos". Scores are from white's point of view, as {"cp": n} or {"mate": n}.
+// Searches are queued for a pool of engines whose hash tables stay warm between requests; a
+// cancelled search answers at once with its best move so far. Evaluations and move lists skip
+// that queue: a separate thread collects whatever arrived while it was busy and answers the
+// whole batch on one engine. {"type": "shutdown"} stops the server.
+class AnalysisServer {
+    public:
+        AnalysisServer(const ServerSettings& setSettings);
+        ~AnalysisServer();
+
+        bool listenTcp(uint port); // Binds to 127.0.0.1 only.
+        bool listenUnix(const std::string& path);
+        void serve(); // Accepts connections until a shutdown request or stop().
+        void stop();
+
+    private:
+        struct Job;
+        struct Connection;
+        struct CheapQuery;
+        struct SearchRequest;
+
+        void handleConnection(std::shared_ptr<Connection> connection);
+        void handleLine(std::shared_ptr<Connection> connection, const std::string& line);
+        void runSearch(std::shared_ptr<Connection> connection, std::shared_ptr<Job> job, const SearchRequest& request, uint worker);
+        void batchLoop();
+        void answerCheapQuery(const CheapQuery& query);
+        static bool loadPosition(Eval* engine, const std::string& fen, const std::vector<std::string>& moves, std::string& error);
+        static void send(Connection& connection, const std::string& line);
+
+        ServerSettings settings;
+        ThreadPool pool;
+        std::vector<Board*> boards;
+        std::vector<Eval*> engines;
+        intptr_t listener = -1;
+        std::string unixPath;
+        std::atomic<bool> stopping{false};
+        std::mutex connectionsMutex;
+        std::vector<std::shared_ptr<Connection>> connections;
+        std::vector<std::thread> connectionThreads;
+
+        // Cheap queries wait here for the batch thread, which has its own engine.
+        std::mutex batchMutex;
+        std::condition_variable batchReady;
+        std::vector<CheapQuery> batch;
+        std::thread batchThread;
+        Board batchBoard;
+        Eval* batchEngine;
+};
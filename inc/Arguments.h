@@ -0,0 +1,44 @@
+#pragma once
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+
+// Command line number parsing shared by the executables. The whole argument must be the number:
+// std::stoul throws on "abc" and quietly accepts "-1" or "5x", so these return false instead.
+inline bool parseCount(const char* text, unsigned long long& value) {
+    if (!std::isdigit((unsigned char)text[0])) { return false; };
+    char* end = nullptr;
+    errno = 0;
+    value = std::strtoull(text, &end, 10);
+    return *end == '\0' && errno == 0;
+}
+
+inline bool parseCount(const char* text, unsigned int& value) {
+    unsigned long long wide;
+    if (!parseCount(text, wide) || wide > UINT_MAX) { return false; };
+    value = (unsigned int)wide;
+    return true;
+}
+
+inline bool parseInteger(const char* text, int& value) {
+    if (!std::isdigit((unsigned char)text[text[0] == '-'])) { return false; };
+    char* end = nullptr;
+    errno = 0;
+    long wide = std::strtol(text, &end, 10);
+    if (*end != '\0' || errno != 0 || wide < INT_MIN || wide > INT_MAX) { return false; };
+    value = (int)wide;
+    return true;
+}
+
+// Plain decimals such as "10", "-2.5" or ".05"; no exponents, hex, inf or nan.
+inline bool parseDecimal(const char* text, double& value) {
+    const char* digits = text + (text[0] == '-');
+    if (!std::isdigit((unsigned char)digits[0]) && !(digits[0] == '.' && std::isdigit((unsigned char)digits[1]))) { return false; };
+    for (const char* c = digits; *c; c++) {
+        if (!std::isdigit((unsigned char)*c) && *c != '.') { return false; };
+    }
+    char* end = nullptr;
+    value = std::strtod(text, &end);
+    return *end == '\0';
+}
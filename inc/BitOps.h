@@ -1,4 +1,6 @@
+#pragma once
 #include <iostream>
+#include <random>
 #include <vector>
 #include <stdexcept>
 
@@ -6,6 +8,13 @@ class BitOps {
     public:
         static int countTrailingZeroes(unsigned long long num);
         static int countSetBits(unsigned long long num);
-        static unsigned long long generateMagicNumber();
+        static unsigned long long generateMagicNumber(std::mt19937_64& generator);
         static int findLS1B(unsigned long long num);
+        static void prefetch(const void* address);
+
+        // Set-wise attack generation: every target of every piece in the set at once.
+        static unsigned long long knightAttacks(unsigned long long knights);
+        static unsigned long long kingAttacks(unsigned long long kings);
+        static unsigned long long pawnAttacks(unsigned long long pawns, bool white);
+        static unsigned long long slidingAttacks(unsigned long long rooks, unsigned long long bishops, unsigned long long occupancy);
 };
\ No newline at end of file
@@ -1,13 +1,35 @@
+#pragma once
 #include "BitOps.h"
+#include <string>
+
+#define STARTING_FEN "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+#define RESULT_UNKNOWN 0 // Game result labels, as stored in PackedPosition::result.
+#define RESULT_WHITE_WIN 1
+#define RESULT_DRAW 2
+#define RESULT_BLACK_WIN 3
 
 using u64 = unsigned long long;
 using uint = unsigned int;
+using u16 = unsigned short;
+
+// Fixed 32-byte position record for bulk storage and the C API. Pieces are listed as 4-bit
+// engine piece indices in ascending square order of the occupancy bitboard.
+struct PackedPosition {
+    u64 occupancy;
+    unsigned char pieces[16];
+    unsigned char flags; // Bit 0: white to move; bits 1-4: castling rights in Board order.
+    unsigned char enPassantFile; // File + 1, or 0 for none.
+    unsigned char halfMoveClock;
+    unsigned char result; // Optional game result label: 0 unknown, 1 white win, 2 draw, 3 black win.
+    unsigned short fullMoveNumber;
+    short score; // Optional label in centipawns from white's point of view.
+};
+static_assert(sizeof(PackedPosition) == 32, "PackedPosition must stay 32 bytes");
 
 class Board {
     public:
         
         Board() {
-            std::cout << "initialising board" << std::endl;
             pieceLocations[0] =  0b11111111'11111111'00000000'00000000'00000000'00000000'11111111'11111111; // All Pieces
             pieceLocations[1] =  0b00000000'00000000'00000000'00000000'00000000'00000000'11111111'11111111; // White Pieces
             pieceLocations[2] =  0b00000000'00000000'00000000'00000000'00000000'00000000'00000000'00010000; // White King
@@ -23,16 +45,27 @@ class Board {
             pieceLocations[12] = 0b01000010'00000000'00000000'00000000'00000000'00000000'00000000'00000000; // Black Knights
             pieceLocations[13] = 0b10000001'00000000'00000000'00000000'00000000'00000000'00000000'00000000; // Black Rooks
             pieceLocations[14] = 0b00001000'00000000'00000000'00000000'00000000'00000000'00000000'00000000; // Black Queens
-            // Initialise Zobrist random numbers using LCG.
+            // Initialise Zobrist random numbers using SplitMix64.
             this->generateZobristPsuedoRandoms(8752137612383702536ULL);
-            std::cout << "initialised board" << std::endl;
+            this->zobristHash = this->calculateZobristHash();
         };
-        ~Board();
+        ~Board() = default;
+        // FEN input/output; the move clocks are optional so that EPD positions load too.
+        void loadFEN(std::string fen);
+        std::string toFEN();
+        bool enPassantCapturePossible(); // A pawn of the side to move stands next to the double-pushed pawn.
+        // The Zobrist key without an en passant file nobody can capture on, so that it does not depend
+        // on whether a FEN writes the square after every double push.
+        u64 positionKey();
+        // Packed records; pack throws std::invalid_argument above 32 pieces and unpack on a malformed record.
+        PackedPosition pack();
+        void unpack(const PackedPosition& packed);
         // zobrist hash
         void generateZobristPsuedoRandoms(u64 seed);
         u64 calculateZobristHash();
+        u64 zobristPiece(int piece, uint square) { return zobristPseudoRandoms[piece - (2 + (piece > 7)) + (square * 12)]; };
         
-        uint castlingRights = 0b0000;
+        uint castlingRights = 0b1111; // Bits from low to high: white short, white long, black short, black long.
         uint enPassantFiles = 0b00000000;
         
         u64 pieceLocations[15];
@@ -45,4 +78,5 @@ class Board {
         
         bool currentTurn = 1;
         uint turnsTaken = 0;
+        uint halfMoveClock = 0;
 };
\ No newline at end of file
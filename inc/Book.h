@@ -0,0 +1,43 @@
+#pragma once
+#include "Board.h"
+#include "MappedFile.h"
+#include <random>
+#include <vector>
+
+#define POLYGLOT_ENTRY_SIZE 16
+#define POLYGLOT_RANDOM_COUNT 781
+#define POLYGLOT_START_KEY 0x463B96181691FC9CULL // Key of the starting position in the Polyglot spec.
+
+struct BookEntry {
+    u64 key;
+    u16 move; // Polyglot encoding: to file/rank, from file/rank, promotion; castling as king takes rook.
+    u16 weight;
+    uint learn;
+};
+
+// Polyglot .bin opening book. The file is memory mapped and searched in place: entries are 16 big
+// endian bytes sorted by key, so a probe is a binary search that touches a handful of pages.
+class PolyglotBook {
+    public:
+        bool open(const std::string& path);
+        void close() { file.close(); };
+        bool isOpen() { return file.isOpen(); };
+        // The 781 Polyglot random constants, read as hex literals from any text file listing them
+        // in order (such as Polyglot's own source). Rejected unless they reproduce every test key in
+        // the spec, which between them cover castling, en passant and both king walks.
+        bool loadKeys(const std::string& path);
+        bool hasKeys() { return keysLoaded; };
+
+        u64 computeKey(Board* board);
+        std::vector<BookEntry> findEntries(u64 key);
+        u16 pickMove(Board* board); // Weighted by entry weight; returns NULL_MOVE when out of book.
+        static u16 toEngineMove(Board* board, u16 polyglotMove);
+
+    private:
+        BookEntry readEntry(size_t index);
+
+        MappedFile file;
+        u64 randoms[POLYGLOT_RANDOM_COUNT];
+        bool keysLoaded = false;
+        std::mt19937_64 generator{std::random_device{}()};
+};
@@ -0,0 +1,16 @@
+#pragma once
+#include <chrono>
+
+// Monotonic time in nanoseconds, for search deadlines and elapsed times.
+inline unsigned long long steadyClockNanoseconds() {
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline long long steadyClockMilliseconds() {
+    return (long long)(steadyClockNanoseconds() / 1000000);
+}
+
+// Seconds elapsed since an earlier steadyClockNanoseconds() reading.
+inline double secondsSince(unsigned long long startNanoseconds) {
+    return (double)(steadyClockNanoseconds() - startNanoseconds) / 1e9;
+}
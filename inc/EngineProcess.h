@@ -0,0 +1,38 @@
+#pragma once
+#include <string>
+
+// A UCI engine running as a child process, talked to a line at a time over its standard input
+// and output. The command runs through /bin/sh, or as a command line on Windows, so it may carry
+// arguments.
+class EngineProcess {
+    public:
+        EngineProcess() = default;
+        ~EngineProcess() { stop(); };
+        EngineProcess(const EngineProcess&) = delete;
+        EngineProcess& operator=(const EngineProcess&) = delete;
+
+        bool start(const std::string& command);
+        void stop(); // Sends quit, and kills the process if it has not exited a second later.
+        bool isRunning();
+        bool send(const std::string& line);
+        // Next output line without its line ending, waiting at most timeoutMs (negative for no
+        // limit). False on timeout or when the process has closed its output.
+        bool readLine(std::string& line, int timeoutMs);
+        // Reads until a line starting with prefix, keeping that line.
+        bool waitFor(const std::string& prefix, int timeoutMs, std::string* line = nullptr);
+
+    private:
+        bool takeLine(std::string& line);
+
+        std::string buffered;
+#ifdef _WIN32
+        void* process = nullptr;
+        void* input = nullptr;
+        void* output = nullptr;
+#else
+        int pid = -1;
+        int input = -1;
+        int output = -1;
+        bool reaped = false; // Exited and waited for, so its pid may already belong to another process.
+#endif
+};
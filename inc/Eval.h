@@ -1,10 +1,32 @@
+#pragma once
 #include "Board.h"
+#include "EvalWeights.h"
+#include "Magics.h"
+#include "Score.h"
+#include "Stats.h"
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <random>
+#include <string>
 
-#define TRANSPOSITION_CACHE_SIZE 0x222222
-#define INVALID_TRANSPOSITION_EVAL 10101010
-#define DEFAULT_VALUE_MODIFIER 1
-#define PAWN_CHAIN_VALUE 0.1
-#define PAWN_STACK_VALUE -0.1
+#define TRANSPOSITION_CACHE_SIZE (1 << 21) // Default number of entries, must be a power of two.
+#define EVAL_CACHE_SIZE (1 << 16) // Default number of static evaluation cache entries, also a power of two.
+#define MAX_SEARCH_PLY 128
+#define NULL_MOVE 0
+#define HISTORY_MAX 0x4000
+#define CAPTURE_ORDER_SCORE 1000000
+#define KILLER_ORDER_SCORE 900000
+#define COUNTER_ORDER_SCORE 800000
+#define NULL_WINDOW 1
+#define NULL_MOVE_MIN_DEPTH 3
+#define NULL_MOVE_REDUCTION 2
+#define LMR_MIN_DEPTH 3
+#define LMR_MIN_MOVES 3
+#define FUTILITY_MARGIN 200
+#define FIFTY_MOVE_PLIES 100 // Plies without a pawn move or capture after which the game is drawn.
+
+class Tablebases;
 
 struct MoveData {
     MoveData(int oldSq, int newSq) : oldSquare(oldSq), newSquare(newSq) {};
@@ -13,44 +35,81 @@ struct MoveData {
     int piece;
     int cPiece = -1;
     int pPiece = -1;
-    float score; // Move score is used to order the evaluation of moves.
+    bool enPassant = false; // Set by doMove so undoMove can restore the captured pawn.
+    int score; // Move score is used to order the evaluation of moves.
+    // Packs the move into 16 bits: from (6), to (6), promotion (B, N, R, Q => 1..4).
+    u16 encode() {
+        u16 promotion = pPiece > 0 ? pPiece - (pPiece > 7 ? 10 : 3) : 0;
+        return oldSquare | (newSquare << 6) | (promotion << 12);
+    };
+    bool isQuiet() { return cPiece <= 0 && pPiece <= 0; };
 };
 
 struct KillerMoves
 {
-    void addNewKiller(MoveData* move) {
-        first = second;
-        second = move;
+    void addNewKiller(u16 move) {
+        if (move == first) { return; };
+        second = first;
+        first = move;
     };
-    MoveData* first = 0;
-    MoveData* second = 0;
-    uint mPly;
+    u16 first = NULL_MOVE;
+    u16 second = NULL_MOVE;
 };
 
-enum NodeType {ALPHA, BETA, EXACT}; 
+enum NodeType : unsigned char {ALPHA, BETA, EXACT};
 
+// Selective search techniques, each of which can be toggled at runtime for testing.
+struct SearchOptions {
+    bool nullMovePruning = true;
+    bool lateMoveReductions = true;
+    bool futilityPruning = true;
+};
+
+// 16 bytes, so four entries share a cache line.
 struct Transposition {
-    void init(u64 addKey, MoveData* addRefutation, uint addDepth, float addEval, NodeType addType) {
-        key = addKey; refutation = addRefutation; depth = addDepth; eval = addEval; type = addType;
+    void init(u64 addKey, u16 addRefutation, uint addDepth, Score addEval, NodeType addType) {
+        key = addKey; refutation = addRefutation; depth = (unsigned char)addDepth; eval = addEval; type = addType;
     };
-    u64 key;
-    MoveData* refutation;
-    uint depth;
-    float eval;
+    u64 key = 0;
+    u16 refutation; // Encoded best move, since the searched MoveData objects are freed with their node.
+    Score eval; // Mate and table win distances are counted from this node, see Scores::toTransposition.
+    unsigned char depth;
     NodeType type;
 };
+static_assert(sizeof(Transposition) == 16, "Transposition entries should stay 16 bytes");
 
-struct HeatMaps {
-    static constexpr float knight[64] = {
-        0.250, 0.375, 0.500, 0.500, 0.500, 0.500, 0.375, 0.250,
-        0.375, 0.625, 0.750, 0.750, 0.750, 0.750, 0.625, 0.375,
-        0.500, 0.750, 1.000, 1.000, 1.000, 1.000, 0.750, 0.500,
-        0.500, 0.750, 1.000, 1.000, 1.000, 1.000, 0.750, 0.500,
-        0.500, 0.750, 1.000, 1.000, 1.000, 1.000, 0.750, 0.500,
-        0.500, 0.750, 1.000, 1.000, 1.000, 1.000, 0.750, 0.500,
-        0.375, 0.625, 0.750, 0.750, 0.750, 0.750, 0.625, 0.375,
-        0.250, 0.375, 0.500, 0.500, 0.500, 0.500, 0.375, 0.250,
-    };
+// Limits for a root search; zero means unlimited.
+struct SearchLimits {
+    uint depth = 0;
+    u64 nodes = 0;
+    u64 moveTime = 0; // Milliseconds, not enforced while pondering.
+    uint multiPV = 1; // Number of best root moves to search with exact scores.
+};
+
+// One root move of a MultiPV search, with the depth its score comes from.
+struct SearchLine {
+    u16 move = NULL_MOVE;
+    Score score = 0; // From white's point of view.
+    uint depth = 0;
+};
+
+struct SearchResult {
+    u16 bestMove = NULL_MOVE;
+    Score score = 0; // From white's point of view.
+    uint depth = 0; // Last completed iteration of the best line.
+    std::vector<SearchLine> lines; // Best first; lines an aborted iteration did not reach keep their older depth.
+    u64 nodes = 0;
+    u64 time = 0; // Milliseconds since the search started.
+};
+
+// Counts behind the linear evaluation, white's minus black's. Shared with the tuner so that both
+// always see the same terms.
+struct EvalTerms {
+    int material[7] = {}; // Indexed like Eval::PIECEVALUES.
+    int pawnChains = 0;
+    int pawnStacks = 0;
+    int knightCount = 0;
+    unsigned char knights[20]; // Square from the owner's side, plus 64 for black knights.
 };
 
 class Eval{
@@ -60,73 +119,139 @@ class Eval{
 
         Eval(Board* setBoard) : board(setBoard) {
             // Creating initial position
-            std::cout << "initiliasing evaluator" << std::endl;
             this->setBitboards();
             
             // Initialise lookup tables for piece moves.
-            // initMagicLookupTable();
             initKingLookupTable();
             initKnightLookupTable();
             initSliderAttacksLookupTable(BISHOP);
             initSliderAttacksLookupTable(ROOK);
-            
-            
-            std::cout << "initiliased evaluator" << std::endl;
+            initBetweenLookupTable();
+            transpositionCache.resize(TRANSPOSITION_CACHE_SIZE);
+            transpositionMask = TRANSPOSITION_CACHE_SIZE - 1;
+            evalCache.resize(EVAL_CACHE_SIZE);
+            evalCacheMask = EVAL_CACHE_SIZE - 1;
         };
-        ~Eval();
+        ~Eval() = default;
 
         void setBitboards();
         static u64 initBlockersPermutation(uint index, uint relevantBits, u64 mask);
 
         // gamestate moves
          std::vector<MoveData*> findKingMoves(uint square);
-         std::vector<MoveData*> findPawnMoves(u64 bitboard);
-         std::vector<MoveData*> findBishopMoves(u64 bitboard, bool isQueen = false);
-         std::vector<MoveData*> findKnightMoves(u64 bitboard);
-         std::vector<MoveData*> findRookMoves(u64 bitboard, bool isQueen = false);
+         std::vector<MoveData*> findPawnMoves(u64 bitboard, u64 targets = ~0ULL);
+         std::vector<MoveData*> findBishopMoves(u64 bitboard, bool isQueen = false, u64 targets = ~0ULL);
+         std::vector<MoveData*> findKnightMoves(u64 bitboard, u64 targets = ~0ULL);
+         std::vector<MoveData*> findRookMoves(u64 bitboard, bool isQueen = false, u64 targets = ~0ULL);
          std::vector<MoveData*> findPseudoLegalMoves();
+         std::vector<MoveData*> findEvasionMoves();
          std::vector<MoveData*> findLegalMoves(std::vector<MoveData*> plm);
+         static void releaseMoves(std::vector<MoveData*>& moves);
+         int findCapturedPiece(int square);
         static bool compareByScore(MoveData* a, MoveData* b) {
-            return a->score < b->score;
+            return a->score > b->score;
         };
-        u64 findAttackedSquares();
+        u64 findAttackedSquares(bool byWhite, u64 occupancy);
         u64 findAttacksThisSquare(uint square);
+        u64 findAttackersOfSquare(uint square, bool byWhite, u64 occupancy);
+        u64 lookupBishopAttacks(uint square, u64 occupancy);
+        u64 lookupRookAttacks(uint square, u64 occupancy);
 
         // verify legal moves
 
         // find magic numbers 
-        u64 initMagicAttacks(uint square, MagicPiece piece);
+        u64 initMagicAttacks(uint square, MagicPiece piece, uint indexBits, std::mt19937_64& generator, u64 tries);
         u64 initBishopAttacksForPosition(uint square, u64 blockers);
         u64 initRookAttacksForPosition(uint square, u64 blockers);
         uint calculateMagicHash(uint square, MagicPiece bishop, u64 occupancy);
 
         // init basic lookup tables
-        void initMagicLookupTable();
         void initKingLookupTable();
         void initKnightLookupTable();
         void initSliderAttacksLookupTable(MagicPiece piece);
+        void initBetweenLookupTable();
 
         static constexpr int PIECEVALUES[7] = {0, 0, 1, 3, 3, 5, 9};
-        float evaluatePosition();
-        float evalAlphaBeta(uint depth, float alpha, float beta);
+        Score evaluatePosition();
+        static void findEvalTerms(Board* board, EvalTerms& terms);
+        static float weighTerms(const EvalWeights& weights, const EvalTerms& terms);
+        SearchResult search(SearchLimits limits);
+        bool searchLimitReached();
+        void stopSearch();
+        void ponderHit();
+        std::vector<u16> findPrincipalVariation(uint maxLength, u16 firstMove = NULL_MOVE);
+        MoveData* findLegalMove(u16 code);
+        MoveData* findSanMove(const std::string& san);
+        static u16 stringToMove(std::string text);
+        void resetGameHistory();
+        bool isRepetition();
+        bool isDrawByRule(); // Fifty-move rule or repetition.
+        bool isInCheck();
+        bool isZugzwangProne();
+        bool hasNonPawnMaterial();
 
         void addTransposition(Transposition tp);
-        float checkTransposition(u64 hashKey, uint depth, float alpha, float beta);
+        Score checkTransposition(u64 hashKey, uint depth, Score alpha, Score beta); // SCORE_NONE without a usable entry.
+        void prefetchTransposition(u64 hashKey);
+        void resizeTranspositionCache(uint megabytes);
+        void clearTranspositionCache();
+        void resizeEvalCache(uint megabytes); // Zero turns the cache off.
+        void clearEvalCache();
+        double evalCacheHitRate() const;
+        static std::string moveToString(u16 move);
 
         void doMove(MoveData* move);
         void undoMove(MoveData* move);
+        void doNullMove();
+        void undoNullMove();
         void revertBoardRights();
+        static uint castlingRightsKept(int square);
         std::vector<MoveData*> addPawnMove(MoveData* move);
         bool checksAreValid();
         void calculateMoveOrderScore(MoveData* moveData);
+        void updateQuietHeuristics(MoveData* move, uint depth);
+        void clearSearchHeuristics();
 
-        uint currentDepth = 0;
+        uint currentDepth = 0; // Ply from the root of the current search.
         uint halfTurn = 0;
-        Transposition transpositionCache[TRANSPOSITION_CACHE_SIZE];
-        KillerMoves killers[32];
+        std::vector<Transposition> transpositionCache;
+        u64 transpositionMask;
+        // Static evaluations by Zobrist key. Each slot is one word, the key's upper 48 bits over the
+        // score, so an entry can never be read half written.
+        std::vector<u64> evalCache;
+        u64 evalCacheMask;
+        u64 evalCacheProbes = 0; // Since the last search started.
+        u64 evalCacheHits = 0;
+        KillerMoves killers[MAX_SEARCH_PLY];
+        int historyTable[2][64][64] = {}; // Butterfly history indexed by [colour][from][to].
+        u16 counterMoves[64][64] = {}; // Refutation of the previous move, indexed by its [from][to].
+        u16 moveStack[MAX_SEARCH_PLY] = {}; // Encoded move played at each ply of the current line.
+        SearchOptions searchOptions;
+        EvalWeights weights;
+        uint nullMoveDisabled = 0; // Non-zero while verifying a null move fail-high.
+        u64 nodes = 0;
+        SearchStats stats; // Only updated when built with MYCHESS_STATS.
+        u64 nodeLimit = 0;
+        bool searchAborted = false;
+        u16 rootBestMove = NULL_MOVE;
+        std::vector<u16> excludedRootMoves; // Lines already found by earlier MultiPV passes.
+
+        // Search control, written from other threads while a search runs.
+        std::atomic<bool> stopRequested{false};
+        std::atomic<bool> pondering{false};
+        std::atomic<long long> deadline{0}; // steady_clock nanoseconds, 0 when untimed.
+        u64 searchStartTime = 0;
+        std::atomic<u64> searchMoveTime{0}; // Read by ponderHit on the input thread.
+        std::function<void(const SearchResult&)> onIteration; // Called after every iteration that finished its best line.
 
         std::vector<int> enPassantHistory;
         std::vector<int> castlingRightsHistory;
+        std::vector<u64> hashHistory; // Key before every move made, game moves included, for repetitions.
+        std::vector<uint> halfMoveClockHistory;
+        std::vector<uint> pliesFromNullHistory;
+        uint pliesFromNull = 0; // Moves made since the last null move or history reset.
+
+        Tablebases* tablebases = nullptr; // Optional endgame tables, probed once few pieces remain.
 
         Board* board;
         u64 pawnMasks[2]; // Bit Masks for Pawns
@@ -135,140 +260,11 @@ class Eval{
         u64 diagonalMasks[64]; // Bit Masks for Bishops
         u64 kingMovesTable[64]; // Lookup Table for King Moves
         u64 knightMovesTable[64]; // Lookup Table for Knight Moves
-        u64 bishopMagics[64] = {
-            2468047380310671617,
-            13585776195411976,
-            4578369138066688,
-            28187086540507136,
-            144414530116517924,
-            109249812066476032,
-            900791411448742952,
-            2882444502504572992,
-            35326139695176,
-            9227893234208899585,
-            2550871304972288,
-            18041972216823824,
-            565157835056192,
-            4611721789133817856,
-            5764929698463353106,
-            9223407358666345732,
-            9817847213576421632,
-            4504047111438449,
-            2308099414448930834,
-            2251843302899713,
-            9228438604185927712,
-            9147946541268992,
-            1169247126558868018,
-            5188218258624350213,
-            2322529472549120,
-            290408593626112,
-            293903873398492160,
-            18018796858020368,
-            2351161582191394816,
-            74945461345099776,
-            633908723451905,
-            4612108370512970816,
-            1143766971057216,
-            12396160345160294785,
-            145245494619218432,
-            2323892613574819984,
-            37189889887969408,
-            9227893263567438850,
-            13515201223606545,
-            72199439729099012,
-            1226106133496760578,
-            145205093206016,
-            580983078005639168,
-            4611967776947439624,
-            2017902973120708864,
-            9025345525121296,
-            10177655219421256,
-            5481445965296636424,
-            167267770826752,
-            9062179400057344,
-            54343646015660032,
-            54060927368298880,
-            576470785653474852,
-            7028016823513776384,
-            1236255709369991296,
-            9232381453470345352,
-            10525477486739982464,
-            4630263530134855680,
-            36099174625839140,
-            2350879005491724800,
-            4900479894960546818,
-            2344433802610960,
-            432636395929076740,
-            9224515668552188544,
-        };
-        u64 bishopAttacks[64][512];
-        u64 rookMagics[64] = {
-            612489620193542176,
-            594545520093958144,
-            72066682473947136,
-            9835879178497426560,
-            36033195199725571,
-            6485194459134382088,
-            252203778181169408,
-            36031545936520448,
-            1548122035618868,
-            1747537667788112000,
-            648799958758080771,
-            562984615157824,
-            1775262712482562192,
-            144537950397400064,
-            25333306249791492,
-            27162336879968384,
-            36031820680273920,
-            141838073790497,
-            576479445158731776,
-            4614010386143781377,
-            141287378387968,
-            564053760541696,
-            216194772367843984,
-            74311592879129756,
-            5062363196711550976,
-            4580574033904384,
-            288512130302353408,
-            8806835683456,
-            11529232659729875200,
-            4935949591792189568,
-            2594117795328295489,
-            1297054843214516484,
-            1157478155678646404,
-            576601627239137281,
-            16149908332478472320,
-            4503633995501696,
-            46161930548675712,
-            36591757718193152,
-            4630544859063648768,
-            162200509816504388,
-            468444732138225700,
-            7223773974369411072,
-            576495937766621200,
-            2468271663515762696,
-            2325546395291484164,
-            563018740137992,
-            9011605891252480,
-            6935553461345976340,
-            3468053471521966592,
-            70373048590592,
-            3243014081611825536,
-            580964422865387648,
-            1188954699806572672,
-            9024809696495617,
-            72339077605885184,
-            141854189045248,
-            72128581811470337,
-            4776349154683129985,
-            288265560726192385,
-            4504703702933509,
-            281492290798097,
-            54606216419610882,
-            2311753986174108705,
-            2305861152296411394,
-        };
-        u64 rookAttacks[64][4096];
+        u64 betweenMasks[64][64]; // Squares strictly between two aligned squares
+        u64 bishopAttacks[MAGIC_BISHOP_TABLE_SIZE]; // Every square's table back to back, see Magics.h.
+        uint bishopOffsets[64];
+        u64 rookAttacks[MAGIC_ROOK_TABLE_SIZE];
+        uint rookOffsets[64];
         static constexpr uint relevantBitsBishop[64] = {
             6, 5, 5, 5, 5, 5, 5, 6,
             5, 5, 5, 5, 5, 5, 5, 5,
@@ -0,0 +1,19 @@
+#pragma once
+
+// Evaluation weights in pawns. This file is written by the texelTuner tool; edit it by hand only
+// to seed a new tuning run.
+struct EvalWeights {
+    float pieceValues[7] = {0.000f, 0.000f, 1.000f, 3.000f, 3.000f, 5.000f, 9.000f}; // Indexed like Eval::PIECEVALUES.
+    float pawnChain = 0.100f; // Per pawn defended by a friendly pawn.
+    float pawnStack = -0.100f; // Per pawn with a friendly pawn behind it on the same file.
+    float knightSquares[64] = { // Added to a knight's value, indexed from its owner's side of the board.
+        -0.375f, -0.312f, -0.250f, -0.250f, -0.250f, -0.250f, -0.312f, -0.375f,
+        -0.312f, -0.188f, -0.125f, -0.125f, -0.125f, -0.125f, -0.188f, -0.312f,
+        -0.250f, -0.125f, 0.000f, 0.000f, 0.000f, 0.000f, -0.125f, -0.250f,
+        -0.250f, -0.125f, 0.000f, 0.000f, 0.000f, 0.000f, -0.125f, -0.250f,
+        -0.250f, -0.125f, 0.000f, 0.000f, 0.000f, 0.000f, -0.125f, -0.250f,
+        -0.250f, -0.125f, 0.000f, 0.000f, 0.000f, 0.000f, -0.125f, -0.250f,
+        -0.312f, -0.188f, -0.125f, -0.125f, -0.125f, -0.125f, -0.188f, -0.312f,
+        -0.375f, -0.312f, -0.250f, -0.250f, -0.250f, -0.250f, -0.312f, -0.375f,
+    };
+};
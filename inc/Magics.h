@@ -0,0 +1,66 @@
+#pragma once
+
+// Magic multipliers for the slider attack tables. This file is written by the magicFinder tool,
+// which verifies every entry exhaustively. Index bits may be below the relevant occupancy bits
+// where a magic for a smaller table was found.
+#define MAGIC_BISHOP_TABLE_SIZE 5248
+#define MAGIC_ROOK_TABLE_SIZE 102400
+
+struct Magics {
+    static constexpr unsigned long long bishop[64] = {
+        0x2240440420404101ULL, 0x0030443104202008ULL, 0x00104400A2200500ULL, 0x0064240180800800ULL,
+        0x0201104000000024ULL, 0x0184222010002000ULL, 0x0C80410420200428ULL, 0x00C0404050082001ULL,
+        0x0000202102020048ULL, 0x801010014A408201ULL, 0x0009100102002800ULL, 0x0040191401080010ULL,
+        0x0002020210002440ULL, 0x4000208884400800ULL, 0x5001250450020912ULL, 0x3000004108011000ULL,
+        0x8840000608480100ULL, 0x0010006830210071ULL, 0x2008043048840012ULL, 0x0008000A2028C001ULL,
+        0x8012000422010020ULL, 0x0020800248044000ULL, 0x103A001111300232ULL, 0x4004288100880400ULL,
+        0x0008405408311100ULL, 0x0001082005101400ULL, 0x0414280404074C00ULL, 0x0040040012009210ULL,
+        0x20A1010084104000ULL, 0x010A42800100A000ULL, 0x0002408960480801ULL, 0x0004AC8100240401ULL,
+        0x0004104000040440ULL, 0xAC08022800102181ULL, 0x0204040200012200ULL, 0x2040200500480090ULL,
+        0x0084200200022080ULL, 0x8010100820284402ULL, 0x0030040100004111ULL, 0x100100448842020CULL,
+        0x1104010840008902ULL, 0x0000841032000800ULL, 0x08101108010A0800ULL, 0x4001004204800808ULL,
+        0x1C01081010108100ULL, 0x0020108102000110ULL, 0x0024288604000048ULL, 0x4C12021041011208ULL,
+        0x0000982110100000ULL, 0x0020320110080200ULL, 0x00C1114214902000ULL, 0x00C0102084040180ULL,
+        0x0800092012440624ULL, 0x61888810A1020100ULL, 0x11281004888C0080ULL, 0x8020020445012888ULL,
+        0x9212020200820880ULL, 0x4042002602226000ULL, 0x0080400210420824ULL, 0x20A0000000420200ULL,
+        0x4402008028112402ULL, 0x0008544008010910ULL, 0x0601088288420404ULL, 0x8004102081140280ULL,
+    };
+    static constexpr unsigned int bishopBits[64] = {
+        6, 5, 5, 5, 5, 5, 5, 6,
+        5, 5, 5, 5, 5, 5, 5, 5,
+        5, 5, 7, 7, 7, 7, 5, 5,
+        5, 5, 7, 9, 9, 7, 5, 5,
+        5, 5, 7, 9, 9, 7, 5, 5,
+        5, 5, 7, 7, 7, 7, 5, 5,
+        5, 5, 5, 5, 5, 5, 5, 5,
+        6, 5, 5, 5, 5, 5, 5, 6,
+    };
+    static constexpr unsigned long long rook[64] = {
+        0x0880001080400020ULL, 0x0840400020001000ULL, 0x0100084411002000ULL, 0x8880100008000480ULL,
+        0x0080040008008003ULL, 0x5A000A0024095008ULL, 0x0380020001800100ULL, 0x0080028008412500ULL,
+        0x0005800240008434ULL, 0x1840804000200080ULL, 0x0901002000104103ULL, 0x0002000812002040ULL,
+        0x18A3000800850090ULL, 0x0201808006000400ULL, 0x005A008200014804ULL, 0x0060800061000080ULL,
+        0x008002C000422000ULL, 0x0000810040010021ULL, 0x0800110045002000ULL, 0x4008420008102201ULL,
+        0x0000808008000400ULL, 0x0002010100080400ULL, 0x0300140001482290ULL, 0x010802000041049CULL,
+        0x464120818000C000ULL, 0x0010460200288300ULL, 0x0401004100102000ULL, 0x0000080280500080ULL,
+        0xA000100500080100ULL, 0x4480040080020080ULL, 0x2400286400100241ULL, 0x1200108200005104ULL,
+        0x1010304000800084ULL, 0x0800802000804001ULL, 0xE020001000802080ULL, 0x0010000800801080ULL,
+        0x00A4000800800480ULL, 0x0082000280800400ULL, 0x4043000401000200ULL, 0x024040811A000044ULL,
+        0x0680400080008024ULL, 0x6440002810002000ULL, 0x0800200041090010ULL, 0x2241100021050008ULL,
+        0x20460020100A0004ULL, 0x0002001004020008ULL, 0x0020040200010100ULL, 0x6040092080420014ULL,
+        0x3021004200208A00ULL, 0x0000400100902100ULL, 0x2D01802000100180ULL, 0x0810001084080080ULL,
+        0x1080040008008080ULL, 0x0020100440200801ULL, 0x0101000200140500ULL, 0x00008104008C4600ULL,
+        0x0100409021068001ULL, 0x4249004000201081ULL, 0x040020000C104101ULL, 0x0010010110082005ULL,
+        0x0001000408000211ULL, 0x00C2001084381102ULL, 0x2015000092004421ULL, 0x2000108044002102ULL,
+    };
+    static constexpr unsigned int rookBits[64] = {
+        12, 11, 11, 11, 11, 11, 11, 12,
+        11, 10, 10, 10, 10, 10, 10, 11,
+        11, 10, 10, 10, 10, 10, 10, 11,
+        11, 10, 10, 10, 10, 10, 10, 11,
+        11, 10, 10, 10, 10, 10, 10, 11,
+        11, 10, 10, 10, 10, 10, 10, 11,
+        11, 10, 10, 10, 10, 10, 10, 11,
+        12, 11, 11, 11, 11, 11, 11, 12,
+    };
+};
@@ -0,0 +1,27 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Read-only memory mapping of a whole file. Pages come from the OS page cache, so every process
+// mapping the same file shares one copy and nothing is read until it is touched.
+class MappedFile {
+    public:
+        MappedFile() = default;
+        ~MappedFile() { close(); };
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool open(const std::string& path);
+        void close();
+        bool isOpen() { return data != nullptr; };
+        const unsigned char* bytes() { return (const unsigned char*)data; };
+        size_t size() { return length; };
+
+    private:
+        void* data = nullptr;
+        size_t length = 0;
+#ifdef _WIN32
+        void* fileHandle = nullptr;
+        void* mappingHandle = nullptr;
+#endif
+};
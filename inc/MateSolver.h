@@ -0,0 +1,65 @@
+#pragma once
+#include "Eval.h"
+#include <vector>
+
+#define MATE_SOLVER_DEFAULT_HASH_MB 16
+#define MATE_SOLVER_INFINITY 0x3FFFFFFFu
+#define MATE_SOLVER_MAX_PLY 256 // Deeper lines are treated as failed attacks.
+
+struct MateResult {
+    bool proven = false; // A forced mate was found.
+    bool disproven = false; // No mate exists by checking moves alone.
+    u16 move = NULL_MOVE;
+    // Length of the proof's main line. It is an upper bound on the distance to mate, not always the
+    // shortest mate.
+    uint plies = 0;
+    std::vector<u16> pv;
+    u64 nodes = 0;
+    u64 time = 0; // Milliseconds.
+};
+
+// Depth-first proof-number search for forced mates by the side to move. The attacker only plays
+// checks, the defender every legal reply, and proof and disproof numbers decide which branch is
+// expanded next, so narrow forcing lines are followed far deeper than a full-width search can.
+// Numbers are kept as phi/delta from the side to move: phi is the proof number where the
+// attacker moves and the disproof number where the defender does.
+class MateSolver {
+    public:
+        MateSolver(Eval* setEngine, uint hashMegabytes = MATE_SOLVER_DEFAULT_HASH_MB);
+
+        // Searches until the root is proven or disproven, or a limit (zero for none) runs out.
+        // Stops early when the engine's stopRequested is set.
+        MateResult solve(u64 nodeLimit = 0, u64 moveTime = 0);
+        void resize(uint megabytes);
+        void clear();
+
+        Eval* engine;
+
+    private:
+        // Four entries to a bucket; within a bucket the entry with the least work is replaced.
+        struct Entry {
+            u64 key = 0;
+            uint phi;
+            uint delta;
+            uint work; // Nodes spent below the entry, log2, so a cheap leaf never evicts a large proof.
+            u16 distance; // Plies to mate along the proof, once phi or delta is zero.
+            u16 unused;
+        };
+
+        void search(uint ply, uint thresholdPhi, uint thresholdDelta);
+        std::vector<MoveData*> generateMoves(bool attacking);
+        bool lookup(u64 key, uint& phi, uint& delta, uint& distance);
+        void store(u64 key, uint phi, uint delta, uint distance, u64 work);
+        bool limitReached();
+        std::vector<u16> findProofLine(uint maxLength);
+
+        std::vector<Entry> table;
+        u64 bucketMask = 0;
+        std::vector<u64> path; // Keys of the positions on the current line, for repetitions.
+        bool attacker = true;
+        bool aborted = false;
+        bool truncated = false; // Some line reached MATE_SOLVER_MAX_PLY.
+        u64 nodes = 0;
+        u64 nodeLimit = 0;
+        u64 deadline = 0; // steady_clock nanoseconds, 0 when untimed.
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include "Eval.h"
+#include "ThreadPool.h"
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#define PERFT_SPLIT_DEPTH 4 // Subtrees at least this deep are split into a task per move.
+
+// Subtree counts shared by every perft thread without locks. Each entry stores the count and the
+// count XORed with its key, so a torn write just reads back as a miss.
+class PerftTable {
+    public:
+        void resize(uint megabytes);
+        void clear();
+        bool probe(u64 hash, uint depth, u64& count);
+        void store(u64 hash, uint depth, u64 count);
+
+    private:
+        struct Entry {
+            std::atomic<u64> check{0};
+            std::atomic<u64> count{0};
+        };
+        static u64 key(u64 hash, uint depth);
+
+        std::unique_ptr<Entry[]> entries;
+        u64 mask = 0;
+};
+
+// Parallel perft: root moves, and every subtree of at least PERFT_SPLIT_DEPTH, become tasks on a
+// work-stealing pool. Positions travel between workers as packed records, and each worker
+// searches with its own Board/Eval pair.
+class Perft {
+    public:
+        Perft(uint threads, uint hashMegabytes);
+        ~Perft();
+
+        // Leaf count below the position; divide receives the count under each root move. Errors
+        // from the worker tasks are rethrown here once every task has finished.
+        u64 run(const std::string& fen, uint depth, std::vector<std::pair<u16, u64>>* divide = nullptr);
+        static u64 count(Eval* engine, uint depth, PerftTable* table);
+        PerftTable table;
+
+    private:
+        void split(uint worker, const PackedPosition& position, uint depth, std::atomic<u64>* total);
+        void splitTask(uint worker, const PackedPosition& position, uint depth, std::atomic<u64>* total);
+
+        WorkStealingPool pool;
+        std::vector<Board*> boards;
+        std::vector<Eval*> engines;
+        Board rootBoard;
+        Eval* rootEngine;
+        std::mutex errorMutex;
+        std::exception_ptr error; // The first task failure of the current run.
+        std::atomic<bool> failed{false}; // Remaining tasks are skipped once one has failed.
+};
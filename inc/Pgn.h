@@ -0,0 +1,38 @@
+#pragma once
+#include "Eval.h"
+#include "MappedFile.h"
+#include <string>
+#include <vector>
+
+// One game's text, tags and movetext, pointing into the reader's mapping.
+struct PgnGame {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    u64 offset = 0; // Byte offset in the file, for error messages.
+};
+
+// Splits a memory mapped PGN file into games without copying or parsing them, so one thread can
+// feed many replaying workers. A game ends where a tag line follows its movetext.
+class PgnReader {
+    public:
+        bool open(const std::string& path);
+        void close() { file.close(); position = 0; };
+        bool isOpen() { return file.isOpen(); };
+        bool next(PgnGame& game); // False at the end of the file.
+        u64 bytesRead() { return position; };
+        u64 size() { return file.size(); };
+
+    private:
+        MappedFile file;
+        size_t position = 0;
+};
+
+namespace Pgn {
+    // Value of the first tag with this name; false when there is none.
+    bool tagValue(const PgnGame& game, const std::string& name, std::string& value);
+    uint parseResult(const std::string& text); // "1-0", "1/2-1/2" or "0-1" to a RESULT_ label.
+    // Plays the movetext from the game's start position (its FEN tag, if any) and collects the key
+    // of every position reached, the start included, until maxPlies moves have been played (zero
+    // for no limit). False with a message on a move that is illegal or cannot be read.
+    bool replay(Eval* engine, const PgnGame& game, uint maxPlies, std::vector<u64>& keys, uint& result, std::string& error);
+}
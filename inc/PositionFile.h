@@ -0,0 +1,46 @@
+#pragma once
+#include "Board.h"
+#include "MappedFile.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+#define POSITION_FILE_MAGIC "MCPOS001"
+#define POSITION_FILE_HEADER_SIZE 16 // Magic, then the record size as a little-endian u32 and 4 reserved bytes.
+#define POSITION_WRITER_BUFFER (1 << 15) // Records buffered before each sequential write (1 MB).
+
+// Appends PackedPosition records to a file through a large buffer, so disk writes stay big and
+// sequential however small the batches are. Not thread safe; guard shared writers with a mutex.
+class PositionWriter {
+    public:
+        PositionWriter() = default;
+        ~PositionWriter() { close(); };
+        PositionWriter(const PositionWriter&) = delete;
+        PositionWriter& operator=(const PositionWriter&) = delete;
+
+        bool open(const std::string& path);
+        bool write(const PackedPosition* records, size_t count);
+        bool flush();
+        bool close();
+        u64 written() { return recordCount; };
+
+    private:
+        std::ofstream output;
+        std::vector<PackedPosition> buffer;
+        u64 recordCount = 0;
+};
+
+// Zero-copy view of a position file: records are read straight out of the mapping. The count
+// comes from the file size, so a file cut short by an interrupted writer is still readable.
+class PositionReader {
+    public:
+        bool open(const std::string& path);
+        void close() { file.close(); count = 0; };
+        size_t size() { return count; };
+        const PackedPosition* records() { return (const PackedPosition*)(file.bytes() + POSITION_FILE_HEADER_SIZE); };
+        const PackedPosition& operator[](size_t index) { return records()[index]; };
+
+    private:
+        MappedFile file;
+        size_t count = 0;
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include "Board.h"
+#include "MappedFile.h"
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define POSITION_INDEX_MAGIC "MCIDX001"
+#define POSITION_INDEX_HEADER_SIZE 16 // Magic, then the record size as a little-endian u32 and 4 reserved bytes.
+#define POSITION_INDEX_DEFAULT_MEMORY_MB 1024
+
+// Game results from one position, keyed by Board::positionKey.
+struct PositionStats {
+    u64 key;
+    uint whiteWins;
+    uint draws;
+    uint blackWins;
+    uint reserved;
+    u64 games() const { return (u64)whiteWins + draws + blackWins; };
+};
+static_assert(sizeof(PositionStats) == 24, "PositionStats must stay 24 bytes");
+
+// Aggregates position statistics from many threads into a sorted index file. Each worker counts
+// into its own buffer; a full buffer is sorted, its duplicate keys merged, and written out as a
+// sorted run, so memory stays bounded however large the database is. finish() merges the runs.
+class PositionIndexBuilder {
+    public:
+        PositionIndexBuilder(const std::string& setPath, uint workers, size_t memoryBytes);
+        ~PositionIndexBuilder();
+
+        // Counts one game's positions for the given worker; positions repeated within the game count once.
+        bool addGame(uint worker, std::vector<u64>& keys, uint result);
+        bool finish(); // Writes the index and removes the runs.
+        u64 positions() { return positionCount; }; // Distinct positions, once finished.
+
+    private:
+        bool spill(std::vector<PositionStats>& buffer);
+        static void combine(std::vector<PositionStats>& buffer);
+
+        std::string path;
+        size_t bufferCapacity;
+        std::vector<std::vector<PositionStats>> buffers;
+        std::mutex runsMutex;
+        std::vector<std::string> runs;
+        u64 positionCount = 0;
+};
+
+// Read-only view of an index file, searched in place with a binary search over the mapping.
+class PositionIndex {
+    public:
+        bool open(const std::string& path);
+        void close() { file.close(); count = 0; };
+        size_t size() { return count; };
+        bool find(u64 key, PositionStats& stats); // False for a position in no game.
+
+    private:
+        const PositionStats* records() { return (const PositionStats*)(file.bytes() + POSITION_INDEX_HEADER_SIZE); };
+
+        MappedFile file;
+        size_t count = 0;
+};
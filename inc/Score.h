@@ -0,0 +1,37 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+
+// Search scores in centipawns from white's point of view. A mate scores SCORE_MATE less its
+// distance in plies from the root, so shorter mates are preferred; other scores beyond
+// SCORE_EVAL_MAX (endgame table wins) are graded by distance the same way.
+using Score = int16_t;
+
+#define SCORE_MATE 32000
+#define SCORE_INFINITE 32001 // Bounds the root window; never returned as a result.
+#define SCORE_NONE 32002 // Marks a transposition probe without a usable score.
+#define SCORE_EVAL_MAX 10000 // Static evaluations are clamped inside this.
+#define SCORE_MATE_BOUND (SCORE_MATE - 1000) // Anything at least this far from zero is a forced mate.
+
+namespace Scores {
+    inline bool isMate(int score) { return std::abs(score) >= SCORE_MATE_BOUND; };
+    inline Score mated(unsigned int ply, bool whiteMated) { return (Score)(whiteMated ? ply - SCORE_MATE : SCORE_MATE - ply); };
+    // Moves until mate from the point of view the score is in; negative when being mated.
+    inline int mateInMoves(int score) { return score > 0 ? (SCORE_MATE - score + 1) / 2 : -((SCORE_MATE + score + 1) / 2); };
+    // Transposition entries hold distances from the stored node rather than from the root.
+    inline Score toTransposition(int score, unsigned int ply) {
+        if (score > SCORE_EVAL_MAX) { return (Score)(score + ply); };
+        if (score < -SCORE_EVAL_MAX) { return (Score)(score - ply); };
+        return (Score)score;
+    };
+    inline Score fromTransposition(int score, unsigned int ply) {
+        if (score > SCORE_EVAL_MAX) { return (Score)(score - ply); };
+        if (score < -SCORE_EVAL_MAX) { return (Score)(score + ply); };
+        return (Score)score;
+    };
+    inline Score fromPawns(float pawns) {
+        long centipawns = std::lround(pawns * 100);
+        return (Score)(centipawns > SCORE_EVAL_MAX ? SCORE_EVAL_MAX : (centipawns < -SCORE_EVAL_MAX ? -SCORE_EVAL_MAX : centipawns));
+    };
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include "Eval.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define SEARCH_TASK_QUANTUM 4096 // Default nodes a scheduled search runs before it yields.
+
+// One iterative deepening search kept on an explicit stack instead of the call stack, so it can
+// stop after any number of nodes and carry on later, on any thread. Eval::search runs a task to
+// completion; the scheduler below interleaves many. All search state lives in the frames and in
+// the task's Eval, which must not be used for anything else until the task has finished.
+class SearchTask {
+    public:
+        SearchTask(Eval* setEngine, SearchLimits setLimits);
+        ~SearchTask();
+
+        // Runs for up to nodeBudget nodes (zero for no limit); true once the search has finished.
+        bool resume(u64 nodeBudget = 0);
+        bool finished() const { return done; };
+        const SearchResult& result() const { return searchResult; };
+        u64 nodes() const { return engine->nodes; };
+
+        Eval* engine;
+
+    private:
+        // The stages of one node, in the order evalAlphaBeta used to run them.
+        enum Stage : unsigned char {ENTER, AFTER_NULL_MOVE, AFTER_VERIFICATION, GENERATE, NEXT_MOVE, AFTER_REDUCED, AFTER_CHILD, FINISH};
+        struct Frame {
+            Stage stage;
+            uint depth;
+            Score alpha;
+            Score beta;
+            bool turn;
+            bool inCheck;
+            bool futile;
+            bool quiet;
+            bool givesCheck;
+            Score staticEval;
+            uint reduction; // Of the null move search, reused by its verification.
+            std::vector<MoveData*> moves;
+            uint moveIndex;
+            Score eval;
+            MoveData* bestMove;
+            NodeType type;
+            bool pathDependent; // The best score so far came from a repetition or fifty-move draw.
+        };
+
+        void start();
+        void finish();
+        bool finishRootSearch(Score score); // False when the search is over.
+        bool runFrames(); // False when the node budget ran out first.
+        void push(uint depth, Score alpha, Score beta);
+        // A path dependent value rests on how this node was reached, so no other path may reuse it.
+        void pop(Score value, bool pathDependent = false);
+        bool nearClockLimit(uint depth); // The fifty-move rule may end the game within depth plies.
+
+        SearchLimits limits;
+        SearchResult searchResult;
+        bool started = false;
+        bool done = false;
+        std::vector<Frame> frames; // Only the first height are live; the rest keep their move buffers.
+        size_t height = 0;
+        Score returned = 0; // Score of the frame popped last.
+        bool returnedPathDependent = false;
+        u64 yieldAt = 0;
+        uint iterationDepth = 1;
+        uint maxDepth = 0;
+        uint lineCount = 1;
+        std::vector<SearchLine> lines; // Lines found so far in the current iteration.
+};
+
+// Runs many searches on a fixed set of threads. Each turn a free thread resumes the search that
+// has used the fewest nodes for one quantum, so every game gets an even share whatever its
+// budget, and nothing waits on a blocked OS thread.
+class SearchScheduler {
+    public:
+        SearchScheduler(uint threadCount, u64 setQuantum = SEARCH_TASK_QUANTUM);
+        ~SearchScheduler();
+
+        // The callback runs on a worker thread once the task has finished.
+        void submit(std::shared_ptr<SearchTask> task, std::function<void(const SearchResult&)> callback);
+        void wait(); // Blocks until every submitted task has finished.
+        uint size() { return (uint)workers.size(); };
+
+    private:
+        struct Entry {
+            std::shared_ptr<SearchTask> task;
+            std::function<void(const SearchResult&)> callback;
+        };
+        void workerLoop();
+
+        u64 quantum;
+        std::vector<std::thread> workers;
+        std::vector<Entry> ready; // A heap with the task that has used the fewest nodes on top.
+        std::mutex mutex;
+        std::condition_variable taskAvailable;
+        std::condition_variable finished;
+        size_t pending = 0; // Submitted and not yet finished.
+        bool stopping = false;
+};
@@ -0,0 +1,79 @@
+#pragma once
+#include <string>
+
+// Compile-time switches: MYCHESS_STATS enables the search counters, MYCHESS_STATS_TIMERS adds
+// cycle timers on top. When a switch is off its macros expand to nothing.
+#ifndef MYCHESS_STATS
+#define MYCHESS_STATS 0
+#endif
+#ifndef MYCHESS_STATS_TIMERS
+#define MYCHESS_STATS_TIMERS 0
+#endif
+
+enum StatCounter {
+    STAT_NODES,
+    STAT_TT_PROBES,
+    STAT_TT_HITS,
+    STAT_TT_CUTOFFS,
+    STAT_BETA_CUTOFFS,
+    STAT_FIRST_MOVE_CUTOFFS,
+    STAT_NULL_MOVE_TRIES,
+    STAT_NULL_MOVE_CUTOFFS,
+    STAT_LMR_REDUCTIONS,
+    STAT_LMR_RESEARCHES,
+    STAT_FUTILITY_PRUNES,
+    STAT_TABLEBASE_HITS,
+    STAT_RULE_DRAWS,
+    STAT_PATH_DEPENDENT_STORES,
+    STAT_COUNTER_COUNT
+};
+
+enum StatTimer {
+    TIMER_MOVE_GENERATION,
+    TIMER_MAKE_UNMAKE,
+    TIMER_EVALUATION,
+    TIMER_TRANSPOSITION,
+    STAT_TIMER_COUNT
+};
+
+// Counters for one search thread. They are plain integers owned by that thread's Eval; totals
+// across threads are built with merge once the searches are done.
+struct SearchStats {
+    unsigned long long counters[STAT_COUNTER_COUNT] = {};
+    unsigned long long cycles[STAT_TIMER_COUNT] = {}; // Inclusive: movegen contains its legality make/unmake.
+    unsigned long long iterationNodes = 0; // Nodes spent on the last completed iteration.
+    unsigned long long previousIterationNodes = 0;
+    unsigned long long nodesAtLastIteration = 0;
+    unsigned int depth = 0;
+
+    void reset() { *this = SearchStats(); };
+    void finishIteration(unsigned int completedDepth);
+    void merge(const SearchStats& other);
+    double effectiveBranchingFactor() const;
+    std::string toJson() const;
+    static unsigned long long readCycles();
+};
+
+#if MYCHESS_STATS
+#define STATS_INC(stats, counter) ((stats).counters[counter]++)
+#else
+#define STATS_INC(stats, counter) ((void)0)
+#endif
+
+#if MYCHESS_STATS && MYCHESS_STATS_TIMERS
+class ScopedStatsTimer {
+    public:
+        ScopedStatsTimer(SearchStats& stats, StatTimer timer) : stats(stats), timer(timer), start(SearchStats::readCycles()) {};
+        ~ScopedStatsTimer() { stats.cycles[timer] += SearchStats::readCycles() - start; };
+
+    private:
+        SearchStats& stats;
+        StatTimer timer;
+        unsigned long long start;
+};
+#define STATS_CONCAT_INNER(a, b) a##b
+#define STATS_CONCAT(a, b) STATS_CONCAT_INNER(a, b)
+#define STATS_SCOPE(stats, timer) ScopedStatsTimer STATS_CONCAT(statsTimer, __LINE__)((stats), (timer))
+#else
+#define STATS_SCOPE(stats, timer) ((void)0)
+#endif
@@ -0,0 +1,131 @@
+#pragma once
+#include "Board.h"
+#include "MappedFile.h"
+#include "Score.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define TABLEBASE_MAX_PIECES 4
+#define TABLEBASE_BLOCK_SIZE 4096 // Entries per independently decodable DTM block.
+#define TABLEBASE_HEADER_SIZE 16
+#define TABLEBASE_WIN_SCORE 20000 // Centipawns; above any evaluation, below mate, less the plies to the win.
+#define TABLEBASE_INVALID 255 // Generator-only marker for impossible positions.
+
+class Eval;
+
+// Results are from the side to move's point of view.
+enum TablebaseResult { TB_DRAW, TB_WIN, TB_LOSS, TB_UNKNOWN };
+
+// Piece layout of one table, named like "KQvKR". Pieces are stored as white king, black king,
+// then the other white pieces and the other black pieces, strongest first. Positions are
+// indexed with the white king folded onto a1-d1-d4 (a-d files when pawns are on the board).
+struct TablebaseMaterial {
+    std::string name;
+    std::vector<int> pieces;
+    bool hasPawns = false;
+
+    static TablebaseMaterial fromName(const std::string& name);
+    static TablebaseMaterial fromPieces(const std::vector<int>& pieces, bool& coloursSwapped);
+    u64 entryCount() const;
+    u64 index(const int* squares, bool whiteToMove) const;
+    void decode(u64 index, int* squares, bool& whiteToMove) const;
+    u64 materialKey(bool coloursSwapped) const;
+};
+
+// DTM values are one byte: 0 is a draw, otherwise value - 1 is the distance to mate in plies,
+// even when the side to move is mated and odd when it mates.
+namespace TablebaseValue {
+    inline bool isWin(int value) { return value > 0 && ((value - 1) & 1); };
+    inline bool isLoss(int value) { return value > 0 && !((value - 1) & 1); };
+    inline int plies(int value) { return value - 1; };
+}
+
+// Memory-mapped probing of generated tables. Search probes the 2-bit WDL file, which is read
+// in place; DTM is run-length coded per block and only used to pick moves at the root.
+class Tablebases {
+    public:
+        uint load(const std::string& directory); // Returns the number of tables found.
+        TablebaseResult probeWDL(Board* board);
+        bool probeDTM(Board* board, int& value);
+        u16 probeRootMove(Eval* engine, Score& score); // NULL_MOVE unless every child is covered.
+        bool covers(Board* board);
+        int maxPieces = 0;
+
+    private:
+        struct Table {
+            TablebaseMaterial material;
+            MappedFile wdl;
+            MappedFile dtm;
+            uint blockCount = 0;
+        };
+        Table* locate(Board* board, int* squares, bool& whiteToMove);
+        static u64 boardMaterialKey(Board* board);
+
+        std::vector<std::unique_ptr<Table>> tables;
+        std::unordered_map<u64, std::pair<Table*, bool>> byMaterial; // Material key -> table, colours swapped.
+};
+
+// Retrograde generator. Each table is solved over every placement of its pieces, then folded by
+// symmetry and written as name.wdl and name.dtm. Captures and promotions are resolved against
+// smaller tables, which are generated first when they are not already on disk.
+class TablebaseGenerator {
+    public:
+        TablebaseGenerator(const std::string& directory);
+        ~TablebaseGenerator();
+
+        struct Stats {
+            u64 wins = 0;
+            u64 draws = 0;
+            u64 losses = 0;
+            int longestMate = 0; // Plies.
+            double seconds = 0;
+        };
+        Stats generate(const std::string& name);
+        static std::vector<std::string> allMaterials(int maxPieces);
+        std::function<void(const std::string&, const Stats&)> onTableFinished;
+
+        static bool writeTable(const std::string& directory, TablebaseMaterial& material, const std::vector<unsigned char>& values);
+        static bool readTable(const std::string& directory, TablebaseMaterial& material, std::vector<unsigned char>& values);
+
+    private:
+        struct Position {
+            int count;
+            int pieces[TABLEBASE_MAX_PIECES];
+            int squares[TABLEBASE_MAX_PIECES];
+            bool whiteToMove;
+        };
+        struct Move {
+            Position child; // Keeps the parent's layout; a captured piece is flagged, not removed.
+            int captured;
+            int promoting; // Slot of the promoting pawn, or -1.
+            int promotion;
+        };
+        // Where a capture or promotion leads: the smaller table and how the parent's slots map onto it.
+        struct Exit {
+            const std::vector<unsigned char>* values = nullptr; // Null for the bare kings draw.
+            TablebaseMaterial material;
+            bool coloursSwapped = false;
+            int source[TABLEBASE_MAX_PIECES];
+        };
+        const std::vector<unsigned char>& require(const std::string& name);
+        void solve(TablebaseMaterial& material, std::vector<unsigned char>& reduced, Stats& stats);
+        void prepareExits(TablebaseMaterial& material);
+        int probeExit(const Move& move);
+        int generateMoves(const Position& position, Move* moves);
+        int generateUnmoves(const Position& position, u64* predecessors);
+        bool isValid(const Position& position);
+        u64 attacksFrom(int piece, int square, u64 occupancy);
+        bool isAttacked(const Position& position, int square, bool byWhite, u64 occupancy, int ignore);
+        static u64 fullIndex(const Position& position);
+        static void decodeFull(u64 index, Position& position);
+        static int exitCode(int captured, int promoting, int promotion);
+
+        std::string directory;
+        std::unordered_map<std::string, std::vector<unsigned char>> solved;
+        Board* board;
+        Eval* engine; // Only used for its attack tables.
+        std::unordered_map<int, Exit> exits;
+};
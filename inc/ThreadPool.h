@@ -0,0 +1,67 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads pulling tasks from a shared queue. Tasks receive the index of the
+// worker running them, so callers can keep per-worker state such as a Board/Eval pair.
+class ThreadPool {
+    public:
+        ThreadPool(unsigned int threadCount, size_t maxQueued = 0);
+        ~ThreadPool();
+
+        void submit(std::function<void(unsigned int)> task); // Blocks while maxQueued tasks are waiting.
+        void wait(); // Blocks until every submitted task has finished.
+        unsigned int size() { return (unsigned int)workers.size(); };
+        static unsigned int defaultThreadCount();
+
+    private:
+        void workerLoop(unsigned int index);
+
+        std::vector<std::thread> workers;
+        std::queue<std::function<void(unsigned int)>> tasks;
+        std::mutex mutex;
+        std::condition_variable taskAvailable;
+        std::condition_variable spaceAvailable;
+        std::condition_variable finished;
+        size_t maxQueued;
+        unsigned int running = 0;
+        bool stopping = false;
+};
+
+// Worker threads with a task deque each, for work that splits itself into subtasks. A task
+// submitted from a worker goes on that worker's deque, which it drains newest first to stay depth
+// first; idle workers steal the oldest task of another worker, usually the largest piece left.
+class WorkStealingPool {
+    public:
+        WorkStealingPool(unsigned int threadCount);
+        ~WorkStealingPool();
+
+        void submit(std::function<void(unsigned int)> task);
+        void wait(); // Blocks until every submitted task, including ones submitted by tasks, has finished.
+        unsigned int size() { return (unsigned int)workers.size(); };
+
+    private:
+        struct Queue {
+            std::mutex mutex;
+            std::deque<std::function<void(unsigned int)>> tasks;
+        };
+        bool takeTask(unsigned int index, std::function<void(unsigned int)>& task);
+        void workerLoop(unsigned int index);
+
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::vector<std::thread> workers;
+        std::mutex mutex; // Guards sleeping and waking; the deques have their own locks.
+        std::condition_variable taskAvailable;
+        std::condition_variable finished;
+        std::atomic<size_t> queued{0};
+        std::atomic<size_t> pending{0}; // Submitted but not yet finished.
+        std::atomic<unsigned int> nextQueue{0};
+        bool stopping = false;
+};
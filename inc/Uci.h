@@ -0,0 +1,45 @@
+#pragma once
+#include "Book.h"
+#include "Eval.h"
+#include "MateSolver.h"
+#include "Tablebase.h"
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+// Universal Chess Interface front-end. Commands are read on the calling thread, which stays
+// responsive (isready, stop, ponderhit) while the search runs on its own worker thread.
+class Uci {
+    public:
+        Uci();
+        ~Uci();
+        void loop(std::istream& input);
+
+    private:
+        void handlePosition(std::istringstream& stream);
+        void handleGo(std::istringstream& stream);
+        void handleSetOption(std::istringstream& stream);
+        void runSearch(SearchLimits limits, uint mateMoves);
+        void reportIteration(const SearchResult& result);
+        void waitForSearch();
+        void releaseBestMove(bool endPonder);
+        void send(const std::string& line);
+        std::string formatScore(Score score);
+
+        Board* board;
+        Eval* engine;
+        MateSolver* mateSolver;
+        PolyglotBook book;
+        Tablebases tablebases;
+        bool ownBook = false;
+        std::thread searchThread;
+        std::mutex outputMutex;
+        // Set for go infinite: bestmove waits for stop. Guarded by holdMutex, as is the end of pondering.
+        bool holdBestMove = false;
+        std::mutex holdMutex;
+        std::condition_variable bestMoveReleased;
+        bool ponderEnabled = false;
+        uint multiPV = 1;
+};
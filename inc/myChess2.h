@@ -0,0 +1,96 @@
+/* C interface to the engine, built as the myChess2 shared library.
+ * Every call works on a batch of positions and writes into buffers owned by the caller, so
+ * nothing is allocated or returned across the boundary. An engine is not thread safe: create
+ * one per thread. Functions return MC2_OK or a negative error code, and per-position failures
+ * (bad FEN, malformed packed record) are reported in the optional status array instead. */
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(MC2_BUILDING_LIBRARY)
+#define MC2_API __declspec(dllexport)
+#else
+#define MC2_API __declspec(dllimport)
+#endif
+#else
+#define MC2_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MC2_OK 0
+#define MC2_ERROR_ARGUMENT -1
+#define MC2_ERROR_POSITION -2
+#define MC2_ERROR_INTERNAL -3
+
+#define MC2_FORMAT_FEN 0
+#define MC2_FORMAT_PACKED 1
+
+#define MC2_MATE_SCORE 32000 /* A mate in N plies scores MC2_MATE_SCORE - N for the side that mates. */
+
+typedef struct mc2_engine mc2_engine;
+
+/* Same layout as PackedPosition in Board.h: 32 bytes, pieces as 4-bit codes in square order. */
+typedef struct mc2_packed_position {
+    uint64_t occupancy;
+    uint8_t pieces[16];
+    uint8_t flags;
+    uint8_t en_passant_file;
+    uint8_t half_move_clock;
+    uint8_t result;
+    uint16_t full_move_number;
+    int16_t score;
+} mc2_packed_position;
+
+/* A batch of positions in one of the two formats; only the matching array is read. */
+typedef struct mc2_positions {
+    int format;
+    const char* const* fens;
+    const mc2_packed_position* packed;
+    size_t count;
+} mc2_positions;
+
+typedef struct mc2_search_limits {
+    uint32_t depth; /* Zero for no limit; depth 6 is used when no limit is given at all. */
+    uint64_t nodes;
+    uint64_t move_time_ms;
+} mc2_search_limits;
+
+typedef struct mc2_search_result {
+    uint16_t best_move; /* from | to << 6 | promotion << 12, promotion 1..4 = B, N, R, Q. */
+    int32_t score_cp; /* From white's point of view. */
+    uint32_t depth;
+    uint64_t nodes;
+} mc2_search_result;
+
+MC2_API mc2_engine* mc2_engine_create(uint32_t hash_megabytes);
+MC2_API void mc2_engine_destroy(mc2_engine* engine);
+MC2_API void mc2_engine_clear(mc2_engine* engine); /* Forget the hash tables and move ordering. */
+/* Size of the static evaluation cache, 0 to turn it off. The hit rate covers the last search. */
+MC2_API int mc2_engine_set_eval_cache(mc2_engine* engine, uint32_t megabytes);
+MC2_API double mc2_engine_eval_cache_hit_rate(const mc2_engine* engine);
+
+/* Legal moves of position i go to moves[i * max_moves ...], their count to move_counts[i].
+ * Positions with more than max_moves moves are truncated; the count is the full number. */
+MC2_API int mc2_legal_moves(mc2_engine* engine, const mc2_positions* positions, uint16_t* moves,
+                            size_t max_moves, uint32_t* move_counts, int8_t* status);
+/* Static evaluation in centipawns from white's point of view. */
+MC2_API int mc2_evaluate(mc2_engine* engine, const mc2_positions* positions, int32_t* centipawns, int8_t* status);
+MC2_API int mc2_search(mc2_engine* engine, const mc2_positions* positions, const mc2_search_limits* limits,
+                       mc2_search_result* results, int8_t* status);
+/* MultiPV: the best max_lines root moves of position i go to lines[i * max_lines ...], best first,
+ * and their count to line_counts[i]. Each line carries its own score and depth; nodes is the total. */
+MC2_API int mc2_search_lines(mc2_engine* engine, const mc2_positions* positions, const mc2_search_limits* limits,
+                             size_t max_lines, mc2_search_result* lines, uint32_t* line_counts, int8_t* status);
+
+/* Conversions. Text buffers are written NUL terminated; a FEN needs at most 100 bytes. */
+MC2_API int mc2_pack_fen(const char* fen, mc2_packed_position* packed);
+MC2_API int mc2_unpack_to_fen(const mc2_packed_position* packed, char* fen, size_t size);
+MC2_API int mc2_move_to_uci(uint16_t move, char* text, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,11 +1,57 @@
 #include <iostream>
-#include "inc/Eval.h"
+#include "inc/AnalysisServer.h"
+#include "inc/Arguments.h"
+#include "inc/Uci.h"
 
-void main() {
-    Board* board = new Board();
-    Eval* evaluator = new Eval(board);
-    float eval = evaluator->evalAlphaBeta(5, -INFINITY, INFINITY);
-    std::cout << board->pieceLocations[0] << std::endl;
-    std::cout << eval << std::endl;
-    getchar();
-}
\ No newline at end of file
+// Without arguments the engine speaks UCI on stdin/stdout. With --server it runs the JSON line
+// analysis server instead (see AnalysisServer.h):
+//   myChess2 --server (--port N | --socket path) [--engines N] [--hash MB] [--max-time ms]
+static const char* SERVER_USAGE = "usage: myChess2 --server (--port N | --socket path) [--engines N] [--hash MB] [--max-time ms]";
+
+static int runServer(int argc, char** argv) {
+    ServerSettings settings;
+    uint port = 0;
+    std::string socketPath;
+    for (int i = 2; i < argc; i += 2) {
+        std::string option = argv[i];
+        if (i + 1 == argc) {
+            std::cerr << "option " << option << " needs a value" << std::endl << SERVER_USAGE << std::endl;
+            return 1;
+        };
+        const char* value = argv[i + 1];
+        bool numeric = true;
+        if (option == "--port") { numeric = parseCount(value, port) && port <= 65535; }
+        else if (option == "--socket") { socketPath = value; }
+        else if (option == "--engines") { numeric = parseCount(value, settings.engines); }
+        else if (option == "--hash") { numeric = parseCount(value, settings.hashMegabytes); }
+        else if (option == "--max-time") { numeric = parseCount(value, settings.maxMoveTime); }
+        else {
+            std::cerr << "unknown option " << option << std::endl << SERVER_USAGE << std::endl;
+            return 1;
+        };
+        if (!numeric) {
+            std::cerr << "bad value " << value << " for " << option << std::endl << SERVER_USAGE << std::endl;
+            return 1;
+        };
+    }
+    if (!port && socketPath.empty()) {
+        std::cerr << SERVER_USAGE << std::endl;
+        return 1;
+    };
+    AnalysisServer server(settings);
+    if (port ? !server.listenTcp(port) : !server.listenUnix(socketPath)) {
+        std::cerr << "cannot listen on " << (port ? "port " + std::to_string(port) : socketPath) << std::endl;
+        return 1;
+    };
+    std::cerr << "serving on " << (port ? "127.0.0.1:" + std::to_string(port) : socketPath) << " with "
+              << settings.engines << " engines" << std::endl;
+    server.serve();
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "--server") { return runServer(argc, argv); };
+    Uci uci;
+    uci.loop(std::cin);
+    return 0;
+}
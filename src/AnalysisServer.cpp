@@ -0,0 +1,558 @@
+#include "../inc/AnalysisServer.h"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET SocketHandle;
+#define closeSocket closesocket
+#define SHUTDOWN_BOTH SD_BOTH
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+typedef int SocketHandle;
+#define closeSocket ::close
+#define SHUTDOWN_BOTH SHUT_RDWR
+#endif
+
+// Just enough JSON for the request lines: objects, arrays, strings, numbers, booleans and null.
+struct JsonValue {
+    enum Type {NONE, NULL_VALUE, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT};
+    Type type = NONE;
+    std::string text; // String contents, or a number as it was written.
+    bool boolean = false;
+    std::vector<JsonValue> items;
+    std::vector<std::pair<std::string, JsonValue>> fields;
+
+    const JsonValue* find(const std::string& name) const {
+        for (const std::pair<std::string, JsonValue>& field : fields) {
+            if (field.first == name) { return &field.second; };
+        }
+        return nullptr;
+    };
+};
+
+static void skipSpace(const std::string& text, size_t& pos) {
+    while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r' || text[pos] == '\n')) { pos++; }
+}
+
+static bool parseJsonString(const std::string& text, size_t& pos, std::string& out) {
+    if (pos >= text.size() || text[pos] != '"') { return false; };
+    pos++;
+    while (pos < text.size() && text[pos] != '"') {
+        char c = text[pos++];
+        if (c != '\\') { out += c; continue; };
+        if (pos >= text.size()) { return false; };
+        char escaped = text[pos++];
+        if (escaped == 'n') { out += '\n'; }
+        else if (escaped == 't') { out += '\t'; }
+        else if (escaped == 'r') { out += '\r'; }
+        else if (escaped == 'b') { out += '\b'; }
+        else if (escaped == 'f') { out += '\f'; }
+        else if (escaped == 'u') {
+            // Only ASCII escapes are kept; nothing in the protocol needs more.
+            if (pos + 4 > text.size()) { return false; };
+            unsigned long code = std::strtoul(text.substr(pos, 4).c_str(), nullptr, 16);
+            out += code < 128 ? (char)code : '?';
+            pos += 4;
+        }
+        else { out += escaped; };
+    }
+    if (pos >= text.size()) { return false; };
+    pos++;
+    return true;
+}
+
+static bool parseJson(const std::string& text, size_t& pos, JsonValue& value, int depth) {
+    if (depth > 16) { return false; };
+    skipSpace(text, pos);
+    if (pos >= text.size()) { return false; };
+    char c = text[pos];
+    if (c == '{') {
+        value.type = JsonValue::OBJECT;
+        pos++;
+        skipSpace(text, pos);
+        if (pos < text.size() && text[pos] == '}') { pos++; return true; };
+        while (true) {
+            std::string name;
+            skipSpace(text, pos);
+            if (!parseJsonString(text, pos, name)) { return false; };
+            skipSpace(text, pos);
+            if (pos >= text.size() || text[pos++] != ':') { return false; };
+            value.fields.emplace_back(name, JsonValue());
+            if (!parseJson(text, pos, value.fields.back().second, depth + 1)) { return false; };
+            skipSpace(text, pos);
+            if (pos < text.size() && text[pos] == ',') { pos++; continue; };
+            if (pos < text.size() && text[pos] == '}') { pos++; return true; };
+            return false;
+        }
+    };
+    if (c == '[') {
+        value.type = JsonValue::ARRAY;
+        pos++;
+        skipSpace(text, pos);
+        if (pos < text.size() && text[pos] == ']') { pos++; return true; };
+        while (true) {
+            value.items.emplace_back();
+            if (!parseJson(text, pos, value.items.back(), depth + 1)) { return false; };
+            skipSpace(text, pos);
+            if (pos < text.size() && text[pos] == ',') { pos++; continue; };
+            if (pos < text.size() && text[pos] == ']') { pos++; return true; };
+            return false;
+        }
+    };
+    if (c == '"') {
+        value.type = JsonValue::STRING;
+        return parseJsonString(text, pos, value.text);
+    };
+    for (const char* word : {"true", "false", "null"}) {
+        if (text.compare(pos, std::strlen(word), word) != 0) { continue; };
+        value.type = word[0] == 'n' ? JsonValue::NULL_VALUE : JsonValue::BOOLEAN;
+        value.boolean = word[0] == 't';
+        pos += std::strlen(word);
+        return true;
+    }
+    size_t start = pos;
+    while (pos < text.size() && (std::isdigit((unsigned char)text[pos]) || std::strchr("+-.eE", text[pos]))) { pos++; }
+    if (pos == start) { return false; };
+    value.type = JsonValue::NUMBER;
+    value.text = text.substr(start, pos - start);
+    return true;
+}
+
+static std::string quoteJson(const std::string& text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') { quoted += '\\'; quoted += c; }
+        else if (c == '\n') { quoted += "\\n"; }
+        else if ((unsigned char)c < 0x20) { quoted += ' '; }
+        else { quoted += c; };
+    }
+    return quoted + "\"";
+}
+
+// The id is echoed back as it was sent, a number or a string.
+static std::string idToJson(const JsonValue* id) {
+    if (!id) { return "null"; };
+    if (id->type == JsonValue::NUMBER) { return id->text; };
+    if (id->type == JsonValue::STRING) { return quoteJson(id->text); };
+    return "null";
+}
+
+static std::string scoreToJson(Score score) {
+    if (Scores::isMate(score)) { return "{\"mate\":" + std::to_string(Scores::mateInMoves(score)) + "}"; };
+    return "{\"cp\":" + std::to_string(score) + "}";
+}
+
+static bool readUnsigned(const JsonValue& request, const char* name, u64& value, std::string& error) {
+    const JsonValue* field = request.find(name);
+    if (!field || field->type == JsonValue::NULL_VALUE) { return true; };
+    if (field->type != JsonValue::NUMBER || field->text.empty() || !std::isdigit((unsigned char)field->text[0])) {
+        error = std::string(name) + " must be a non-negative integer";
+        return false;
+    };
+    value = std::strtoull(field->text.c_str(), nullptr, 10);
+    return true;
+}
+
+static bool readStrings(const JsonValue* field, std::vector<std::string>& values) {
+    if (!field) { return true; };
+    if (field->type != JsonValue::ARRAY) { return false; };
+    for (const JsonValue& item : field->items) {
+        if (item.type != JsonValue::STRING) { return false; };
+        values.push_back(item.text);
+    }
+    return true;
+}
+
+struct AnalysisServer::Job {
+    std::string id;
+    std::mutex mutex;
+    bool cancelled = false;
+    Eval* engine = nullptr; // Set while the search runs, so a cancel can stop it.
+};
+
+// Queued searches keep their connection alive, so the socket is only closed once the last
+// reference goes and no late answer can land on a reused descriptor.
+struct AnalysisServer::Connection {
+    ~Connection() { closeSocket(socket); };
+    SocketHandle socket;
+    std::atomic<bool> finished{false}; // Its thread is done and can be joined.
+    std::mutex writeMutex;
+    std::mutex jobsMutex;
+    std::map<std::string, std::shared_ptr<Job>> jobs; // Queued and running searches by id.
+};
+
+struct AnalysisServer::CheapQuery {
+    std::shared_ptr<Connection> connection;
+    std::string id;
+    bool evaluate; // Otherwise a move list.
+    std::vector<std::string> fens;
+};
+
+struct AnalysisServer::SearchRequest {
+    std::string fen;
+    std::vector<std::string> moves;
+    SearchLimits limits;
+    bool newGame = false;
+};
+
+AnalysisServer::AnalysisServer(const ServerSettings& setSettings) : settings(setSettings), pool(setSettings.engines) {
+#ifdef _WIN32
+    WSADATA data;
+    WSAStartup(MAKEWORD(2, 2), &data);
+#else
+    // A client that disconnects mid-reply must not take the server down.
+    signal(SIGPIPE, SIG_IGN);
+#endif
+    for (uint i = 0; i < pool.size(); i++) {
+        boards.push_back(new Board());
+        engines.push_back(new Eval(boards.back()));
+        engines.back()->resizeTranspositionCache(settings.hashMegabytes);
+    }
+    batchEngine = new Eval(&batchBoard);
+    batchEngine->resizeTranspositionCache(1);
+    batchThread = std::thread(&AnalysisServer::batchLoop, this);
+}
+
+AnalysisServer::~AnalysisServer() {
+    stop();
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        for (std::shared_ptr<Connection>& connection : connections) { shutdown(connection->socket, SHUTDOWN_BOTH); }
+    }
+    for (std::thread& thread : connectionThreads) { thread.join(); }
+    for (Eval* engine : engines) { engine->stopSearch(); }
+    pool.wait();
+    {
+        std::lock_guard<std::mutex> lock(batchMutex);
+        batchReady.notify_all();
+    }
+    batchThread.join();
+    for (uint i = 0; i < engines.size(); i++) {
+        delete engines[i];
+        delete boards[i];
+    }
+    delete batchEngine;
+    if (listener != -1) { closeSocket((SocketHandle)listener); };
+    if (!unixPath.empty()) { std::remove(unixPath.c_str()); };
+#ifdef _WIN32
+    WSACleanup();
+#endif
+}
+
+bool AnalysisServer::listenTcp(uint port) {
+    SocketHandle handle = socket(AF_INET, SOCK_STREAM, 0);
+    if (handle == (SocketHandle)-1) { return false; };
+    int reuse = 1;
+    setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuse, sizeof(reuse));
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons((unsigned short)port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(handle, (sockaddr*)&address, sizeof(address)) != 0 || listen(handle, 16) != 0) {
+        closeSocket(handle);
+        return false;
+    };
+    listener = (intptr_t)handle;
+    return true;
+}
+
+bool AnalysisServer::listenUnix(const std::string& path) {
+#ifdef _WIN32
+    (void)path;
+    return false;
+#else
+    sockaddr_un address = {};
+    if (path.size() >= sizeof(address.sun_path)) { return false; };
+    SocketHandle handle = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (handle == -1) { return false; };
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    ::unlink(path.c_str());
+    if (bind(handle, (sockaddr*)&address, sizeof(address)) != 0 || listen(handle, 16) != 0) {
+        closeSocket(handle);
+        return false;
+    };
+    listener = (intptr_t)handle;
+    unixPath = path;
+    return true;
+#endif
+}
+
+void AnalysisServer::serve() {
+    if (listener == -1) { return; };
+    while (!stopping) {
+        // Wait with a timeout rather than in accept, so that a stop is noticed on every platform.
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET((SocketHandle)listener, &readable);
+        timeval timeout = {0, 200000};
+        if (select((int)listener + 1, &readable, nullptr, nullptr, &timeout) <= 0) { continue; };
+        SocketHandle client = accept((SocketHandle)listener, nullptr, nullptr);
+        if (client == (SocketHandle)-1) { continue; };
+        std::shared_ptr<Connection> connection(new Connection());
+        connection->socket = client;
+        std::lock_guard<std::mutex> lock(connectionsMutex);
+        // Reap connections that have closed since the last one arrived.
+        for (size_t i = 0; i < connections.size();) {
+            if (!connections[i]->finished) { i++; continue; };
+            connectionThreads[i].join();
+            connections.erase(connections.begin() + i);
+            connectionThreads.erase(connectionThreads.begin() + i);
+        }
+        connections.push_back(connection);
+        connectionThreads.emplace_back(&AnalysisServer::handleConnection, this, connection);
+    }
+}
+
+void AnalysisServer::stop() {
+    stopping = true;
+}
+
+void AnalysisServer::send(Connection& connection, const std::string& line) {
+    std::lock_guard<std::mutex> lock(connection.writeMutex);
+    std::string text = line + "\n";
+    size_t sent = 0;
+    while (sent < text.size()) {
+        int written = (int)::send(connection.socket, text.data() + sent, (int)(text.size() - sent), 0);
+        if (written <= 0) { return; };
+        sent += (size_t)written;
+    }
+}
+
+void AnalysisServer::handleConnection(std::shared_ptr<Connection> connection) {
+    std::string buffer;
+    char chunk[4096];
+    while (!stopping) {
+        int received = (int)recv(connection->socket, chunk, sizeof(chunk), 0);
+        if (received <= 0) { break; };
+        buffer.append(chunk, (size_t)received);
+        size_t newline;
+        while ((newline = buffer.find('\n')) != std::string::npos) {
+            std::string line = buffer.substr(0, newline);
+            buffer.erase(0, newline + 1);
+            if (line.find_first_not_of(" \t\r") != std::string::npos) { handleLine(connection, line); };
+        }
+        if (buffer.size() > SERVER_MAX_LINE) {
+            send(*connection, "{\"id\":null,\"error\":\"request line too long\"}");
+            break;
+        };
+    }
+    // Nobody is left to read the answers of this connection's searches.
+    {
+        std::lock_guard<std::mutex> lock(connection->jobsMutex);
+        for (std::pair<const std::string, std::shared_ptr<Job>>& entry : connection->jobs) {
+            std::lock_guard<std::mutex> jobLock(entry.second->mutex);
+            entry.second->cancelled = true;
+            if (entry.second->engine) { entry.second->engine->stopSearch(); };
+        }
+    }
+    shutdown(connection->socket, SHUTDOWN_BOTH);
+    connection->finished = true;
+}
+
+void AnalysisServer::handleLine(std::shared_ptr<Connection> connection, const std::string& line) {
+    JsonValue request;
+    size_t pos = 0;
+    if (!parseJson(line, pos, request, 0) || request.type != JsonValue::OBJECT) {
+        send(*connection, "{\"id\":null,\"error\":\"malformed JSON\"}");
+        return;
+    };
+    std::string id = idToJson(request.find("id"));
+    const JsonValue* typeField = request.find("type");
+    std::string type = typeField && typeField->type == JsonValue::STRING ? typeField->text : "";
+    std::string error;
+
+    if (type == "search") {
+        SearchRequest search;
+        const JsonValue* fen = request.find("fen");
+        search.fen = fen && fen->type == JsonValue::STRING ? fen->text : "";
+        u64 depth = 0, multiPV = 1;
+        if (search.fen.empty()) { error = "search needs a fen"; }
+        else if (!readStrings(request.find("moves"), search.moves)) { error = "moves must be an array of strings"; }
+        else {
+            readUnsigned(request, "depth", depth, error) && readUnsigned(request, "nodes", search.limits.nodes, error)
+                && readUnsigned(request, "movetime", search.limits.moveTime, error) && readUnsigned(request, "multipv", multiPV, error);
+        };
+        if (!error.empty()) {
+            send(*connection, "{\"id\":" + id + ",\"error\":" + quoteJson(error) + "}");
+            return;
+        };
+        const JsonValue* newGame = request.find("newgame");
+        search.newGame = newGame && newGame->boolean;
+        search.limits.depth = (uint)std::min<u64>(depth, MAX_SEARCH_PLY - 1);
+        search.limits.multiPV = (uint)std::max<u64>(1, std::min<u64>(multiPV, 256));
+        if (settings.maxMoveTime && (!search.limits.moveTime || search.limits.moveTime > settings.maxMoveTime)) {
+            search.limits.moveTime = settings.maxMoveTime;
+        };
+        if (!search.limits.depth && !search.limits.nodes && !search.limits.moveTime) { search.limits.depth = SERVER_DEFAULT_DEPTH; };
+
+        std::shared_ptr<Job> job(new Job());
+        job->id = id;
+        {
+            std::lock_guard<std::mutex> lock(connection->jobsMutex);
+            if (connection->jobs.count(id)) {
+                send(*connection, "{\"id\":" + id + ",\"error\":\"a search with this id is already running\"}");
+                return;
+            };
+            connection->jobs[id] = job;
+        }
+        pool.submit([this, connection, job, search](uint worker) { runSearch(connection, job, search, worker); });
+    }
+    else if (type == "evaluate" || type == "moves") {
+        CheapQuery query;
+        query.connection = connection;
+        query.id = id;
+        query.evaluate = type == "evaluate";
+        const JsonValue* fen = request.find("fen");
+        if (fen && fen->type == JsonValue::STRING) { query.fens.push_back(fen->text); };
+        if (!readStrings(request.find("fens"), query.fens) || query.fens.empty()) {
+            send(*connection, "{\"id\":" + id + ",\"error\":\"" + type + " needs a fen or an array of fens\"}");
+            return;
+        };
+        std::lock_guard<std::mutex> lock(batchMutex);
+        batch.push_back(std::move(query));
+        batchReady.notify_one();
+    }
+    else if (type == "cancel") {
+        std::string target = idToJson(request.find("target"));
+        std::shared_ptr<Job> job;
+        {
+            std::lock_guard<std::mutex> lock(connection->jobsMutex);
+            std::map<std::string, std::shared_ptr<Job>>::iterator found = connection->jobs.find(target);
+            if (found != connection->jobs.end()) { job = found->second; };
+        }
+        if (job) {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            job->cancelled = true;
+            if (job->engine) { job->engine->stopSearch(); };
+        };
+        send(*connection, "{\"id\":" + id + ",\"cancelled\":" + (job ? "true" : "false") + "}");
+    }
+    else if (type == "shutdown") {
+        send(*connection, "{\"id\":" + id + ",\"shutdown\":true}");
+        stop();
+    }
+    else {
+        send(*connection, "{\"id\":" + id + ",\"error\":" + quoteJson("unknown request type " + type) + "}");
+    };
+}
+
+bool AnalysisServer::loadPosition(Eval* engine, const std::string& fen, const std::vector<std::string>& moves, std::string& error) {
+    try {
+        engine->board->loadFEN(fen == "startpos" ? STARTING_FEN : fen);
+    }
+    catch (const std::invalid_argument& invalid) {
+        error = invalid.what();
+        return false;
+    }
+    // Moves stay made, as in the UCI front-end, so repetitions of the game are seen.
+    engine->resetGameHistory();
+    for (const std::string& text : moves) {
+        MoveData* move = engine->findLegalMove(Eval::stringToMove(text));
+        if (!move) {
+            error = "illegal move " + text;
+            return false;
+        };
+        engine->doMove(move);
+        delete move;
+    }
+    return true;
+}
+
+void AnalysisServer::runSearch(std::shared_ptr<Connection> connection, std::shared_ptr<Job> job, const SearchRequest& request, uint worker) {
+    Eval* engine = engines[worker];
+    std::string error;
+    bool loaded = loadPosition(engine, request.fen, request.moves, error);
+    bool cancelled;
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        cancelled = job->cancelled;
+        if (loaded && !cancelled) {
+            engine->stopRequested = false;
+            job->engine = engine;
+        };
+    }
+    std::ostringstream reply;
+    reply << "{\"id\":" << job->id;
+    if (!loaded) { reply << ",\"error\":" << quoteJson(error); }
+    else if (cancelled) { reply << ",\"cancelled\":true"; }
+    else {
+        if (request.newGame) {
+            engine->clearTranspositionCache();
+            engine->clearEvalCache();
+        };
+        engine->clearSearchHeuristics();
+        SearchResult result = engine->search(request.limits);
+        {
+            std::lock_guard<std::mutex> lock(job->mutex);
+            job->engine = nullptr;
+            cancelled = job->cancelled;
+        }
+        reply << ",\"bestmove\":\"" << Eval::moveToString(result.bestMove) << "\",\"score\":" << scoreToJson(result.score)
+              << ",\"depth\":" << result.depth << ",\"nodes\":" << result.nodes << ",\"time\":" << result.time;
+        if (cancelled) { reply << ",\"cancelled\":true"; };
+        reply << ",\"lines\":[";
+        for (size_t i = 0; i < result.lines.size(); i++) {
+            const SearchLine& line = result.lines[i];
+            reply << (i ? "," : "") << "{\"move\":\"" << Eval::moveToString(line.move) << "\",\"score\":" << scoreToJson(line.score)
+                  << ",\"depth\":" << line.depth << ",\"pv\":[";
+            std::vector<u16> pv = engine->findPrincipalVariation(line.depth, line.move);
+            for (size_t m = 0; m < pv.size(); m++) { reply << (m ? "," : "") << "\"" << Eval::moveToString(pv[m]) << "\""; }
+            reply << "]}";
+        }
+        reply << "]";
+    };
+    reply << "}";
+    {
+        std::lock_guard<std::mutex> lock(connection->jobsMutex);
+        connection->jobs.erase(job->id);
+    }
+    send(*connection, reply.str());
+}
+
+void AnalysisServer::batchLoop() {
+    while (true) {
+        std::vector<CheapQuery> pending;
+        {
+            std::unique_lock<std::mutex> lock(batchMutex);
+            batchReady.wait(lock, [this]() { return !batch.empty() || stopping; });
+            if (batch.empty()) { return; };
+            pending.swap(batch);
+        }
+        for (const CheapQuery& query : pending) { answerCheapQuery(query); }
+    }
+}
+
+void AnalysisServer::answerCheapQuery(const CheapQuery& query) {
+    std::ostringstream reply;
+    reply << "{\"id\":" << query.id << ",\"results\":[";
+    for (size_t i = 0; i < query.fens.size(); i++) {
+        reply << (i ? "," : "");
+        std::string error;
+        if (!loadPosition(batchEngine, query.fens[i], {}, error)) {
+            reply << "{\"error\":" << quoteJson(error) << "}";
+            continue;
+        };
+        if (query.evaluate) {
+            reply << "{\"cp\":" << batchEngine->evaluatePosition() << "}";
+            continue;
+        };
+        std::vector<MoveData*> legal = batchEngine->findLegalMoves(batchEngine->isInCheck() ? batchEngine->findEvasionMoves() : batchEngine->findPseudoLegalMoves());
+        reply << "[";
+        for (size_t m = 0; m < legal.size(); m++) { reply << (m ? "," : "") << "\"" << Eval::moveToString(legal[m]->encode()) << "\""; }
+        reply << "]";
+        Eval::releaseMoves(legal);
+    }
+    reply << "]}";
+    send(*query.connection, reply.str());
+}
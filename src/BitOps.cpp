@@ -1,5 +1,22 @@
 #include "../inc/BitOps.h"
 #include <random>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#include <xmmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define BITOPS_AVX2
+#include <immintrin.h>
+#elif defined(_M_X64) || (defined(__SSE2__) && defined(__x86_64__))
+#define BITOPS_SSE2
+#include <emmintrin.h>
+#endif
+
+using u64 = unsigned long long;
+
+static const u64 NOT_A_FILE = 0xFEFEFEFEFEFEFEFEULL;
+static const u64 NOT_H_FILE = 0x7F7F7F7F7F7F7F7FULL;
+static const u64 NOT_AB_FILES = 0xFCFCFCFCFCFCFCFCULL;
+static const u64 NOT_GH_FILES = 0x3F3F3F3F3F3F3F3FULL;
 
 int BitOps::countTrailingZeroes(unsigned long long num) {
     int i = 0;
@@ -25,11 +42,133 @@ int BitOps::countSetBits(unsigned long long num) {
     return i;
 }
 
-unsigned long long BitOps::generateMagicNumber() {
-    std::random_device rd;
-    std::mt19937_64 gen(rd());
-    std::uniform_int_distribution<unsigned long long int> dist;
-
-    unsigned long long magicNumber = dist(gen) & dist(gen) & dist(gen);
+unsigned long long BitOps::generateMagicNumber(std::mt19937_64& generator) {
+    // Sparse candidates make good magics far more often, so three draws are ANDed together.
+    unsigned long long magicNumber = generator() & generator() & generator();
     return magicNumber;
-}
\ No newline at end of file
+}
+
+void BitOps::prefetch(const void* address) {
+    // Hint only: brings the cache line in without blocking, so the later load does not stall.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+    _mm_prefetch((const char*)address, _MM_HINT_T0);
+#elif defined(__GNUC__)
+    __builtin_prefetch(address);
+#endif
+}
+
+u64 BitOps::knightAttacks(u64 knights) {
+    u64 oneFile = ((knights << 1) & NOT_A_FILE) | ((knights >> 1) & NOT_H_FILE);
+    u64 twoFiles = ((knights << 2) & NOT_AB_FILES) | ((knights >> 2) & NOT_GH_FILES);
+    return (oneFile << 16) | (oneFile >> 16) | (twoFiles << 8) | (twoFiles >> 8);
+}
+
+u64 BitOps::kingAttacks(u64 kings) {
+    u64 row = kings | ((kings << 1) & NOT_A_FILE) | ((kings >> 1) & NOT_H_FILE);
+    return (row | (row << 8) | (row >> 8)) & ~kings;
+}
+
+u64 BitOps::pawnAttacks(u64 pawns, bool white) {
+    return white
+        ? ((pawns << 7) & NOT_H_FILE) | ((pawns << 9) & NOT_A_FILE)
+        : ((pawns >> 9) & NOT_H_FILE) | ((pawns >> 7) & NOT_A_FILE);
+}
+
+// Occluded Kogge-Stone fills. Each direction floods its generators through empty squares in three
+// doubling steps, then shifts once more to include the first blocker. The wrap mask stops shifts
+// from carrying pieces across the A/H file edge. Directions are ordered N, E, NE, NW (shifted
+// left by 8, 1, 9, 7) followed by S, W, SW, SE (shifted right by the same amounts).
+#if defined(BITOPS_AVX2)
+u64 BitOps::slidingAttacks(u64 rooks, u64 bishops, u64 occupancy) {
+    const __m256i shift1 = _mm256_setr_epi64x(8, 1, 9, 7);
+    const __m256i shift2 = _mm256_setr_epi64x(16, 2, 18, 14);
+    const __m256i shift4 = _mm256_setr_epi64x(32, 4, 36, 28);
+    const __m256i leftWrap = _mm256_setr_epi64x(~0LL, NOT_A_FILE, NOT_A_FILE, NOT_H_FILE);
+    const __m256i rightWrap = _mm256_setr_epi64x(~0LL, NOT_H_FILE, NOT_H_FILE, NOT_A_FILE);
+    const __m256i empty = _mm256_set1_epi64x(~occupancy);
+    __m256i leftGen = _mm256_setr_epi64x(rooks, rooks, bishops, bishops);
+    __m256i rightGen = leftGen;
+    __m256i leftPro = _mm256_and_si256(empty, leftWrap);
+    __m256i rightPro = _mm256_and_si256(empty, rightWrap);
+
+    leftGen = _mm256_or_si256(leftGen, _mm256_and_si256(leftPro, _mm256_sllv_epi64(leftGen, shift1)));
+    rightGen = _mm256_or_si256(rightGen, _mm256_and_si256(rightPro, _mm256_srlv_epi64(rightGen, shift1)));
+    leftPro = _mm256_and_si256(leftPro, _mm256_sllv_epi64(leftPro, shift1));
+    rightPro = _mm256_and_si256(rightPro, _mm256_srlv_epi64(rightPro, shift1));
+    leftGen = _mm256_or_si256(leftGen, _mm256_and_si256(leftPro, _mm256_sllv_epi64(leftGen, shift2)));
+    rightGen = _mm256_or_si256(rightGen, _mm256_and_si256(rightPro, _mm256_srlv_epi64(rightGen, shift2)));
+    leftPro = _mm256_and_si256(leftPro, _mm256_sllv_epi64(leftPro, shift2));
+    rightPro = _mm256_and_si256(rightPro, _mm256_srlv_epi64(rightPro, shift2));
+    leftGen = _mm256_or_si256(leftGen, _mm256_and_si256(leftPro, _mm256_sllv_epi64(leftGen, shift4)));
+    rightGen = _mm256_or_si256(rightGen, _mm256_and_si256(rightPro, _mm256_srlv_epi64(rightGen, shift4)));
+
+    __m256i attacks = _mm256_or_si256(
+        _mm256_and_si256(_mm256_sllv_epi64(leftGen, shift1), leftWrap),
+        _mm256_and_si256(_mm256_srlv_epi64(rightGen, shift1), rightWrap)
+    );
+    __m128i half = _mm_or_si128(_mm256_castsi256_si128(attacks), _mm256_extracti128_si256(attacks, 1));
+    half = _mm_or_si128(half, _mm_unpackhi_epi64(half, half));
+    return (u64)_mm_cvtsi128_si64(half);
+}
+#elif defined(BITOPS_SSE2)
+// SSE2 has no per-lane shift counts, so each register holds one line: the left shift in the low lane
+// and the opposite right shift in the high lane, blended after shifting both lanes both ways.
+static inline __m128i shiftLine(__m128i bitboards, int shift) {
+    const __m128i lowLane = _mm_set_epi64x(0, ~0LL);
+    __m128i count = _mm_cvtsi32_si128(shift);
+    return _mm_or_si128(
+        _mm_and_si128(lowLane, _mm_sll_epi64(bitboards, count)),
+        _mm_andnot_si128(lowLane, _mm_srl_epi64(bitboards, count))
+    );
+}
+
+static inline __m128i fillLine(__m128i gen, __m128i wrap, __m128i empty, int shift) {
+    __m128i pro = _mm_and_si128(empty, wrap);
+    gen = _mm_or_si128(gen, _mm_and_si128(pro, shiftLine(gen, shift)));
+    pro = _mm_and_si128(pro, shiftLine(pro, shift));
+    gen = _mm_or_si128(gen, _mm_and_si128(pro, shiftLine(gen, 2 * shift)));
+    pro = _mm_and_si128(pro, shiftLine(pro, 2 * shift));
+    gen = _mm_or_si128(gen, _mm_and_si128(pro, shiftLine(gen, 4 * shift)));
+    return _mm_and_si128(shiftLine(gen, shift), wrap);
+}
+
+u64 BitOps::slidingAttacks(u64 rooks, u64 bishops, u64 occupancy) {
+    const __m128i empty = _mm_set1_epi64x(~occupancy);
+    const __m128i rookGen = _mm_set1_epi64x(rooks);
+    const __m128i bishopGen = _mm_set1_epi64x(bishops);
+    __m128i attacks = fillLine(rookGen, _mm_set1_epi64x(~0LL), empty, 8);
+    attacks = _mm_or_si128(attacks, fillLine(rookGen, _mm_set_epi64x(NOT_H_FILE, NOT_A_FILE), empty, 1));
+    attacks = _mm_or_si128(attacks, fillLine(bishopGen, _mm_set_epi64x(NOT_H_FILE, NOT_A_FILE), empty, 9));
+    attacks = _mm_or_si128(attacks, fillLine(bishopGen, _mm_set_epi64x(NOT_A_FILE, NOT_H_FILE), empty, 7));
+    attacks = _mm_or_si128(attacks, _mm_unpackhi_epi64(attacks, attacks));
+    return (u64)_mm_cvtsi128_si64(attacks);
+}
+#else
+static inline u64 fillLeft(u64 gen, u64 wrap, u64 empty, int shift) {
+    u64 pro = empty & wrap;
+    gen |= pro & (gen << shift);
+    pro &= pro << shift;
+    gen |= pro & (gen << (2 * shift));
+    pro &= pro << (2 * shift);
+    gen |= pro & (gen << (4 * shift));
+    return (gen << shift) & wrap;
+}
+
+static inline u64 fillRight(u64 gen, u64 wrap, u64 empty, int shift) {
+    u64 pro = empty & wrap;
+    gen |= pro & (gen >> shift);
+    pro &= pro >> shift;
+    gen |= pro & (gen >> (2 * shift));
+    pro &= pro >> (2 * shift);
+    gen |= pro & (gen >> (4 * shift));
+    return (gen >> shift) & wrap;
+}
+
+u64 BitOps::slidingAttacks(u64 rooks, u64 bishops, u64 occupancy) {
+    u64 empty = ~occupancy;
+    return fillLeft(rooks, ~0ULL, empty, 8) | fillRight(rooks, ~0ULL, empty, 8)
+        | fillLeft(rooks, NOT_A_FILE, empty, 1) | fillRight(rooks, NOT_H_FILE, empty, 1)
+        | fillLeft(bishops, NOT_A_FILE, empty, 9) | fillRight(bishops, NOT_H_FILE, empty, 9)
+        | fillLeft(bishops, NOT_H_FILE, empty, 7) | fillRight(bishops, NOT_A_FILE, empty, 7);
+}
+#endif
\ No newline at end of file
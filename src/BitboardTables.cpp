@@ -1,36 +1,25 @@
 #include "../inc/Eval.h"
-#include <random>
+#include <cstring>
 
 
-void Eval::initMagicLookupTable() {
-    for (uint square = 0; square < 64; square++) {
-        // Generate magic number hashes for Bishops
-        bishopMagics[square] = initMagicAttacks(square, BISHOP);
-        // And the same for Rooks
-        rookMagics[square] = initMagicAttacks(square, ROOK);
-    }
-    for (uint i = 0; i < 64; i++) { std::cout << bishopMagics[i] << "," << std::endl; }
-        std::cout << "\n\n" << std::endl;
-    for (uint i = 0; i < 64; i++) { std::cout << rookMagics[i] << "," << std::endl; }
-}
-
 void Eval::initSliderAttacksLookupTable(MagicPiece bishop) {
-    std::cout << "init sliders" << std::endl;
+    uint offset = 0;
     for (uint square = 0; square < 64; square++) {
         u64 mask = bishop ? diagonalMasks[square] : cardinalMasks[square];
         uint relevantBits = bishop ? relevantBitsBishop[square] : relevantBitsRook[square];
         uint occupancyIndices = (1 << relevantBits);
+        (bishop ? bishopOffsets : rookOffsets)[square] = offset;
         for (uint i=0; i < occupancyIndices; i++) {
             u64 occupancy = initBlockersPermutation(i, relevantBits, mask);
             uint magicHash = calculateMagicHash(square, bishop, occupancy);
-            if (occupancy == 4503599627374700) { std::cout << square << ": " << magicHash << std::endl; };
             if (bishop) {
-                bishopAttacks[square][magicHash] = initBishopAttacksForPosition(square, occupancy);
+                bishopAttacks[magicHash] = initBishopAttacksForPosition(square, occupancy);
             }
             else {
-                rookAttacks[square][magicHash] = initRookAttacksForPosition(square, occupancy);
+                rookAttacks[magicHash] = initRookAttacksForPosition(square, occupancy);
             }
         } 
+        offset += 1 << (bishop ? Magics::bishopBits[square] : Magics::rookBits[square]);
     }
 }
 
@@ -45,11 +34,12 @@ u64 Eval::initBlockersPermutation(uint index, uint relevantBits, u64 mask) {
         if (index & (1 << count))
             blockers |= (1ULL << square);
     }
-    if (blockers == 4503599627374700) { std::cout << "found blockers" << std::endl; }
     return blockers;
 }
 
-u64 Eval::initMagicAttacks(uint square, MagicPiece bishop) {
+u64 Eval::initMagicAttacks(uint square, MagicPiece bishop, uint indexBits, std::mt19937_64& generator, u64 tries) {
+    // Returns a magic that maps every blocker set onto indexBits bits without a destructive collision, or 0.
+    // Only reads the masks and attack generators, so separate squares can be searched in parallel.
     u64 occupancies[4096];
     u64 attacks[4096];
     u64 usedAttacks[4096];
@@ -61,13 +51,13 @@ u64 Eval::initMagicAttacks(uint square, MagicPiece bishop) {
         attacks[i] = bishop ? initBishopAttacksForPosition(square, occupancies[i]) : initRookAttacksForPosition(square, occupancies[i]);
     }
 
-    for (uint tries = 0; tries < 100000000; tries++) {
-        u64 magicNumber = BitOps::generateMagicNumber();
+    for (u64 attempt = 0; attempt < tries; attempt++) {
+        u64 magicNumber = BitOps::generateMagicNumber(generator);
         if (BitOps::countSetBits((mask*magicNumber) & 0xFF00000000000000) < 6) { continue; }
-        std::memset(usedAttacks, 0ULL, sizeof(usedAttacks));
+        std::memset(usedAttacks, 0ULL, sizeof(u64) << indexBits);
         uint index, fail;
         for (index = 0, fail = 0; !fail && index < occupancyIndices; index++) {
-            uint magicIndex = (uint)((occupancies[index]*magicNumber) >> (64 - relevantBits));
+            uint magicIndex = (uint)((occupancies[index]*magicNumber) >> (64 - indexBits));
             u64 attackPattern = usedAttacks[magicIndex];
             if (attackPattern == 0ULL) {
                 (usedAttacks[magicIndex]) = attacks[index];
@@ -164,7 +154,7 @@ u64 Eval::initRookAttacksForPosition(uint square, u64 blockers) {
 }
 
 void Eval::initKingLookupTable() {
-    u64 location = 0;
+    u64 location = 1;
     for(uint i = 0; i < 64; i++) {
         kingMovesTable[i] = (
             ((location & edgeMasks[0]) << 8)
@@ -177,7 +167,23 @@ void Eval::initKingLookupTable() {
             |((location & edgeMasks[1] & edgeMasks[3]) >> 7)
         );
         location <<= 1;
-        if (location == 0) { location += 1; };
+    }
+};
+
+void Eval::initBetweenLookupTable() {
+    for (uint from = 0; from < 64; from++) {
+        for (uint to = 0; to < 64; to++) {
+            u64 fromBb = 1ULL << from;
+            u64 toBb = 1ULL << to;
+            betweenMasks[from][to] = 0;
+            // Two squares are aligned when each one's empty-board rays reach the other.
+            if (lookupRookAttacks(from, 0) & toBb) {
+                betweenMasks[from][to] = lookupRookAttacks(from, toBb) & lookupRookAttacks(to, fromBb);
+            }
+            else if (lookupBishopAttacks(from, 0) & toBb) {
+                betweenMasks[from][to] = lookupBishopAttacks(from, toBb) & lookupBishopAttacks(to, fromBb);
+            };
+        }
     }
 };
 
@@ -291,7 +297,7 @@ void Eval::setBitboards() {
     diagonalMasks[4] =  0b0000000000000000000000000000000000000010010001000010100000000000;
     diagonalMasks[5] =  0b0000000000000000000000000000001000000100000010000101000000000000;
     diagonalMasks[6] =  0b0000000000000000000000100000010000001000000100000010000000000000;
-    diagonalMasks[7] =  0b0000000000000010000001000000100000001000000001000100000000000000;
+    diagonalMasks[7] =  0b0000000000000010000001000000100000010000001000000100000000000000;
     
     diagonalMasks[8] =  0b0000000000100000000100000000100000000100000000100000000000000000;
     diagonalMasks[9] =  0b0000000001000000001000000001000000001000000001000000000000000000;
@@ -300,7 +306,7 @@ void Eval::setBitboards() {
     diagonalMasks[12] = 0b0000000000000000000000000000001001000100001010000000000000000000;
     diagonalMasks[13] = 0b0000000000000000000000100000010000001000010100000000000000000000;
     diagonalMasks[14] = 0b0000000000000010000001000000100000010000001000000000000000000000;
-    diagonalMasks[15] = 0b0000000000000100000010000000100000000100010000000000000000000000;
+    diagonalMasks[15] = 0b0000000000000100000010000001000000100000010000000000000000000000;
     
     diagonalMasks[16] = 0b0000000000010000000010000000010000000010000000000000001000000000;
     diagonalMasks[17] = 0b0000000000100000000100000000100000000100000000000000010000000000;
@@ -309,7 +315,7 @@ void Eval::setBitboards() {
     diagonalMasks[20] = 0b0000000000000000000000100100010000101000000000000010100000000000;
     diagonalMasks[21] = 0b0000000000000010000001000000100001010000000000000101000000000000;
     diagonalMasks[22] = 0b0000000000000100000010000001000000100000000000000010000000000000;
-    diagonalMasks[23] = 0b0000000000001000000010000000010001000000000000000100000000000000;
+    diagonalMasks[23] = 0b0000000000001000000100000010000001000000000000000100000000000000;
     
     diagonalMasks[24] = 0b0000000000001000000001000000001000000000000000100000010000000000;
     diagonalMasks[25] = 0b0000000000010000000010000000010000000000000001000000100000000000;
@@ -318,7 +324,7 @@ void Eval::setBitboards() {
     diagonalMasks[28] = 0b0000000000000010010001000010100000000000001010000100010000000000;
     diagonalMasks[29] = 0b0000000000000100000010000101000000000000010100000000100000000000;
     diagonalMasks[30] = 0b0000000000001000000100000010000000000000001000000001000000000000;
-    diagonalMasks[31] = 0b0000000000001000000001000100000000000000010000000010000000000000;
+    diagonalMasks[31] = 0b0000000000010000001000000100000000000000010000000010000000000000;
     
     diagonalMasks[32] = 0b0000000000000100000000100000000000000010000001000000100000000000;
     diagonalMasks[33] = 0b0000000000001000000001000000000000000100000010000001000000000000;
@@ -327,7 +333,7 @@ void Eval::setBitboards() {
     diagonalMasks[36] = 0b0000000001000100001010000000000000101000010001000000001000000000;
     diagonalMasks[37] = 0b0000000000001000010100000000000001010000000010000000010000000000;
     diagonalMasks[38] = 0b0000000000010000001000000000000000100000000100000000100000000000;
-    diagonalMasks[39] = 0b0000000000000100010000000000000001000000001000000001000000000000;
+    diagonalMasks[39] = 0b0000000000100000010000000000000001000000001000000001000000000000;
     
     diagonalMasks[40] = 0b0000000000000010000000000000001000000100000010000001000000000000;
     diagonalMasks[41] = 0b0000000000000100000000000000010000001000000100000010000000000000;
@@ -1,45 +1,225 @@
 #include "../inc/Board.h"
+#include <sstream>
 
 void Board::generateZobristPsuedoRandoms(u64 seed) { 
-    // Values for a from Steele GL., Vigna S. 'Computationally easy, spectrally good multipliers for congruential pseudorandom number generators', 2022.
+    // SplitMix64 (Steele GL., Lea D., Flood CH. 'Fast splittable pseudorandom number generators', 2014): every bit of each
+    // number is well mixed, so neither the full 64-bit keys nor the low bits used for table indices collide more than chance.
     // Zobrist randoms are generated for each square/piece combination, from a1-h8, with each square having 12 assigned numbers. These are in order of ascending
     // piece capture value (King = 0 => Queen = 9), with white pieces first, then black pieces. These map array addresses [0...767]. The numbers after this indicate, 
     // in order, whether it is white's turn [768], which of the 8 files contain En Passant (skipped) squares [769...776], and the castling rights of each colour, in the order 
     // white- short, long, black- short, long [777...780].
     for (int i = 0; i < 781; i++) {
-        u64 m = 1ULL << 32;
-        u64 a = 0x93d765dd;
-        seed = (seed * a) % m;
-        this->zobristPseudoRandoms[i] = seed;
+        seed += 0x9E3779B97F4A7C15ULL;
+        u64 z = seed;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        this->zobristPseudoRandoms[i] = z ^ (z >> 31);
     }
 }
 
 u64 Board::calculateZobristHash() {
-    u64 hash;
+    u64 hash = 0;
     for (int i = 2; i < 15; i++) {
         if (i == 8) { continue; };
         u64 bitboard = this->pieceLocations[i];
-        std::vector<uint> squares;
         while (bitboard > 0) {
-            squares.push_back(BitOps::countTrailingZeroes(bitboard));
-            bitboard &= ~(1ULL << squares[sizeof(squares) - 1]);
-        };
-        std::vector<uint>::iterator it;
-        for(it = squares.begin(); it != squares.end(); ++it) {
-            uint square = *it;
-            uint piece = i - 2;
-            piece = i > 8 ? piece : piece - 1;
-            u64 zobristNumber = this->zobristPseudoRandoms[(12 * square) + piece];
-            hash^=zobristNumber;
+            uint square = BitOps::countTrailingZeroes(bitboard);
+            hash ^= this->zobristPiece(i, square);
+            bitboard ^= 1ULL << square;
         };
     };
     if (this->currentTurn) { hash^=this->zobristPseudoRandoms[768]; };
     for (int i = 0; i < 8; i++) {
         if (this->enPassantFiles & (1ULL << i)) { hash^=this->zobristPseudoRandoms[769 + i]; }
     };
-    if (castlingRights & 0b1000) { hash^=zobristPseudoRandoms[777]; };
-    if (castlingRights & 0b0100) { hash^=zobristPseudoRandoms[778]; };
-    if (castlingRights & 0b0010) { hash^=zobristPseudoRandoms[779]; };
-    if (castlingRights & 0b0001) { hash^=zobristPseudoRandoms[780]; };
+    for (int i = 0; i < 4; i++) {
+        if (this->castlingRights & (1ULL << i)) { hash^=this->zobristPseudoRandoms[777 + i]; }
+    };
     return hash;
-}
\ No newline at end of file
+}
+
+// Piece letters indexed by board slot: 2-7 are the white K, P, B, N, R, Q and 9-14 the black ones.
+static const std::string FEN_PIECES = "  KPBNRQ kpbnrq";
+
+void Board::loadFEN(std::string fen) {
+    std::istringstream stream(fen);
+    std::string placement, side, castling, enPassant;
+    stream >> placement >> side >> castling >> enPassant;
+    if (enPassant.empty()) { throw std::invalid_argument("FEN needs at least four fields: " + fen); };
+    uint halfMoves = 0;
+    uint fullMoves = 1;
+    if (!(stream >> halfMoves >> fullMoves)) { halfMoves = 0; fullMoves = 1; };
+    // Some writers put 0 for the move number; it counts from 1, as unpack also assumes.
+    if (fullMoves == 0) { fullMoves = 1; };
+
+    u64 pieces[15] = {};
+    int rank = 7;
+    int file = 0;
+    for (char c : placement) {
+        if (c == '/') {
+            if (file != 8 || rank == 0) { throw std::invalid_argument("Bad FEN rank: " + fen); };
+            rank--;
+            file = 0;
+        }
+        else if (c >= '1' && c <= '8') {
+            file += c - '0';
+        }
+        else {
+            size_t piece = FEN_PIECES.find(c);
+            if (piece == std::string::npos || c == ' ' || file > 7) { throw std::invalid_argument("Bad FEN piece placement: " + fen); };
+            u64 squareBb = 1ULL << (rank * 8 + file);
+            pieces[piece] |= squareBb;
+            pieces[piece > 7 ? 8 : 1] |= squareBb;
+            pieces[0] |= squareBb;
+            file++;
+        };
+        if (file > 8) { throw std::invalid_argument("Bad FEN rank: " + fen); };
+    }
+    if (rank != 0 || file != 8) { throw std::invalid_argument("Bad FEN piece placement: " + fen); };
+    // Packed records hold at most 32 pieces, and no legal game reaches more.
+    if (BitOps::countSetBits(pieces[0]) > 32) { throw std::invalid_argument("FEN has more than 32 pieces: " + fen); };
+    if (BitOps::countSetBits(pieces[2]) != 1 || BitOps::countSetBits(pieces[9]) != 1) {
+        throw std::invalid_argument("FEN needs exactly one king per side: " + fen);
+    };
+    if (side != "w" && side != "b") { throw std::invalid_argument("Bad FEN side to move: " + fen); };
+
+    bool whiteToMove = side == "w";
+    // The side that just moved cannot have left its king in check; the search would capture it.
+    int mover = whiteToMove ? 0 : 7;
+    u64 moverAttacks = BitOps::pawnAttacks(pieces[3 + mover], whiteToMove)
+        | BitOps::knightAttacks(pieces[5 + mover])
+        | BitOps::kingAttacks(pieces[2 + mover])
+        | BitOps::slidingAttacks(pieces[6 + mover] | pieces[7 + mover], pieces[4 + mover] | pieces[7 + mover], pieces[0]);
+    if (moverAttacks & pieces[whiteToMove ? 9 : 2]) { throw std::invalid_argument("FEN side not to move is in check: " + fen); };
+
+    uint rights = 0;
+    if (castling != "-") {
+        // King and rook home squares for K, Q, k and q.
+        static const u64 CASTLING_KINGS[4] = { 1ULL << 4, 1ULL << 4, 1ULL << 60, 1ULL << 60 };
+        static const u64 CASTLING_ROOKS[4] = { 1ULL << 7, 1ULL << 0, 1ULL << 63, 1ULL << 56 };
+        for (char c : castling) {
+            size_t right = std::string("KQkq").find(c);
+            if (right == std::string::npos) { throw std::invalid_argument("Bad FEN castling rights: " + fen); };
+            int colour = right < 2 ? 0 : 7;
+            if (!(pieces[2 + colour] & CASTLING_KINGS[right]) || !(pieces[6 + colour] & CASTLING_ROOKS[right])) {
+                throw std::invalid_argument("FEN castling right without king and rook at home: " + fen);
+            };
+            rights |= 1 << right;
+        }
+    };
+    uint files = 0;
+    if (enPassant != "-") {
+        // The skipped square is on the sixth rank when white is to move and on the third when black is.
+        if (enPassant.size() != 2 || enPassant[0] < 'a' || enPassant[0] > 'h' || enPassant[1] != (whiteToMove ? '6' : '3')) {
+            throw std::invalid_argument("Bad FEN en passant square: " + fen);
+        };
+        files = 1 << (enPassant[0] - 'a');
+    };
+
+    for (int i = 0; i < 15; i++) { pieceLocations[i] = pieces[i]; }
+    currentTurn = whiteToMove;
+    castlingRights = rights;
+    enPassantFiles = files;
+    halfMoveClock = halfMoves;
+    turnsTaken = (fullMoves - 1) * 2 + !currentTurn;
+    zobristHash = calculateZobristHash();
+}
+
+std::string Board::toFEN() {
+    std::string fen;
+    for (int rank = 7; rank >= 0; rank--) {
+        int empty = 0;
+        for (int file = 0; file < 8; file++) {
+            u64 squareBb = 1ULL << (rank * 8 + file);
+            int piece = 0;
+            for (int i = 2; i < 15; i++) {
+                if (i != 8 && (pieceLocations[i] & squareBb)) { piece = i; };
+            }
+            if (!piece) { empty++; continue; };
+            if (empty) { fen += (char)('0' + empty); empty = 0; };
+            fen += FEN_PIECES[piece];
+        }
+        if (empty) { fen += (char)('0' + empty); };
+        if (rank > 0) { fen += '/'; };
+    }
+    fen += currentTurn ? " w " : " b ";
+    std::string castling;
+    for (int i = 0; i < 4; i++) {
+        if (castlingRights & (1 << i)) { castling += "KQkq"[i]; };
+    }
+    fen += castling.empty() ? "-" : castling;
+    if (enPassantFiles) {
+        fen += ' ';
+        fen += (char)('a' + BitOps::countTrailingZeroes(enPassantFiles));
+        fen += currentTurn ? '6' : '3';
+    }
+    else {
+        fen += " -";
+    };
+    fen += " " + std::to_string(halfMoveClock) + " " + std::to_string(turnsTaken / 2 + 1);
+    return fen;
+}
+bool Board::enPassantCapturePossible() {
+    if (!enPassantFiles) { return false; };
+    uint file = BitOps::countTrailingZeroes(enPassantFiles);
+    // The double-pushed pawn stands on the fifth rank from the capturing side's point of view.
+    uint rankShift = currentTurn ? 32 : 24;
+    u64 adjacent = (((file > 0) ? 1ULL << (file - 1) : 0) | ((file < 7) ? 1ULL << (file + 1) : 0)) << rankShift;
+    return (pieceLocations[currentTurn ? 3 : 10] & adjacent) != 0;
+}
+
+u64 Board::positionKey() {
+    if (!enPassantFiles || enPassantCapturePossible()) { return zobristHash; };
+    return zobristHash ^ zobristPseudoRandoms[769 + BitOps::countTrailingZeroes(enPassantFiles)];
+}
+
+PackedPosition Board::pack() {
+    if (BitOps::countSetBits(pieceLocations[0]) > 32) { throw std::invalid_argument("Cannot pack more than 32 pieces"); };
+    PackedPosition packed = {};
+    packed.occupancy = pieceLocations[0];
+    u64 occupied = pieceLocations[0];
+    for (uint index = 0; occupied; index++) {
+        uint square = BitOps::countTrailingZeroes(occupied);
+        occupied &= occupied - 1;
+        u64 squareBb = 1ULL << square;
+        for (int piece = 2; piece < 15; piece++) {
+            if (piece != 8 && (pieceLocations[piece] & squareBb)) {
+                packed.pieces[index / 2] |= (unsigned char)(piece << (4 * (index % 2)));
+                break;
+            };
+        }
+    }
+    packed.flags = (unsigned char)((currentTurn ? 1 : 0) | (castlingRights << 1));
+    packed.enPassantFile = enPassantFiles ? (unsigned char)(BitOps::countTrailingZeroes(enPassantFiles) + 1) : 0;
+    packed.halfMoveClock = (unsigned char)(halfMoveClock < 255 ? halfMoveClock : 255);
+    packed.fullMoveNumber = (unsigned short)(turnsTaken / 2 + 1);
+    return packed;
+}
+
+void Board::unpack(const PackedPosition& packed) {
+    if (BitOps::countSetBits(packed.occupancy) > 32) { throw std::invalid_argument("Packed position has more than 32 pieces"); };
+    u64 pieces[15] = {};
+    u64 occupied = packed.occupancy;
+    for (uint index = 0; occupied; index++) {
+        uint square = BitOps::countTrailingZeroes(occupied);
+        occupied &= occupied - 1;
+        int piece = (packed.pieces[index / 2] >> (4 * (index % 2))) & 15;
+        if (piece < 2 || piece == 8 || piece > 14) { throw std::invalid_argument("Packed position has a bad piece code"); };
+        u64 squareBb = 1ULL << square;
+        pieces[piece] |= squareBb;
+        pieces[piece > 7 ? 8 : 1] |= squareBb;
+        pieces[0] |= squareBb;
+    }
+    if (BitOps::countSetBits(pieces[2]) != 1 || BitOps::countSetBits(pieces[9]) != 1) {
+        throw std::invalid_argument("Packed position needs exactly one king per side");
+    };
+    if (packed.enPassantFile > 8) { throw std::invalid_argument("Packed position has a bad en passant file"); };
+    for (int i = 0; i < 15; i++) { pieceLocations[i] = pieces[i]; }
+    currentTurn = packed.flags & 1;
+    castlingRights = (packed.flags >> 1) & 15;
+    enPassantFiles = packed.enPassantFile ? 1 << (packed.enPassantFile - 1) : 0;
+    halfMoveClock = packed.halfMoveClock;
+    uint fullMoves = packed.fullMoveNumber ? packed.fullMoveNumber : 1;
+    turnsTaken = (fullMoves - 1) * 2 + !currentTurn;
+    zobristHash = calculateZobristHash();
+}
@@ -0,0 +1,144 @@
+#include "../inc/Book.h"
+#include "../inc/Eval.h"
+#include <cctype>
+#include <fstream>
+#include <sstream>
+
+bool PolyglotBook::open(const std::string& path) {
+    if (!file.open(path)) { return false; };
+    if (file.size() % POLYGLOT_ENTRY_SIZE != 0) {
+        file.close();
+        return false;
+    };
+    return true;
+}
+
+// The positions and keys the Polyglot spec publishes for checking an implementation.
+static const struct { const char* fen; u64 key; } POLYGLOT_TEST_KEYS[] = {
+    {STARTING_FEN, POLYGLOT_START_KEY},
+    {"rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", 0x823C9B50FD114196ULL},
+    {"rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2", 0x0756B94461C50FB0ULL},
+    {"rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2", 0x662FAFB965DB29D4ULL},
+    {"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3", 0x22A48B5A8E47FF78ULL},
+    {"rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR b kq - 1 3", 0x652A607CA3F242C1ULL},
+    {"rnbq1bnr/ppp1pkpp/8/3pPp2/8/8/PPPPKPPP/RNBQ1BNR w - - 2 4", 0x00FDD303C946BDD9ULL},
+    {"rnbqkbnr/p1pppppp/8/8/PpP4P/8/1P1PPPP1/RNBQKBNR b KQkq c3 0 3", 0x3C8123EA7B067637ULL},
+    {"rnbqkbnr/p1pppppp/8/8/P6P/2p5/RP1PPPP1/1NBQKBNR b Kkq - 1 4", 0x5C3F9B829B279560ULL},
+};
+
+bool PolyglotBook::loadKeys(const std::string& path) {
+    std::ifstream input(path);
+    if (!input) { return false; };
+    std::stringstream contents;
+    contents << input.rdbuf();
+    std::string text = contents.str();
+    u64 parsed[POLYGLOT_RANDOM_COUNT];
+    uint count = 0;
+    for (size_t i = 0; i + 1 < text.size() && count < POLYGLOT_RANDOM_COUNT; i++) {
+        if (text[i] != '0' || (text[i + 1] != 'x' && text[i + 1] != 'X')) { continue; };
+        size_t end = i + 2;
+        while (end < text.size() && std::isxdigit((unsigned char)text[end])) { end++; }
+        if (end - i - 2 == 16) { parsed[count++] = std::stoull(text.substr(i + 2, 16), nullptr, 16); };
+        i = end - 1;
+    }
+    if (count != POLYGLOT_RANDOM_COUNT) { return false; };
+
+    // Only accept a table that reproduces the published keys, since a wrong table silently misses every probe.
+    bool hadKeys = keysLoaded;
+    u64 previous[POLYGLOT_RANDOM_COUNT];
+    std::copy(randoms, randoms + POLYGLOT_RANDOM_COUNT, previous);
+    std::copy(parsed, parsed + POLYGLOT_RANDOM_COUNT, randoms);
+    Board board;
+    bool valid = true;
+    for (const auto& test : POLYGLOT_TEST_KEYS) {
+        board.loadFEN(test.fen);
+        valid = valid && computeKey(&board) == test.key;
+    }
+    if (!valid) {
+        std::copy(previous, previous + POLYGLOT_RANDOM_COUNT, randoms);
+        keysLoaded = hadKeys;
+        return false;
+    };
+    keysLoaded = true;
+    return true;
+}
+
+u64 PolyglotBook::computeKey(Board* board) {
+    // Polyglot piece kinds alternate black/white: pawn, knight, bishop, rook, queen, king.
+    static const int KIND[15] = {-1, -1, 11, 1, 5, 3, 7, 9, -1, 10, 0, 4, 2, 6, 8};
+    u64 key = 0;
+    for (int piece = 2; piece < 15; piece++) {
+        if (piece == 8) { continue; };
+        u64 bitboard = board->pieceLocations[piece];
+        while (bitboard) {
+            uint square = BitOps::countTrailingZeroes(bitboard);
+            bitboard &= bitboard - 1;
+            key ^= randoms[64 * KIND[piece] + square];
+        }
+    }
+    for (uint i = 0; i < 4; i++) {
+        if (board->castlingRights & (1 << i)) { key ^= randoms[768 + i]; };
+    }
+    // The en passant file only counts when a pawn of the side to move stands ready to capture.
+    if (board->enPassantCapturePossible()) { key ^= randoms[772 + BitOps::countTrailingZeroes(board->enPassantFiles)]; };
+    if (board->currentTurn) { key ^= randoms[780]; };
+    return key;
+}
+
+BookEntry PolyglotBook::readEntry(size_t index) {
+    const unsigned char* bytes = file.bytes() + index * POLYGLOT_ENTRY_SIZE;
+    BookEntry entry = {0, 0, 0, 0};
+    for (int i = 0; i < 8; i++) { entry.key = (entry.key << 8) | bytes[i]; }
+    entry.move = (u16)((bytes[8] << 8) | bytes[9]);
+    entry.weight = (u16)((bytes[10] << 8) | bytes[11]);
+    entry.learn = ((uint)bytes[12] << 24) | ((uint)bytes[13] << 16) | ((uint)bytes[14] << 8) | bytes[15];
+    return entry;
+}
+
+std::vector<BookEntry> PolyglotBook::findEntries(u64 key) {
+    std::vector<BookEntry> entries;
+    if (!isOpen()) { return entries; };
+    // Lower bound on the key, then collect the run of equal keys.
+    size_t low = 0;
+    size_t high = file.size() / POLYGLOT_ENTRY_SIZE;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (readEntry(middle).key < key) { low = middle + 1; }
+        else { high = middle; };
+    }
+    for (size_t i = low; i < file.size() / POLYGLOT_ENTRY_SIZE; i++) {
+        BookEntry entry = readEntry(i);
+        if (entry.key != key) { break; };
+        entries.push_back(entry);
+    }
+    return entries;
+}
+
+u16 PolyglotBook::pickMove(Board* board) {
+    if (!keysLoaded || !isOpen()) { return NULL_MOVE; };
+    std::vector<BookEntry> entries = findEntries(computeKey(board));
+    uint total = 0;
+    for (BookEntry& entry : entries) { total += entry.weight; }
+    if (total == 0) { return NULL_MOVE; };
+    uint pick = (uint)(generator() % total);
+    for (BookEntry& entry : entries) {
+        if (pick < entry.weight) { return toEngineMove(board, entry.move); };
+        pick -= entry.weight;
+    }
+    return NULL_MOVE;
+}
+
+u16 PolyglotBook::toEngineMove(Board* board, u16 polyglotMove) {
+    uint to = polyglotMove & 63;
+    uint from = (polyglotMove >> 6) & 63;
+    uint promotion = (polyglotMove >> 12) & 7;
+    // Polyglot promotions run knight, bishop, rook, queen; the engine's run bishop, knight, rook, queen.
+    static const uint PROMOTION[5] = {0, 2, 1, 3, 4};
+    // Castling is stored as the king capturing its own rook.
+    u64 kings = board->pieceLocations[2] | board->pieceLocations[9];
+    if (((kings >> from) & 1) && (from == 4 || from == 60)) {
+        if (to == from + 3) { to = from + 2; }
+        else if (to == from - 4) { to = from - 2; };
+    };
+    return (u16)(from | (to << 6) | ((promotion < 5 ? PROMOTION[promotion] : 0) << 12));
+}
@@ -0,0 +1,222 @@
+#include "../inc/myChess2.h"
+#include "../inc/Eval.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+static_assert(sizeof(mc2_packed_position) == sizeof(PackedPosition), "C and C++ packed layouts differ");
+
+struct mc2_engine {
+    mc2_engine() : engine(&board) {};
+    Board board;
+    Eval engine;
+};
+
+// Loads position i of a batch into the engine's board; false when it cannot be read.
+static bool loadPosition(mc2_engine* handle, const mc2_positions* positions, size_t i) {
+    try {
+        if (positions->format == MC2_FORMAT_FEN) {
+            if (!positions->fens[i]) { return false; };
+            handle->board.loadFEN(positions->fens[i]);
+        }
+        else {
+            PackedPosition packed;
+            std::memcpy(&packed, &positions->packed[i], sizeof(packed));
+            handle->board.unpack(packed);
+        };
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+    handle->engine.resetGameHistory();
+    return true;
+}
+
+static bool validBatch(mc2_engine* handle, const mc2_positions* positions) {
+    if (!handle || !positions) { return false; };
+    if (positions->format == MC2_FORMAT_FEN) { return positions->fens || positions->count == 0; };
+    if (positions->format == MC2_FORMAT_PACKED) { return positions->packed || positions->count == 0; };
+    return false;
+}
+
+// Searches every position of a batch for up to maxLines best root moves, written maxLines apart.
+static int searchBatch(mc2_engine* handle, const mc2_positions* positions, const mc2_search_limits* limits,
+                       size_t maxLines, mc2_search_result* results, uint32_t* lineCounts, int8_t* status) {
+    if (!validBatch(handle, positions)) { return MC2_ERROR_ARGUMENT; };
+    SearchLimits searchLimits;
+    if (limits) {
+        searchLimits.depth = limits->depth;
+        searchLimits.nodes = limits->nodes;
+        searchLimits.moveTime = limits->move_time_ms;
+    };
+    if (!searchLimits.depth && !searchLimits.nodes && !searchLimits.moveTime) { searchLimits.depth = 6; };
+    searchLimits.multiPV = (uint)std::min<size_t>(maxLines, 256);
+    int result = MC2_OK;
+    try {
+        for (size_t i = 0; i < positions->count; i++) {
+            mc2_search_result* lines = results + i * maxLines;
+            for (size_t line = 0; line < maxLines; line++) { lines[line] = mc2_search_result(); }
+            if (lineCounts) { lineCounts[i] = 0; };
+            bool loaded = loadPosition(handle, positions, i);
+            if (status) { status[i] = loaded ? MC2_OK : MC2_ERROR_POSITION; };
+            if (!loaded) { result = MC2_ERROR_POSITION; continue; };
+            handle->engine.stopRequested = false;
+            SearchResult searched = handle->engine.search(searchLimits);
+            // A position without legal moves still reports its score on one empty line.
+            if (searched.lines.empty()) { searched.lines.assign(1, SearchLine{NULL_MOVE, searched.score, searched.depth}); };
+            size_t count = std::min(maxLines, searched.lines.size());
+            for (size_t line = 0; line < count; line++) {
+                lines[line].best_move = searched.lines[line].move;
+                lines[line].score_cp = searched.lines[line].score;
+                lines[line].depth = searched.lines[line].depth;
+                lines[line].nodes = searched.nodes;
+            }
+            if (lineCounts) { lineCounts[i] = (uint32_t)count; };
+        }
+    }
+    catch (...) {
+        return MC2_ERROR_INTERNAL;
+    }
+    return result;
+}
+
+extern "C" {
+
+mc2_engine* mc2_engine_create(uint32_t hash_megabytes) {
+    try {
+        std::unique_ptr<mc2_engine> handle(new mc2_engine());
+        if (hash_megabytes) { handle->engine.resizeTranspositionCache(hash_megabytes); };
+        return handle.release();
+    }
+    catch (...) {
+        return nullptr;
+    }
+}
+
+void mc2_engine_destroy(mc2_engine* engine) {
+    delete engine;
+}
+
+void mc2_engine_clear(mc2_engine* engine) {
+    if (!engine) { return; };
+    engine->engine.clearTranspositionCache();
+    engine->engine.clearEvalCache();
+    engine->engine.clearSearchHeuristics();
+}
+
+int mc2_engine_set_eval_cache(mc2_engine* engine, uint32_t megabytes) {
+    if (!engine) { return MC2_ERROR_ARGUMENT; };
+    try {
+        engine->engine.resizeEvalCache(megabytes);
+    }
+    catch (...) {
+        return MC2_ERROR_INTERNAL;
+    }
+    return MC2_OK;
+}
+
+double mc2_engine_eval_cache_hit_rate(const mc2_engine* engine) {
+    return engine ? engine->engine.evalCacheHitRate() : 0;
+}
+
+int mc2_legal_moves(mc2_engine* engine, const mc2_positions* positions, uint16_t* moves,
+                    size_t max_moves, uint32_t* move_counts, int8_t* status) {
+    if (!validBatch(engine, positions) || !move_counts || (max_moves && !moves)) { return MC2_ERROR_ARGUMENT; };
+    int result = MC2_OK;
+    try {
+        for (size_t i = 0; i < positions->count; i++) {
+            move_counts[i] = 0;
+            bool loaded = loadPosition(engine, positions, i);
+            if (status) { status[i] = loaded ? MC2_OK : MC2_ERROR_POSITION; };
+            if (!loaded) { result = MC2_ERROR_POSITION; continue; };
+            Eval& eval = engine->engine;
+            std::vector<MoveData*> legal = eval.findLegalMoves(eval.isInCheck() ? eval.findEvasionMoves() : eval.findPseudoLegalMoves());
+            for (size_t m = 0; m < legal.size() && m < max_moves; m++) {
+                moves[i * max_moves + m] = legal[m]->encode();
+            }
+            move_counts[i] = (uint32_t)legal.size();
+            Eval::releaseMoves(legal);
+        }
+    }
+    catch (...) {
+        return MC2_ERROR_INTERNAL;
+    }
+    return result;
+}
+
+int mc2_evaluate(mc2_engine* engine, const mc2_positions* positions, int32_t* centipawns, int8_t* status) {
+    if (!validBatch(engine, positions) || !centipawns) { return MC2_ERROR_ARGUMENT; };
+    int result = MC2_OK;
+    try {
+        for (size_t i = 0; i < positions->count; i++) {
+            centipawns[i] = 0;
+            bool loaded = loadPosition(engine, positions, i);
+            if (status) { status[i] = loaded ? MC2_OK : MC2_ERROR_POSITION; };
+            if (!loaded) { result = MC2_ERROR_POSITION; continue; };
+            centipawns[i] = engine->engine.evaluatePosition();
+        }
+    }
+    catch (...) {
+        return MC2_ERROR_INTERNAL;
+    }
+    return result;
+}
+
+int mc2_search(mc2_engine* engine, const mc2_positions* positions, const mc2_search_limits* limits,
+               mc2_search_result* results, int8_t* status) {
+    if (!results) { return MC2_ERROR_ARGUMENT; };
+    return searchBatch(engine, positions, limits, 1, results, nullptr, status);
+}
+
+int mc2_search_lines(mc2_engine* engine, const mc2_positions* positions, const mc2_search_limits* limits,
+                     size_t max_lines, mc2_search_result* lines, uint32_t* line_counts, int8_t* status) {
+    if (!max_lines || !lines || !line_counts) { return MC2_ERROR_ARGUMENT; };
+    return searchBatch(engine, positions, limits, max_lines, lines, line_counts, status);
+}
+
+int mc2_pack_fen(const char* fen, mc2_packed_position* packed) {
+    if (!fen || !packed) { return MC2_ERROR_ARGUMENT; };
+    try {
+        Board board;
+        board.loadFEN(fen);
+        PackedPosition record = board.pack();
+        std::memcpy(packed, &record, sizeof(record));
+    }
+    catch (const std::invalid_argument&) {
+        return MC2_ERROR_POSITION;
+    }
+    catch (...) {
+        return MC2_ERROR_INTERNAL;
+    }
+    return MC2_OK;
+}
+
+int mc2_unpack_to_fen(const mc2_packed_position* packed, char* fen, size_t size) {
+    if (!packed || !fen || !size) { return MC2_ERROR_ARGUMENT; };
+    try {
+        Board board;
+        PackedPosition record;
+        std::memcpy(&record, packed, sizeof(record));
+        board.unpack(record);
+        std::string text = board.toFEN();
+        if (text.size() >= size) { return MC2_ERROR_ARGUMENT; };
+        std::memcpy(fen, text.c_str(), text.size() + 1);
+    }
+    catch (const std::invalid_argument&) {
+        return MC2_ERROR_POSITION;
+    }
+    catch (...) {
+        return MC2_ERROR_INTERNAL;
+    }
+    return MC2_OK;
+}
+
+int mc2_move_to_uci(uint16_t move, char* text, size_t size) {
+    if (!text || !size) { return MC2_ERROR_ARGUMENT; };
+    std::string notation = Eval::moveToString(move);
+    if (notation.size() >= size) { return MC2_ERROR_ARGUMENT; };
+    std::memcpy(text, notation.c_str(), notation.size() + 1);
+    return MC2_OK;
+}
+
+}
@@ -0,0 +1,208 @@
+#include "../inc/EngineProcess.h"
+#include "../inc/Clock.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+bool EngineProcess::takeLine(std::string& line) {
+    size_t newline = buffered.find('\n');
+    if (newline == std::string::npos) { return false; };
+    line = buffered.substr(0, newline);
+    buffered.erase(0, newline + 1);
+    if (!line.empty() && line.back() == '\r') { line.pop_back(); };
+    return true;
+}
+
+bool EngineProcess::waitFor(const std::string& prefix, int timeoutMs, std::string* line) {
+    long long deadline = steadyClockMilliseconds() + timeoutMs;
+    std::string text;
+    while (true) {
+        int remaining = timeoutMs < 0 ? -1 : (int)std::max(0LL, deadline - steadyClockMilliseconds());
+        if (!readLine(text, remaining)) { return false; };
+        if (text.compare(0, prefix.size(), prefix) == 0) {
+            if (line) { *line = text; };
+            return true;
+        };
+    }
+}
+
+#ifdef _WIN32
+bool EngineProcess::start(const std::string& command) {
+    stop();
+    SECURITY_ATTRIBUTES inherit = {sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE};
+    HANDLE childInput, parentInput, parentOutput, childOutput;
+    if (!CreatePipe(&childInput, &parentInput, &inherit, 0)) { return false; };
+    if (!CreatePipe(&parentOutput, &childOutput, &inherit, 0)) {
+        CloseHandle(childInput);
+        CloseHandle(parentInput);
+        return false;
+    };
+    // Only the child's ends are inherited.
+    SetHandleInformation(parentInput, HANDLE_FLAG_INHERIT, 0);
+    SetHandleInformation(parentOutput, HANDLE_FLAG_INHERIT, 0);
+    STARTUPINFOA startup = {};
+    startup.cb = sizeof(startup);
+    startup.dwFlags = STARTF_USESTDHANDLES;
+    startup.hStdInput = childInput;
+    startup.hStdOutput = childOutput;
+    startup.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+    PROCESS_INFORMATION info = {};
+    std::string commandLine = command;
+    bool started = CreateProcessA(nullptr, &commandLine[0], nullptr, nullptr, TRUE, CREATE_NO_WINDOW, nullptr, nullptr, &startup, &info);
+    CloseHandle(childInput);
+    CloseHandle(childOutput);
+    if (!started) {
+        CloseHandle(parentInput);
+        CloseHandle(parentOutput);
+        return false;
+    };
+    CloseHandle(info.hThread);
+    process = info.hProcess;
+    input = parentInput;
+    output = parentOutput;
+    buffered.clear();
+    return true;
+}
+
+void EngineProcess::stop() {
+    if (!process) { return; };
+    send("quit");
+    if (WaitForSingleObject((HANDLE)process, 1000) != WAIT_OBJECT_0) { TerminateProcess((HANDLE)process, 1); };
+    CloseHandle((HANDLE)process);
+    CloseHandle((HANDLE)input);
+    CloseHandle((HANDLE)output);
+    process = input = output = nullptr;
+}
+
+bool EngineProcess::isRunning() {
+    return process && WaitForSingleObject((HANDLE)process, 0) == WAIT_TIMEOUT;
+}
+
+bool EngineProcess::send(const std::string& line) {
+    if (!input) { return false; };
+    std::string text = line + "\n";
+    DWORD written = 0;
+    return WriteFile((HANDLE)input, text.data(), (DWORD)text.size(), &written, nullptr) && written == text.size();
+}
+
+bool EngineProcess::readLine(std::string& line, int timeoutMs) {
+    long long deadline = steadyClockMilliseconds() + timeoutMs;
+    char chunk[4096];
+    while (!takeLine(line)) {
+        if (!output) { return false; };
+        // Anonymous pipes cannot wait with a timeout, so poll for data.
+        DWORD available = 0;
+        if (!PeekNamedPipe((HANDLE)output, nullptr, 0, nullptr, &available, nullptr)) { return false; };
+        if (available == 0) {
+            if (timeoutMs >= 0 && steadyClockMilliseconds() >= deadline) { return false; };
+            Sleep(1);
+            continue;
+        };
+        DWORD read = 0;
+        if (!ReadFile((HANDLE)output, chunk, sizeof(chunk), &read, nullptr) || read == 0) { return false; };
+        buffered.append(chunk, read);
+    }
+    return true;
+}
+#else
+bool EngineProcess::start(const std::string& command) {
+    stop();
+    int toChild[2], fromChild[2];
+    if (pipe(toChild) != 0) { return false; };
+    if (pipe(fromChild) != 0) {
+        ::close(toChild[0]);
+        ::close(toChild[1]);
+        return false;
+    };
+    // Engines started by other threads must not inherit these pipes, or they would never see end of file.
+    for (int fd : {toChild[0], toChild[1], fromChild[0], fromChild[1]}) { fcntl(fd, F_SETFD, FD_CLOEXEC); }
+    // A write to an engine that has died should fail, not kill the parent.
+    signal(SIGPIPE, SIG_IGN);
+    // exec replaces the shell, so the engine itself is the child that gets killed. The string is
+    // built before forking: the child of a threaded process must not allocate.
+    std::string shellCommand = "exec " + command;
+    pid_t child = fork();
+    if (child == 0) {
+        dup2(toChild[0], STDIN_FILENO);
+        dup2(fromChild[1], STDOUT_FILENO);
+        ::close(toChild[0]);
+        ::close(toChild[1]);
+        ::close(fromChild[0]);
+        ::close(fromChild[1]);
+        execl("/bin/sh", "sh", "-c", shellCommand.c_str(), (char*)nullptr);
+        _exit(127);
+    };
+    ::close(toChild[0]);
+    ::close(fromChild[1]);
+    if (child < 0) {
+        ::close(toChild[1]);
+        ::close(fromChild[0]);
+        return false;
+    };
+    pid = child;
+    input = toChild[1];
+    output = fromChild[0];
+    buffered.clear();
+    return true;
+}
+
+void EngineProcess::stop() {
+    if (pid < 0) { return; };
+    send("quit");
+    ::close(input);
+    bool exited = reaped;
+    for (int i = 0; i < 100 && !exited; i++) {
+        exited = waitpid(pid, nullptr, WNOHANG) == pid;
+        if (!exited) { std::this_thread::sleep_for(std::chrono::milliseconds(10)); };
+    }
+    if (!exited) {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    };
+    ::close(output);
+    pid = input = output = -1;
+    reaped = false;
+}
+
+bool EngineProcess::isRunning() {
+    if (pid < 0 || reaped) { return false; };
+    reaped = waitpid(pid, nullptr, WNOHANG) == pid;
+    return !reaped;
+}
+
+bool EngineProcess::send(const std::string& line) {
+    if (input < 0) { return false; };
+    std::string text = line + "\n";
+    size_t sent = 0;
+    while (sent < text.size()) {
+        ssize_t written = write(input, text.data() + sent, text.size() - sent);
+        if (written <= 0) { return false; };
+        sent += (size_t)written;
+    }
+    return true;
+}
+
+bool EngineProcess::readLine(std::string& line, int timeoutMs) {
+    long long deadline = steadyClockMilliseconds() + timeoutMs;
+    char chunk[4096];
+    while (!takeLine(line)) {
+        if (output < 0) { return false; };
+        int remaining = timeoutMs < 0 ? -1 : (int)std::max(0LL, deadline - steadyClockMilliseconds());
+        pollfd wait = {output, POLLIN, 0};
+        if (poll(&wait, 1, remaining) <= 0) { return false; };
+        ssize_t read = ::read(output, chunk, sizeof(chunk));
+        if (read <= 0) { return false; };
+        buffered.append(chunk, (size_t)read);
+    }
+    return true;
+}
+#endif
@@ -1,9 +1,11 @@
 #include "../inc/Eval.h"
+#include "../inc/Tablebase.h"
 #include <algorithm>
+#include <cstring>
+#include <iterator>
 
 std::vector<MoveData*>Eval::findPseudoLegalMoves() {
     std::vector<MoveData*>moves;
-    std::vector<MoveData*>pseudoLegalMoves;
     
     u64 pawnLocations = board->pieceLocations[board->currentTurn ? 3 : 10];
     std::vector<MoveData*>pawnMoves = findPawnMoves(pawnLocations);
@@ -34,8 +36,54 @@ std::vector<MoveData*>Eval::findPseudoLegalMoves() {
     moves.insert(moves.end(), queenMoves.begin(), queenMoves.end());
     moves.insert(moves.end(), kingMoves.begin(), kingMoves.end());
 
+    return moves;
+}
 
-    return pseudoLegalMoves;
+std::vector<MoveData*>Eval::findEvasionMoves() {
+    // Only called when the side to move is in check, so most pseudo-legal moves are never generated.
+    std::vector<MoveData*>moves;
+    bool turn = board->currentTurn;
+    uint kingSquare = BitOps::countTrailingZeroes(board->pieceLocations[turn ? 2 : 9]);
+    u64 checkers = findAttackersOfSquare(kingSquare, !turn, board->pieceLocations[0]);
+
+    // King steps to squares that are safe once the king no longer blocks the checking rays.
+    u64 occupancy = board->pieceLocations[0] ^ (1ULL << kingSquare);
+    u64 kingTargets = kingMovesTable[kingSquare] & ~board->pieceLocations[turn ? 1 : 8];
+    kingTargets &= ~findAttackedSquares(!turn, occupancy);
+    while (kingTargets > 0) {
+        int newSquare = BitOps::countTrailingZeroes(kingTargets);
+        kingTargets ^= 1ULL << newSquare;
+        MoveData* move = new MoveData(kingSquare, newSquare);
+        move->piece = turn ? 2 : 9;
+        move->cPiece = findCapturedPiece(newSquare);
+        moves.push_back(move);
+    }
+    // Under double check only the king can move.
+    if (BitOps::countSetBits(checkers) > 1) { return moves; };
+
+    // Otherwise capture the checker or block the ray between it and the king.
+    uint checkerSquare = BitOps::countTrailingZeroes(checkers);
+    u64 targets = checkers | betweenMasks[kingSquare][checkerSquare];
+    u64 enPassantBitboard = (u64)board->enPassantFiles << (turn ? 40 : 16);
+    u64 pawnTargets = targets;
+    if (enPassantBitboard && (checkers & board->pieceLocations[turn ? 10 : 3])) {
+        // A checking pawn that has just double pushed can also be taken en passant.
+        pawnTargets |= enPassantBitboard;
+    };
+    int offset = turn ? 0 : 7;
+    std::vector<MoveData*>pawnMoves = findPawnMoves(board->pieceLocations[3 + offset], pawnTargets);
+    std::vector<MoveData*>bishopMoves = findBishopMoves(board->pieceLocations[4 + offset], false, targets);
+    std::vector<MoveData*>knightMoves = findKnightMoves(board->pieceLocations[5 + offset], targets);
+    std::vector<MoveData*>rookMoves = findRookMoves(board->pieceLocations[6 + offset], false, targets);
+    std::vector<MoveData*>queenDiagonalMoves = findBishopMoves(board->pieceLocations[7 + offset], true, targets);
+    std::vector<MoveData*>queenCardinalMoves = findRookMoves(board->pieceLocations[7 + offset], true, targets);
+    moves.insert(moves.end(), pawnMoves.begin(), pawnMoves.end());
+    moves.insert(moves.end(), bishopMoves.begin(), bishopMoves.end());
+    moves.insert(moves.end(), knightMoves.begin(), knightMoves.end());
+    moves.insert(moves.end(), rookMoves.begin(), rookMoves.end());
+    moves.insert(moves.end(), queenDiagonalMoves.begin(), queenDiagonalMoves.end());
+    moves.insert(moves.end(), queenCardinalMoves.begin(), queenCardinalMoves.end());
+    return moves;
 }
 
 std::vector<MoveData*> Eval::findLegalMoves(std::vector<MoveData*> moveList) {
@@ -45,16 +93,36 @@ std::vector<MoveData*> Eval::findLegalMoves(std::vector<MoveData*> moveList) {
         MoveData* move = *it;
         doMove(move);
         bool checksSelf = !checksAreValid();
+        undoMove(move);
         if (!checksSelf) {
             this->calculateMoveOrderScore(move);
             legalMoves.push_back(move);
         }
-        undoMove(move);
+        else {
+            delete move;
+        }
     }
     std::sort(legalMoves.begin(), legalMoves.end(), compareByScore);
     return legalMoves;
 }
 
+void Eval::releaseMoves(std::vector<MoveData*>& moves) {
+    std::vector<MoveData*>::iterator it;
+    for (it = moves.begin(); it != moves.end(); ++it) { delete *it; }
+    moves.clear();
+}
+
+int Eval::findCapturedPiece(int square) {
+    u64 squareBb = 1ULL << square;
+    if (!(board->pieceLocations[0] & squareBb)) { return -1; };
+    int start = board->currentTurn ? 10 : 3;
+    int end = board->currentTurn ? 15 : 8;
+    for (int i = start; i < end; i++) {
+        if (board->pieceLocations[i] & squareBb) { return i; };
+    }
+    return -1;
+}
+
 std::vector<MoveData*> Eval::findKingMoves(uint square) {
     std::vector<MoveData*> kingMoves;
     bool turn = board->currentTurn;
@@ -63,101 +131,76 @@ std::vector<MoveData*> Eval::findKingMoves(uint square) {
     
     while (movesBitboard > 0) {
         int newSquare = BitOps::countTrailingZeroes(movesBitboard);
-        int start = turn ? 10 : 3;
-        int end = turn ? 15 : 8;
-        int cPiece = 0;
-        for (int i = start; i < end; i++) {
-            if (board->pieceLocations[i] & (1ULL << newSquare)) { cPiece = i; };
-        }
-
         MoveData* move = new MoveData(square, newSquare);
         move->piece = piece;
-        move->cPiece = cPiece;
+        move->cPiece = findCapturedPiece(newSquare);
         movesBitboard ^= (1ULL << newSquare);
 
         kingMoves.push_back(move);
     }
 
+    // Castling: the right must remain, the squares between king and rook must be empty, and the king
+    // may not start in, pass through or land on an attacked square.
     uint relevantCastle = 1;
     relevantCastle <<= (2 * !turn);
     u64 longCastleMask = 0b00001110;
     u64 shortCastleMask = 0b01100000;
     if (!board->currentTurn) { longCastleMask <<= 56; shortCastleMask <<= 56; };
-    if ((board->castlingRights & (relevantCastle << 1))  & !(longCastleMask & board->pieceLocations[0])) {
-        MoveData* castleMove = new MoveData(square, turn ? 2 : 58);
-        castleMove->piece = piece;
-        castleMove->cPiece = 0;
-        kingMoves.push_back(castleMove);
-    };
-    if ((board->castlingRights & (relevantCastle)) & !(shortCastleMask & board->pieceLocations[0])) {
-        MoveData* castleMove = new MoveData(square, turn ? 6 : 62);
-        castleMove->piece = piece;
-        castleMove->cPiece = 0;
-        kingMoves.push_back(castleMove);
+    u64 occupancy = board->pieceLocations[0];
+    bool canCastleLong = (board->castlingRights & (relevantCastle << 1)) && !(longCastleMask & occupancy);
+    bool canCastleShort = (board->castlingRights & relevantCastle) && !(shortCastleMask & occupancy);
+    if ((canCastleLong || canCastleShort) && !findAttackersOfSquare(square, !turn, occupancy)) {
+        if (canCastleLong && !findAttackersOfSquare(square - 1, !turn, occupancy) && !findAttackersOfSquare(square - 2, !turn, occupancy)) {
+            MoveData* castleMove = new MoveData(square, turn ? 2 : 58);
+            castleMove->piece = piece;
+            kingMoves.push_back(castleMove);
+        };
+        if (canCastleShort && !findAttackersOfSquare(square + 1, !turn, occupancy) && !findAttackersOfSquare(square + 2, !turn, occupancy)) {
+            MoveData* castleMove = new MoveData(square, turn ? 6 : 62);
+            castleMove->piece = piece;
+            kingMoves.push_back(castleMove);
+        };
     };
     return kingMoves;
 }
 
-std::vector<MoveData*> Eval::findPawnMoves(u64 bitboard) {
+std::vector<MoveData*> Eval::findPawnMoves(u64 bitboard, u64 targets) {
     std::vector<MoveData*> pawnMoves;
     bool turn = board->currentTurn; 
     int piece = turn ? 3 : 10;
+    u64 emptySquares = ~board->pieceLocations[0];
     u64 opponentPieces = board->currentTurn ? board->pieceLocations[8] : board->pieceLocations[1];
+    u64 enPassantBitboard = (u64)board->enPassantFiles << (board->currentTurn ? 40 : 16);
     while (bitboard != 0) {
         int oldSquare = BitOps::countTrailingZeroes(bitboard);
-        int newSquare;
-        bool firstMove = turn ? (oldSquare >= 8 && oldSquare < 16) : (oldSquare >= 48 && oldSquare < 56);
-        u64 enPassantBitboard = board->enPassantFiles << (board->currentTurn ? 40 : 16);
+        u64 oldSqBb = 1ULL << oldSquare;
 
-        if (!((turn ? newSquare = (oldSquare + 8) : newSquare = (oldSquare - 8)) & opponentPieces)) {
-            MoveData* move = new MoveData(oldSquare, newSquare);
-            move->piece;
-            move->cPiece;
-            std::vector<MoveData*> promoMoves = addPawnMove(move);
-            pawnMoves.insert(pawnMoves.end(), promoMoves.begin(), promoMoves.end());
-            if (!(1ULL << (turn ? newSquare = (oldSquare + 16) : newSquare = (oldSquare - 16)) & opponentPieces)) {
-                MoveData* doubleMove = new MoveData(oldSquare, newSquare);
-                doubleMove->piece = piece;
-                doubleMove->cPiece = 0;
-                pawnMoves.push_back(doubleMove);
-            }
+        // Single pushes, and double pushes for pawns whose single push lands on their third rank.
+        u64 pushes = (turn ? oldSqBb << 8 : oldSqBb >> 8) & emptySquares;
+        if (pushes & pawnMasks[turn ? 0 : 1]) {
+            pushes |= (turn ? pushes << 8 : pushes >> 8) & emptySquares;
         };
-        if (oldSquare % 8 != 0 &&
-            1ULL << (turn ? newSquare = (oldSquare + 7) : newSquare = (oldSquare - 9)) & (opponentPieces | enPassantBitboard)
-        ) {
-            int start = turn ? 10 : 3;
-            int end = turn ? 15 : 8;
-            int cPiece = 0;
-            for (int i = start ; i < end; i++) {
-                if ((1ULL << newSquare) & enPassantBitboard) {cPiece = start; };
-                if (board->pieceLocations[i] & (1ULL << newSquare)) { cPiece = i; };
-            }
-            MoveData* move = new MoveData(oldSquare, newSquare);
-            move->piece = piece;
-            move->cPiece = cPiece;            
-            pawnMoves.insert(pawnMoves.end(), addPawnMove(move).begin(), addPawnMove(move).begin());
-        }
-        if (oldSquare % 8 != 7 &&
-            1ULL << (turn ? newSquare = (oldSquare + 9) : newSquare = (oldSquare - 7)) & (opponentPieces | enPassantBitboard)
-        ) {
-            int start = turn ? 10 : 3;
-            int end = turn ? 15 : 8;
-            int cPiece = 0;
-            for (int i = start ; i < end; i++) {
-                if ((1ULL << newSquare) & enPassantBitboard) {cPiece = start; };
-                if (board->pieceLocations[i] & (1ULL << newSquare)) { cPiece = i; };
-            }
+        u64 captures = turn
+            ? ((oldSqBb & edgeMasks[2]) << 7) | ((oldSqBb & edgeMasks[3]) << 9)
+            : ((oldSqBb & edgeMasks[2]) >> 9) | ((oldSqBb & edgeMasks[3]) >> 7);
+        captures &= opponentPieces | enPassantBitboard;
+
+        u64 movesBitboard = (pushes | captures) & targets;
+        while (movesBitboard > 0) {
+            int newSquare = BitOps::countTrailingZeroes(movesBitboard);
             MoveData* move = new MoveData(oldSquare, newSquare);
             move->piece = piece;
-            move->cPiece = cPiece;
-            pawnMoves.insert(pawnMoves.end(), addPawnMove(move).begin(), addPawnMove(move).begin());
+            move->cPiece = ((1ULL << newSquare) & enPassantBitboard) ? (turn ? 10 : 3) : findCapturedPiece(newSquare);
+            std::vector<MoveData*> promoMoves = addPawnMove(move);
+            pawnMoves.insert(pawnMoves.end(), promoMoves.begin(), promoMoves.end());
+            movesBitboard ^= 1ULL << newSquare;
         }
         bitboard ^= 1ULL << oldSquare;
     }
     return pawnMoves;
 }
 
-std::vector<MoveData*>Eval::findBishopMoves(u64 bitboard, bool isQueen) {
+std::vector<MoveData*>Eval::findBishopMoves(u64 bitboard, bool isQueen, u64 targets) {
     std::vector<MoveData*>bishopMoves;
     int square;
     bool turn = board->currentTurn;
@@ -166,22 +209,13 @@ std::vector<MoveData*>Eval::findBishopMoves(u64 bitboard, bool isQueen) {
     piece = isQueen ? queen : piece;
     while (bitboard > 0) {
         square = BitOps::countTrailingZeroes(bitboard);
-        u64 mask = diagonalMasks[square];
-        u64 relevantSquares = board->pieceLocations[0] & mask;
-        u64 magicNumber = bishopMagics[square];
-        uint shiftIndex = 64 - relevantBitsBishop[square];
-        u64 movesBitboard = bishopAttacks[square][(relevantSquares * magicNumber) >> shiftIndex];
+        u64 movesBitboard = lookupBishopAttacks(square, board->pieceLocations[0]);
+        movesBitboard &= ~(board->pieceLocations[turn ? 1 : 8]) & targets;
         while (movesBitboard > 0) {
             int newSquare = BitOps::countTrailingZeroes(movesBitboard);
-            int start = turn ? 10 : 3;
-            int end = turn ? 15 : 8;
-            int cPiece = 0;
-            for (int i = start ; i < end; i++) {
-                if (board->pieceLocations[i] & (1ULL << newSquare)) { cPiece = i; };
-            }
             MoveData* move = new MoveData(square, newSquare);
             move->piece = piece;
-            move->cPiece = cPiece;
+            move->cPiece = findCapturedPiece(newSquare);
             bishopMoves.push_back(move);
             movesBitboard ^= (1ULL << newSquare);
         }
@@ -190,25 +224,19 @@ std::vector<MoveData*>Eval::findBishopMoves(u64 bitboard, bool isQueen) {
     return bishopMoves;
 }
 
-std::vector<MoveData*>Eval::findKnightMoves(u64 bitboard) {
+std::vector<MoveData*>Eval::findKnightMoves(u64 bitboard, u64 targets) {
     std::vector<MoveData*>knightMoves;
     bool turn = board->currentTurn;
     int square;
     int piece = turn ? 5 : 12;
     while (bitboard > 0) {
         square = BitOps::countTrailingZeroes(bitboard);
-        u64 movesBitboard = knightMovesTable[square] & ~(board->pieceLocations[turn ? 1 : 8]);
+        u64 movesBitboard = knightMovesTable[square] & ~(board->pieceLocations[turn ? 1 : 8]) & targets;
         while (movesBitboard > 0) {
             int newSquare = BitOps::countTrailingZeroes(movesBitboard);
-            int start = turn ? 10 : 3;
-            int end = turn ? 15 : 8;
-            int cPiece = 0;
-            for (int i = start ; i < end; i++) {
-                if (board->pieceLocations[i] & (1ULL << newSquare)) { cPiece = i; };
-            }
             MoveData* move = new MoveData(square, newSquare);
             move->piece = piece;
-            move->cPiece = cPiece;
+            move->cPiece = findCapturedPiece(newSquare);
             knightMoves.push_back(move);
             movesBitboard ^= (1ULL << newSquare);
         }
@@ -217,7 +245,7 @@ std::vector<MoveData*>Eval::findKnightMoves(u64 bitboard) {
     return knightMoves;
 }
 
-std::vector<MoveData*>Eval::findRookMoves(u64 bitboard, bool isQueen) {
+std::vector<MoveData*>Eval::findRookMoves(u64 bitboard, bool isQueen, u64 targets) {
     std::vector<MoveData*>rookMoves;
     int square;
     bool turn = board->currentTurn;
@@ -226,22 +254,13 @@ std::vector<MoveData*>Eval::findRookMoves(u64 bitboard, bool isQueen) {
     piece = isQueen ? queen : piece;
     while (bitboard > 0) {
         square = BitOps::countTrailingZeroes(bitboard);
-        u64 mask = cardinalMasks[square];
-        u64 relevantSquares = board->pieceLocations[0] & mask;
-        u64 magicNumber = rookMagics[square];
-        uint shiftIndex = 64 - relevantBitsRook[square];
-        u64 movesBitboard = rookAttacks[square][(relevantSquares * magicNumber) >> shiftIndex];
+        u64 movesBitboard = lookupRookAttacks(square, board->pieceLocations[0]);
+        movesBitboard &= ~(board->pieceLocations[turn ? 1 : 8]) & targets;
         while (movesBitboard > 0) {
             int newSquare = BitOps::countTrailingZeroes(movesBitboard);
-            int start = turn ? 10 : 3;
-            int end = turn ? 15 : 8;
-            int cPiece = 0;
-            for (int i = start ; i < end; i++) {
-                if (board->pieceLocations[i] & (1ULL << newSquare)) { cPiece = i; };
-            }
             MoveData* move = new MoveData(square, newSquare);
             move->piece = piece;
-            move->cPiece = cPiece;
+            move->cPiece = findCapturedPiece(newSquare);
             rookMoves.push_back(move);
             movesBitboard ^= (1ULL << newSquare);
         }
@@ -250,390 +269,441 @@ std::vector<MoveData*>Eval::findRookMoves(u64 bitboard, bool isQueen) {
     return rookMoves;
 }
 
+u64 Eval::lookupBishopAttacks(uint square, u64 occupancy) {
+    return bishopAttacks[calculateMagicHash(square, BISHOP, occupancy)];
+}
+
+u64 Eval::lookupRookAttacks(uint square, u64 occupancy) {
+    return rookAttacks[calculateMagicHash(square, ROOK, occupancy)];
+}
+
+u64 Eval::findAttackersOfSquare(uint square, bool byWhite, u64 occupancy) {
+    int offset = byWhite ? 0 : 7;
+    u64 squareBb = 1ULL << square;
+    // A pawn attacks this square exactly when a pawn of the other colour here would attack it.
+    u64 pawnSources = byWhite
+        ? ((squareBb & edgeMasks[2]) >> 9) | ((squareBb & edgeMasks[3]) >> 7)
+        : ((squareBb & edgeMasks[2]) << 7) | ((squareBb & edgeMasks[3]) << 9);
+    u64 diagonalSliders = board->pieceLocations[4 + offset] | board->pieceLocations[7 + offset];
+    u64 cardinalSliders = board->pieceLocations[6 + offset] | board->pieceLocations[7 + offset];
+    return (pawnSources & board->pieceLocations[3 + offset])
+        | (knightMovesTable[square] & board->pieceLocations[5 + offset])
+        | (kingMovesTable[square] & board->pieceLocations[2 + offset])
+        | (lookupBishopAttacks(square, occupancy) & diagonalSliders & occupancy)
+        | (lookupRookAttacks(square, occupancy) & cardinalSliders & occupancy);
+}
+
+u64 Eval::findAttackedSquares(bool byWhite, u64 occupancy) {
+    // Whole-side attack map, built set-wise rather than piece by piece.
+    int offset = byWhite ? 0 : 7;
+    u64 pawns = board->pieceLocations[3 + offset];
+    u64 queens = board->pieceLocations[7 + offset];
+    u64 pawnAttacks = byWhite
+        ? ((pawns & edgeMasks[2]) << 7) | ((pawns & edgeMasks[3]) << 9)
+        : ((pawns & edgeMasks[2]) >> 9) | ((pawns & edgeMasks[3]) >> 7);
+    uint kingSquare = BitOps::countTrailingZeroes(board->pieceLocations[2 + offset]);
+    return pawnAttacks
+        | BitOps::knightAttacks(board->pieceLocations[5 + offset])
+        | (kingSquare < 64 ? kingMovesTable[kingSquare] : 0)
+        | BitOps::slidingAttacks(board->pieceLocations[6 + offset] | queens, board->pieceLocations[4 + offset] | queens, occupancy);
+}
+
+u64 Eval::findAttacksThisSquare(uint square) {
+    return findAttackersOfSquare(square, !board->currentTurn, board->pieceLocations[0]);
+}
+
 uint Eval::calculateMagicHash(uint square, MagicPiece bishop, u64 occupancy) {
+    // Index into the flat attack table: the square's offset plus the magic hash of its blockers.
     uint hash;
-    u64 magicNumber = bishop ? this->bishopMagics[square] : this->rookMagics[square];
+    u64 magicNumber = bishop ? Magics::bishop[square] : Magics::rook[square];
     u64 mask = bishop ? this->diagonalMasks[square] : this->cardinalMasks[square];
-    uint relevantBits = bishop ? this->relevantBitsBishop[square] : this->relevantBitsRook[square]; 
+    uint indexBits = bishop ? Magics::bishopBits[square] : Magics::rookBits[square];
     u64 blockers = occupancy & mask;
-    hash = (uint)((blockers * magicNumber) >> (64 - relevantBits));
-    return hash;
+    hash = (uint)((blockers * magicNumber) >> (64 - indexBits));
+    return (bishop ? bishopOffsets : rookOffsets)[square] + hash;
 }
 
 void Eval::addTransposition(Transposition tp) {
+    STATS_SCOPE(stats, TIMER_TRANSPOSITION);
     //TODO: add replacement logic
 
-    transpositionCache[tp.key % TRANSPOSITION_CACHE_SIZE] = tp;
+    transpositionCache[tp.key & transpositionMask] = tp;
 };
 
-float Eval::checkTransposition(u64 hashKey, uint depth, float alpha, float beta) {
-    Transposition tp = transpositionCache[hashKey % TRANSPOSITION_CACHE_SIZE];
+Score Eval::checkTransposition(u64 hashKey, uint depth, Score alpha, Score beta) {
+    STATS_SCOPE(stats, TIMER_TRANSPOSITION);
+    STATS_INC(stats, STAT_TT_PROBES);
+    Transposition tp = transpositionCache[hashKey & transpositionMask];
+    if (tp.key == hashKey) { STATS_INC(stats, STAT_TT_HITS); };
     if (tp.key == hashKey && tp.depth >= depth) {
-        if (tp.type == EXACT) { return tp.eval; };
-        if (tp.type == ALPHA && tp.eval <= alpha)  { return alpha; };
-        if (tp.type == BETA && tp.eval >= beta)  { return beta; };
+        Score eval = Scores::fromTransposition(tp.eval, currentDepth);
+        if (tp.type == EXACT) { STATS_INC(stats, STAT_TT_CUTOFFS); return eval; };
+        if (tp.type == ALPHA && eval <= alpha)  { STATS_INC(stats, STAT_TT_CUTOFFS); return alpha; };
+        if (tp.type == BETA && eval >= beta)  { STATS_INC(stats, STAT_TT_CUTOFFS); return beta; };
     };
-    return INVALID_TRANSPOSITION_EVAL;
+    return SCORE_NONE;
 };
 
-float Eval::evaluatePosition() {
-    const float PIECEVALUES[7] = {0, 0, 1, 3, 3, 5, 9};
-    float score = 0;
-    for (int i = 3; i < 15; i++) {
-        // Assess relative piece value
-        if (i == 8 || i == 9) { continue; }
-        u64 bitboard = board->pieceLocations[i];
-        score += BitOps::countSetBits(bitboard) * PIECEVALUES[((i-1)  % 7)];
-        // while (bitboard > 0) {
-        //     uint square = BitOps::countTrailingZeroes(bitboard);
-        //     float multiplier = DEFAULT_VALUE_MODIFIER;
-        //     if (i == 5 || i == 12) { HeatMaps::knight[square]; };
-        //     float pieceValue = PIECEVALUES[((i-1)  % 7)] * (i < 8 ? 1 : -1);
-        //     score += pieceValue * multiplier;
-        //     bitboard ^= 1ULL << square;
-        // }
-    }
-    // Assess pawn structure
-    // u64 whitePawns = board->pieceLocations[3];
-    // u64 blackPawns = board->pieceLocations[10];
-    // u64 whitePawnChains = ((whitePawns & edgeMasks[2]) << 7 || (whitePawns & edgeMasks[3]) << 9) & whitePawns;
-    // u64 blackPawnChains = ((blackPawns & edgeMasks[3]) >> 7 || (blackPawns & edgeMasks[2]) >> 9) & blackPawns;
-    // score += (float)PAWN_CHAIN_VALUE * BitOps::countSetBits(whitePawnChains);
-    // score -= (float)PAWN_CHAIN_VALUE * BitOps::countSetBits(blackPawnChains);
-    // u64 whitePawnStacks = 0;
-    // u64 blackPawnStacks = 0;
-    // for (uint rank = 1; rank < 8; ++rank) {
-    //     whitePawnStacks |= (whitePawns << rank * 8) & whitePawns;
-    //     blackPawnStacks |= (blackPawns >> rank * 8) & blackPawns;
-    // }
-    // score += (float)PAWN_STACK_VALUE * BitOps::countSetBits(blackPawnStacks);
-    // score -= (float)PAWN_STACK_VALUE * BitOps::countSetBits(whitePawnStacks);
-
-    // Assess whether favourable captures exist (attack/defend bitboards)
-    return score;
+void Eval::resizeTranspositionCache(uint megabytes) {
+    // Round down to a power of two so slots can be found with a mask.
+    u64 entries = ((u64)megabytes << 20) / sizeof(Transposition);
+    u64 size = 1024;
+    while (size * 2 <= entries) { size *= 2; }
+    transpositionCache.assign(size, Transposition());
+    transpositionMask = size - 1;
+};
+
+void Eval::clearTranspositionCache() {
+    std::fill(transpositionCache.begin(), transpositionCache.end(), Transposition());
+};
+
+void Eval::prefetchTransposition(u64 hashKey) {
+    BitOps::prefetch(&transpositionCache[hashKey & transpositionMask]);
+};
+
+void Eval::resizeEvalCache(uint megabytes) {
+    u64 entries = ((u64)megabytes << 20) / sizeof(u64);
+    u64 size = entries ? 1 : 0;
+    while (size && size * 2 <= entries) { size *= 2; }
+    evalCache.assign(size, 0);
+    evalCacheMask = size ? size - 1 : 0;
+};
+
+void Eval::clearEvalCache() {
+    std::fill(evalCache.begin(), evalCache.end(), 0);
 };
 
-float Eval::evalAlphaBeta(uint depth, float alpha, float beta) {
-    if (depth == 0) { float score = evaluatePosition(); return score; };
-    std::vector<MoveData*> moves = findLegalMoves(findPseudoLegalMoves());
-    std::vector<MoveData*>::iterator iterator;
-    if (moves.size() == 0) {
-        return INFINITY * board->currentTurn ? 1.0f : -1.0f;
+double Eval::evalCacheHitRate() const {
+    return evalCacheProbes ? (double)evalCacheHits / evalCacheProbes : 0;
+};
+
+Score Eval::evaluatePosition() {
+    STATS_SCOPE(stats, TIMER_EVALUATION);
+    // The evaluation ignores side to move, castling and en passant, but they stay in the key: the
+    // few extra misses are cheaper than a second hash.
+    u64* slot = evalCache.empty() ? nullptr : &evalCache[board->zobristHash & evalCacheMask];
+    if (slot) {
+        evalCacheProbes++;
+        if (((*slot ^ board->zobristHash) >> 16) == 0) {
+            evalCacheHits++;
+            return (Score)(u16)*slot;
+        };
     };
-    if (float eval = checkTransposition(board->zobristHash, depth, alpha, beta) != INVALID_TRANSPOSITION_EVAL) {
-        return eval;
+    EvalTerms terms;
+    findEvalTerms(board, terms);
+    Score score = Scores::fromPawns(weighTerms(weights, terms));
+    if (slot) { *slot = (board->zobristHash & ~0xFFFFULL) | (u16)score; };
+    return score;
+};
+
+void Eval::findEvalTerms(Board* board, EvalTerms& terms) {
+    const u64 notAFile = 0xFEFEFEFEFEFEFEFEULL;
+    const u64 notHFile = 0x7F7F7F7F7F7F7F7FULL;
+    for (int i = 3; i < 8; i++) {
+        // Relative piece counts
+        terms.material[i - 1] = BitOps::countSetBits(board->pieceLocations[i]) - BitOps::countSetBits(board->pieceLocations[i + 7]);
     }
-    if (board->currentTurn) {
-        float eval = -INFINITY;
-        std::vector<MoveData*>::iterator it;
-        MoveData* storeMove;
-        NodeType tpNodeType;
-        for (it = moves.begin(); it != moves.end(); ++it) {
-            MoveData* move = *it;
-            doMove(move);
-            eval = std::max(eval, evalAlphaBeta((depth - 1), alpha, beta));
-            if (eval >= beta) {
-                killers[currentDepth].addNewKiller(move);
-                storeMove = move;
-                tpNodeType = BETA;
-                undoMove(move);
-                break;
-            }
-            else if (eval > alpha) {
-                alpha = eval;
-                storeMove = move;
-                tpNodeType = EXACT;
-            }
-            else {
-                storeMove = move;
-                tpNodeType = ALPHA;
-            }
-            undoMove(move);
-        }
-        Transposition tp;
-        tp.init(board->zobristHash, storeMove, depth, eval, tpNodeType);
-        addTransposition(tp);
-        return eval;
+    // Pawn structure: pawns defended by a pawn, and pawns with a friendly pawn behind them.
+    u64 whitePawns = board->pieceLocations[3];
+    u64 blackPawns = board->pieceLocations[10];
+    u64 whitePawnChains = (((whitePawns & notAFile) << 7) | ((whitePawns & notHFile) << 9)) & whitePawns;
+    u64 blackPawnChains = (((blackPawns & notHFile) >> 7) | ((blackPawns & notAFile) >> 9)) & blackPawns;
+    terms.pawnChains = BitOps::countSetBits(whitePawnChains) - BitOps::countSetBits(blackPawnChains);
+    u64 whitePawnStacks = 0;
+    u64 blackPawnStacks = 0;
+    for (uint rank = 1; rank < 8; ++rank) {
+        whitePawnStacks |= (whitePawns << rank * 8) & whitePawns;
+        blackPawnStacks |= (blackPawns >> rank * 8) & blackPawns;
     }
-    else {
-        float eval = INFINITY;
-        std::vector<MoveData*>::iterator it;
-        MoveData* storeMove;
-        NodeType tpNodeType;
-        for (it = moves.begin(); it != moves.end(); ++it) {
-            MoveData* move = *it;
-            doMove(move);
-            eval = std::min(eval, evalAlphaBeta(depth - 1, alpha, beta));
-            if (eval <= alpha) {
-                killers[currentDepth].addNewKiller(move);
-                storeMove = move;
-                tpNodeType = ALPHA;
-                undoMove(move);
-                break;
-            }
-            else if (eval < beta) {
-                beta = eval;
-                storeMove = move;
-                tpNodeType = EXACT;
-            }
-            else {
-                storeMove = move;
-                tpNodeType = BETA;
-            }
-            undoMove(move);
+    terms.pawnStacks = BitOps::countSetBits(whitePawnStacks) - BitOps::countSetBits(blackPawnStacks);
+    // Knight placement, with black's squares mirrored onto white's side.
+    for (int i = 5; i <= 12; i += 7) {
+        u64 knights = board->pieceLocations[i];
+        while (knights && terms.knightCount < 20) {
+            uint square = BitOps::countTrailingZeroes(knights);
+            knights &= knights - 1;
+            terms.knights[terms.knightCount++] = (unsigned char)(i == 5 ? square : (square ^ 56) | 64);
         }
-        Transposition tp;
-        tp.init(board->zobristHash, storeMove, depth, eval, tpNodeType);
-        addTransposition(tp);
-        return eval;
     }
-        
+}
+
+float Eval::weighTerms(const EvalWeights& weights, const EvalTerms& terms) {
+    float score = 0;
+    for (int i = 2; i < 7; i++) { score += terms.material[i] * weights.pieceValues[i]; }
+    score += terms.pawnChains * weights.pawnChain;
+    score += terms.pawnStacks * weights.pawnStack;
+    for (int i = 0; i < terms.knightCount; i++) {
+        float bonus = weights.knightSquares[terms.knights[i] & 63];
+        score += terms.knights[i] & 64 ? -bonus : bonus;
+    }
+    return score;
+}
+
+bool Eval::isInCheck() {
+    // checksAreValid tests the king of the side that just moved, so view the board from the other side.
+    board->currentTurn = !board->currentTurn;
+    bool inCheck = !checksAreValid();
+    board->currentTurn = !board->currentTurn;
+    return inCheck;
+};
+
+bool Eval::hasNonPawnMaterial() {
+    int offset = board->currentTurn ? 0 : 7;
+    u64 pieces = board->pieceLocations[4 + offset] | board->pieceLocations[5 + offset]
+        | board->pieceLocations[6 + offset] | board->pieceLocations[7 + offset];
+    return pieces != 0;
+};
+
+bool Eval::isZugzwangProne() {
+    // With a single minor or major piece left, passing can genuinely be the best option.
+    int offset = board->currentTurn ? 0 : 7;
+    u64 pieces = board->pieceLocations[4 + offset] | board->pieceLocations[5 + offset]
+        | board->pieceLocations[6 + offset] | board->pieceLocations[7 + offset];
+    return BitOps::countSetBits(pieces) <= 1;
 };
 
 void Eval::doMove(MoveData* move) {
+    STATS_SCOPE(stats, TIMER_MAKE_UNMAKE);
     bool turn = board->currentTurn;
     u64* allBb = &board->pieceLocations[0];
     u64* friendlyBb = turn ? &board->pieceLocations[1] : &board->pieceLocations[8];
     u64* enemyBb = turn ? &board->pieceLocations[8] : &board->pieceLocations[1];
-    u64* pieceBb =  &board->pieceLocations[move->piece];
-    u64* cPieceBb = pieceBb;
-    u64* pPieceBb = pieceBb;
 
     int oldSq = move->oldSquare;
     int newSq = move->newSquare;
     u64 oldSqBb = 1ULL << oldSq;
     u64 newSqBb = 1ULL << newSq;
-
-    u64* hash = &board->zobristHash;
-    u64 oldZobristPiece = board->zobristPseudoRandoms[move->piece - (2 + (move->piece > 7)) + (oldSq * 12)];
-    u64 newZobristPiece = board->zobristPseudoRandoms[move->piece - (2 + (move->piece > 7)) + (newSq * 12)];
-    u64 cZobristPiece = board->zobristPseudoRandoms[move->cPiece - (2 + (move->cPiece > 7)) + (newSq * 12)];
-    u64 pZobristPiece = board->zobristPseudoRandoms[move->pPiece - (2 + (move->pPiece > 7)) + (newSq * 12)];
-
-    if (move->cPiece != -1) { cPieceBb = &board->pieceLocations[move->cPiece]; }
-    if (move->pPiece != -1) { cPieceBb = &board->pieceLocations[move->cPiece]; }
-
-    *pieceBb ^= oldSqBb;
-    *friendlyBb ^= oldSqBb;
-    *allBb ^= oldSqBb;
-    *hash ^= oldZobristPiece;
-    if (move->pPiece != -1) { 
-        *pPieceBb ^= newSqBb;
-        *friendlyBb ^= oldSqBb;
-        *allBb ^= newSqBb;
-        *hash ^= pZobristPiece; }
-    else { 
-        *pieceBb ^= newSqBb; 
-        *friendlyBb ^= newSqBb;
-        *allBb ^= newSqBb;
-        *hash ^= newZobristPiece;
-    }
-    if (move->cPiece != -1) { 
-        *cPieceBb ^= newSqBb; 
-        *enemyBb ^= newSqBb;
-        *hash ^= cZobristPiece; };
-
-    // castles 
-    if (
-        move->piece == 2 || move->piece == 9
-    ) 
-    {
-        if (abs(oldSq - newSq) == 2) {
-            int intSq = (move->oldSquare + move->newSquare) >> 1;
-            MoveData* intMove = new MoveData(oldSq, intSq);
-            doMove(intMove);
-            bool intMoveValid = checksAreValid();
-            undoMove(intMove);
-            if (intMoveValid) {
-                uint rook = turn ? 6 : 13;
-                u64* rookBoard = &board->pieceLocations[rook];
-                int rookSq = intSq > newSq ? oldSq - 4 : oldSq + 3;
-                u64 oldZobristRook = board->zobristPseudoRandoms[rook - (2 + (move->pPiece > 7)) + (rookSq * 12)];
-                u64 newZobristRook = board->zobristPseudoRandoms[rook - (2 + (move->pPiece > 7)) + (intSq * 12)];
-    
-                *rookBoard ^= rookSq;
-                *rookBoard ^= intSq;
-                *hash ^= oldZobristRook;
-                *hash ^= newZobristRook;
-            }
-        }
-        board->castlingRights &= (turn ? 0b0011 : 0b1100);
-        *hash ^= board->zobristPseudoRandoms[turn ? 777 : 779];
-        *hash ^= board->zobristPseudoRandoms[turn ? 778 : 780];
+    int placedPiece = move->pPiece > 0 ? move->pPiece : move->piece;
+    bool isPawn = move->piece == 3 || move->piece == 10;
+    bool isKing = move->piece == 2 || move->piece == 9;
+
+    // En passant captures land on an empty square, with the captured pawn one rank behind it.
+    move->enPassant = isPawn && (oldSq % 8) != (newSq % 8) && !(*enemyBb & newSqBb);
+    bool isCapture = move->cPiece > 0;
+    int captureSq = move->enPassant ? (turn ? newSq - 8 : newSq + 8) : newSq;
+    bool isCastle = isKing && abs(oldSq - newSq) == 2;
+    int rookOldSq = newSq > oldSq ? oldSq + 3 : oldSq - 4;
+    int rookNewSq = (oldSq + newSq) >> 1;
+    uint rook = turn ? 6 : 13;
+
+    uint castlingRights = board->castlingRights & castlingRightsKept(oldSq) & castlingRightsKept(newSq);
+    uint enPassantFiles = (isPawn && abs(oldSq - newSq) == 16) ? 1 << (oldSq % 8) : 0;
+
+    // Compute the child's key before touching the board, so its TT entry is fetched while the move is made.
+    u64 childHash = board->zobristHash ^ board->zobristPseudoRandoms[768];
+    childHash ^= board->zobristPiece(move->piece, oldSq) ^ board->zobristPiece(placedPiece, newSq);
+    if (isCapture) { childHash ^= board->zobristPiece(move->cPiece, captureSq); };
+    if (isCastle) { childHash ^= board->zobristPiece(rook, rookOldSq) ^ board->zobristPiece(rook, rookNewSq); };
+    uint castlingDifference = castlingRights ^ board->castlingRights;
+    while (castlingDifference > 0) {
+        int right = BitOps::countTrailingZeroes(castlingDifference);
+        childHash ^= board->zobristPseudoRandoms[777 + right];
+        castlingDifference ^= 1 << right;
     }
-
-    // Remove castling right for moved rook.
-    if (move->piece == 6 || move->piece == 13) {
-        int relevantCastle = 1 << ((!turn * 2) + ((oldSq % 8) == 0));
-        board->castlingRights &= ~(relevantCastle);
+    uint enPassantDifference = enPassantFiles ^ board->enPassantFiles;
+    while (enPassantDifference > 0) {
+        int file = BitOps::countTrailingZeroes(enPassantDifference);
+        childHash ^= board->zobristPseudoRandoms[769 + file];
+        enPassantDifference ^= 1 << file;
     }
+    prefetchTransposition(childHash);
 
-    // allow en passant
-    board->enPassantFiles = 0;
-    if ((move->piece == 3 || move->piece == 10)
-        && abs(oldSq - newSq) == 16) {
-            board->enPassantFiles = 1ULL << (oldSq % 8);
-            *hash ^= board->zobristPseudoRandoms[769 + (oldSq % 8)];
-        }
-
+    hashHistory.push_back(board->zobristHash);
     enPassantHistory.push_back(board->enPassantFiles);
     castlingRightsHistory.push_back(board->castlingRights);
-    
+    halfMoveClockHistory.push_back(board->halfMoveClock);
+    // Pawn moves and captures can never be undone, so no earlier position can come back.
+    board->halfMoveClock = (isPawn || isCapture) ? 0 : board->halfMoveClock + 1;
+    board->turnsTaken++;
+    pliesFromNull++;
+
+    board->pieceLocations[move->piece] ^= oldSqBb;
+    board->pieceLocations[placedPiece] ^= newSqBb;
+    *friendlyBb ^= oldSqBb | newSqBb;
+    *allBb ^= oldSqBb | newSqBb;
+    if (isCapture) {
+        u64 captureSqBb = 1ULL << captureSq;
+        board->pieceLocations[move->cPiece] ^= captureSqBb;
+        *enemyBb ^= captureSqBb;
+        *allBb ^= captureSqBb;
+    };
+    if (isCastle) {
+        u64 rookBb = (1ULL << rookOldSq) | (1ULL << rookNewSq);
+        board->pieceLocations[rook] ^= rookBb;
+        *friendlyBb ^= rookBb;
+        *allBb ^= rookBb;
+    };
+
+    board->castlingRights = castlingRights;
+    board->enPassantFiles = enPassantFiles;
+    board->zobristHash = childHash;
     board->currentTurn = !turn;
-    *hash ^= board->zobristPseudoRandoms[768];
 }
 
 void Eval::undoMove(MoveData* move) {
+    STATS_SCOPE(stats, TIMER_MAKE_UNMAKE);
+    board->currentTurn = !board->currentTurn;
     bool turn = board->currentTurn;
-    board->currentTurn = !turn;
-    u64* hash = &board->zobristHash;
-    *hash ^= board->zobristPseudoRandoms[768];
-
     u64* allBb = &board->pieceLocations[0];
     u64* friendlyBb = turn ? &board->pieceLocations[1] : &board->pieceLocations[8];
     u64* enemyBb = turn ? &board->pieceLocations[8] : &board->pieceLocations[1];
-    u64* pieceBb =  &board->pieceLocations[move->piece];
-    u64* cPieceBb = pieceBb;
-    u64* pPieceBb = pieceBb;
 
     int oldSq = move->oldSquare;
     int newSq = move->newSquare;
     u64 oldSqBb = 1ULL << oldSq;
     u64 newSqBb = 1ULL << newSq;
+    int placedPiece = move->pPiece > 0 ? move->pPiece : move->piece;
+
+    board->pieceLocations[move->piece] ^= oldSqBb;
+    board->pieceLocations[placedPiece] ^= newSqBb;
+    *friendlyBb ^= oldSqBb | newSqBb;
+    *allBb ^= oldSqBb | newSqBb;
+    if (move->cPiece > 0) {
+        u64 captureSqBb = 1ULL << (move->enPassant ? (turn ? newSq - 8 : newSq + 8) : newSq);
+        board->pieceLocations[move->cPiece] ^= captureSqBb;
+        *enemyBb ^= captureSqBb;
+        *allBb ^= captureSqBb;
+    };
+    if ((move->piece == 2 || move->piece == 9) && abs(oldSq - newSq) == 2) {
+        int rookOldSq = newSq > oldSq ? oldSq + 3 : oldSq - 4;
+        int rookNewSq = (oldSq + newSq) >> 1;
+        u64 rookBb = (1ULL << rookOldSq) | (1ULL << rookNewSq);
+        board->pieceLocations[turn ? 6 : 13] ^= rookBb;
+        *friendlyBb ^= rookBb;
+        *allBb ^= rookBb;
+    };
+    board->halfMoveClock = halfMoveClockHistory.back();
+    halfMoveClockHistory.pop_back();
+    board->turnsTaken--;
+    pliesFromNull--;
+    revertBoardRights();
+}
 
-    u64 oldZobristPiece = board->zobristPseudoRandoms[move->piece - (2 + (move->piece > 7)) + (oldSq * 12)];
-    u64 newZobristPiece = board->zobristPseudoRandoms[move->piece - (2 + (move->piece > 7)) + (newSq * 12)];
-    u64 cZobristPiece = board->zobristPseudoRandoms[move->cPiece - (2 + (move->cPiece > 7)) + (newSq * 12)];
-    u64 pZobristPiece = board->zobristPseudoRandoms[move->pPiece - (2 + (move->pPiece > 7)) + (newSq * 12)];
-
-    if (move->cPiece != -1) { cPieceBb = &board->pieceLocations[move->cPiece]; }
-    if (move->pPiece != -1) { cPieceBb = &board->pieceLocations[move->cPiece]; }
-
-    *pieceBb ^= oldSqBb;
-    *friendlyBb ^= oldSqBb;
-    *allBb ^= oldSqBb;
-    *hash ^= oldZobristPiece;
-    if (move->pPiece != -1) { 
-        *pPieceBb ^= newSqBb;
-        *friendlyBb ^= oldSqBb;
-        *allBb ^= newSqBb;
-        *hash ^= pZobristPiece; }
-    else { 
-        *pieceBb ^= newSqBb; 
-        *friendlyBb ^= newSqBb;
-        *allBb ^= newSqBb;
-        *hash ^= newZobristPiece;
-    }
-    if (move->cPiece != -1) { 
-        *cPieceBb ^= newSqBb; 
-        *enemyBb ^= newSqBb;
-        *hash ^= cZobristPiece; };
-    
-    // castling 
-    if (
-        move->piece == 2 || move->piece == 9
-    ) 
-    {
-        if (abs(oldSq - newSq) == 2) {
-            int intSq = (move->oldSquare + move->newSquare) >> 1;
-            MoveData* intMove = new MoveData(oldSq, newSq);
-            
-            uint rook = turn ? 6 : 13;
-            u64* rookBoard = &board->pieceLocations[rook];
-            int rookSq = intSq > newSq ? oldSq - 4 : oldSq + 3;
-            u64 oldZobristRook = board->zobristPseudoRandoms[rook - (2 + (move->pPiece > 7)) + (rookSq * 12)];
-            u64 newZobristRook = board->zobristPseudoRandoms[rook - (2 + (move->pPiece > 7)) + (intSq * 12)];
-
-            *rookBoard ^= rookSq;
-            *rookBoard ^= intSq;
-            *hash ^= oldZobristRook;
-            *hash ^= newZobristRook;
-        }
+void Eval::doNullMove() {
+    u64 childHash = board->zobristHash ^ board->zobristPseudoRandoms[768];
+    uint enPassantFiles = board->enPassantFiles;
+    while (enPassantFiles > 0) {
+        int file = BitOps::countTrailingZeroes(enPassantFiles);
+        childHash ^= board->zobristPseudoRandoms[769 + file];
+        enPassantFiles ^= 1 << file;
     }
+    prefetchTransposition(childHash);
+
+    hashHistory.push_back(board->zobristHash);
+    enPassantHistory.push_back(board->enPassantFiles);
+    castlingRightsHistory.push_back(board->castlingRights);
+    // A repetition through a pass is not one, so the repetition window starts again after it.
+    pliesFromNullHistory.push_back(pliesFromNull);
+    pliesFromNull = 0;
+    board->enPassantFiles = 0;
+    board->zobristHash = childHash;
+    board->currentTurn = !board->currentTurn;
+}
+
+void Eval::undoNullMove() {
+    board->currentTurn = !board->currentTurn;
+    pliesFromNull = pliesFromNullHistory.back();
+    pliesFromNullHistory.pop_back();
     revertBoardRights();
 }
 
 void Eval::revertBoardRights() {
-    castlingRightsHistory.pop_back();
+    board->zobristHash = hashHistory.back();
+    board->enPassantFiles = enPassantHistory.back();
+    board->castlingRights = castlingRightsHistory.back();
+    hashHistory.pop_back();
     enPassantHistory.pop_back();
-    int lastCastlingRights = castlingRightsHistory.back();
-    int lastEnpassantFiles = enPassantHistory.back();
-
-    int castlingDifference = lastCastlingRights ^ board->castlingRights;
-    int enPassantDifference = lastEnpassantFiles ^ board->enPassantFiles;
+    castlingRightsHistory.pop_back();
+};
 
-    while (castlingDifference > 0) {
-        int right = BitOps::countTrailingZeroes(castlingDifference);
-        board->zobristHash ^= board->zobristPseudoRandoms[777 + right];
-        castlingDifference ^= 1ULL << right;
+uint Eval::castlingRightsKept(int square) {
+    // Moving from or capturing on a king or rook home square removes the matching rights.
+    switch (square) {
+        case 0: return 0b1101;
+        case 4: return 0b1100;
+        case 7: return 0b1110;
+        case 56: return 0b0111;
+        case 60: return 0b0011;
+        case 63: return 0b1011;
+        default: return 0b1111;
     }
-    while (enPassantDifference > 0) {
-        int file = BitOps::countTrailingZeroes(enPassantDifference);
-        board->zobristHash ^= board->zobristPseudoRandoms[769 + file];
-        enPassantDifference ^= 1ULL << file;
-    }
-    board->castlingRights = lastCastlingRights;
-    board->enPassantFiles = lastEnpassantFiles;
 };
 
 void Eval::calculateMoveOrderScore(MoveData* moveData) {
-    const int PIECEVALUES[7] = {0, 0, 100, 300, 300, 500, 900};
-    float score = 0;
+    int score = 0;
     // 1 refutation from TT (handled elsewhere)
-    // 2 killer moves
-    if (moveData == this->killers[currentDepth].first) { moveData->score = INFINITY - 1; }
-    else if (moveData == killers[currentDepth].second) { moveData->score = INFINITY - 2; };
-    // 3 captures in order of risk/reward
-    uint capture = moveData->cPiece;
-    if (capture) {
-        if (capture >= 6) {
-            score += capture;
-        }
-        else {            
-            score += PIECEVALUES[capture+1] * 2;
-        }
+    // 2 captures in order of most valuable victim, least valuable attacker
+    if (moveData->cPiece > 0) {
+        int victim = PIECEVALUES[(moveData->cPiece - 1) % 7];
+        int attacker = PIECEVALUES[(moveData->piece - 1) % 7];
+        moveData->score = CAPTURE_ORDER_SCORE + (victim * 10) - attacker;
+        return;
     };
+    // 3 killer moves, then the counter to the opponent's last move
+    u16 code = moveData->encode();
+    KillerMoves* killer = &killers[currentDepth];
+    if (code == killer->first) { moveData->score = KILLER_ORDER_SCORE; return; };
+    if (code == killer->second) { moveData->score = KILLER_ORDER_SCORE - 1; return; };
+    if (currentDepth > 0 && moveStack[currentDepth - 1] != NULL_MOVE) {
+        u16 previous = moveStack[currentDepth - 1];
+        if (code == counterMoves[previous & 63][(previous >> 6) & 63]) { moveData->score = COUNTER_ORDER_SCORE; return; };
+    };
+    // 4 remaining quiet moves by history
+    score += historyTable[board->currentTurn][moveData->oldSquare][moveData->newSquare];
     moveData->score = score;
 };
 
+void Eval::updateQuietHeuristics(MoveData* move, uint depth) {
+    // Only quiet moves that cause a cutoff feed the killer, counter and history tables.
+    if (!move->isQuiet()) { return; };
+    u16 code = move->encode();
+    killers[currentDepth].addNewKiller(code);
+    if (currentDepth > 0 && moveStack[currentDepth - 1] != NULL_MOVE) {
+        u16 previous = moveStack[currentDepth - 1];
+        counterMoves[previous & 63][(previous >> 6) & 63] = code;
+    };
+    int* history = &historyTable[board->currentTurn][move->oldSquare][move->newSquare];
+    *history += depth * depth;
+    if (*history > HISTORY_MAX) {
+        // Age the whole table so that recent cutoffs outweigh old ones.
+        for (int colour = 0; colour < 2; colour++) {
+            for (int from = 0; from < 64; from++) {
+                for (int to = 0; to < 64; to++) { historyTable[colour][from][to] >>= 1; }
+            }
+        }
+    };
+};
+
+void Eval::clearSearchHeuristics() {
+    std::fill(std::begin(killers), std::end(killers), KillerMoves{});
+    std::memset(historyTable, 0, sizeof(historyTable));
+    std::memset(counterMoves, 0, sizeof(counterMoves));
+    std::memset(moveStack, 0, sizeof(moveStack));
+    currentDepth = 0;
+};
+
 std::vector<MoveData*> Eval::addPawnMove(MoveData* move) {
     std::vector<MoveData*> moves;
     bool turn = board->currentTurn;
-    int start = -1;
-    int stop = 0;
-    if ((move->newSquare > 55 && turn) || (move->newSquare < 8 && !turn)) {
-        start = turn ? 4 : 11; stop = turn ? 8 : 15;
+    if (!((move->newSquare > 55 && turn) || (move->newSquare < 8 && !turn))) {
+        moves.push_back(move);
+        return moves;
     }
-    for (int i = start; i < stop; i++) {
-        MoveData moveCopy = *move;
-        moveCopy.pPiece = i;
-        moves.push_back(&moveCopy);
+    // Promotions replace the pawn move, queen first.
+    int start = turn ? 7 : 14;
+    int stop = turn ? 4 : 11;
+    for (int i = start; i >= stop; i--) {
+        MoveData* promotion = new MoveData(*move);
+        promotion->pPiece = i;
+        moves.push_back(promotion);
     }
+    delete move;
     return moves;
 }
 
 bool Eval::checksAreValid() {
-    // TODO: add clause for castling
+    // The side that just moved may not leave its own king attacked.
     u64 thisKing = board->pieceLocations[board->currentTurn ? 9 : 2];
     uint kingSquare = BitOps::countTrailingZeroes(thisKing);
-    u64 bishopMagicNumber = this->bishopMagics[kingSquare];
-    u64 rookMagicNumber = this->rookMagics[kingSquare];
-    u64 enemyKing = board->pieceLocations[board->currentTurn ? 2 : 9];
-    u64 enemyPawns = board->pieceLocations[board->currentTurn ? 3 : 10];
-    u64 enemyBishops = board->pieceLocations[board->currentTurn ? 4 : 11];
-    u64 enemyKnights = board->pieceLocations[board->currentTurn ? 5 : 12];
-    u64 enemyRooks = board->pieceLocations[board->currentTurn ? 6 : 13];
-    u64 enemyQueens = board->pieceLocations[board->currentTurn ? 7 : 14];
-
-    u64 dangerousKingLocations = kingMovesTable[kingSquare];
-    u64 dangerousBishopsLocations = bishopAttacks[kingSquare][calculateMagicHash(kingSquare, BISHOP, board->pieceLocations[0])];
-    u64 dangerousKnightsLocations = knightMovesTable[kingSquare];
-    u64 dangerousRooksLocations = rookAttacks[kingSquare][calculateMagicHash(kingSquare, ROOK, board->pieceLocations[0])];
-    u64 dangerousPawnsLocations = board->currentTurn ? ((thisKing & edgeMasks[3]) << 9 | (thisKing & edgeMasks[2]) << 7) : ((thisKing & edgeMasks[2]) >> 9 | (thisKing & edgeMasks[3]) >> 7);
-    if (dangerousKingLocations & enemyKing) { return false; };
-    if (dangerousBishopsLocations & (enemyBishops | enemyQueens)) { return false; };
-    if (dangerousKnightsLocations & enemyKnights) { return false; };
-    if (dangerousRooksLocations & (enemyRooks | enemyQueens)) { return false; };
-    if (dangerousPawnsLocations & enemyPawns) { return false; };
-    return true;
-}
+    return !findAttackersOfSquare(kingSquare, board->currentTurn, board->pieceLocations[0]);
+}
\ No newline at end of file
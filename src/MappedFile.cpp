@@ -0,0 +1,68 @@
+#include "../inc/MappedFile.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+bool MappedFile::open(const std::string& path) {
+    close();
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) { return false; };
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    };
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        if (mapping) { CloseHandle(mapping); };
+        CloseHandle(file);
+        return false;
+    };
+    fileHandle = file;
+    mappingHandle = mapping;
+    data = view;
+    length = (size_t)fileSize.QuadPart;
+    return true;
+}
+
+void MappedFile::close() {
+    if (data) { UnmapViewOfFile(data); };
+    if (mappingHandle) { CloseHandle((HANDLE)mappingHandle); };
+    if (fileHandle) { CloseHandle((HANDLE)fileHandle); };
+    data = nullptr;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+    length = 0;
+}
+#else
+bool MappedFile::open(const std::string& path) {
+    close();
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) { return false; };
+    struct stat status;
+    if (fstat(file, &status) != 0 || status.st_size == 0) {
+        ::close(file);
+        return false;
+    };
+    void* view = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_SHARED, file, 0);
+    // The mapping keeps its own reference to the file.
+    ::close(file);
+    if (view == MAP_FAILED) { return false; };
+    data = view;
+    length = (size_t)status.st_size;
+    return true;
+}
+
+void MappedFile::close() {
+    if (data) { munmap(data, length); };
+    data = nullptr;
+    length = 0;
+}
+#endif
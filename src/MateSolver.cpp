@@ -0,0 +1,217 @@
+#include "../inc/MateSolver.h"
+#include "../inc/Clock.h"
+#include <algorithm>
+
+MateSolver::MateSolver(Eval* setEngine, uint hashMegabytes) : engine(setEngine) {
+    resize(hashMegabytes);
+}
+
+void MateSolver::resize(uint megabytes) {
+    u64 buckets = 1;
+    while (buckets * 2 * 4 * sizeof(Entry) <= (u64)megabytes << 20) { buckets *= 2; }
+    table.assign(buckets * 4, Entry());
+    bucketMask = buckets - 1;
+}
+
+void MateSolver::clear() {
+    std::fill(table.begin(), table.end(), Entry());
+}
+
+bool MateSolver::lookup(u64 key, uint& phi, uint& delta, uint& distance) {
+    Entry* bucket = &table[(key & bucketMask) * 4];
+    for (uint i = 0; i < 4; i++) {
+        if (bucket[i].key != key) { continue; };
+        phi = bucket[i].phi;
+        delta = bucket[i].delta;
+        distance = bucket[i].distance;
+        return true;
+    }
+    // Unexplored positions start with one node of work either way.
+    phi = 1;
+    delta = 1;
+    distance = 0;
+    return false;
+}
+
+void MateSolver::store(u64 key, uint phi, uint delta, uint distance, u64 work) {
+    Entry* bucket = &table[(key & bucketMask) * 4];
+    Entry* replaced = bucket;
+    for (uint i = 0; i < 4; i++) {
+        if (bucket[i].key == key) { replaced = &bucket[i]; break; };
+        if (bucket[i].work < replaced->work) { replaced = &bucket[i]; };
+    }
+    uint logWork = 0;
+    while (work >>= 1) { logWork++; }
+    if (replaced->key == key) { logWork = std::max(logWork, replaced->work); };
+    replaced->key = key;
+    replaced->phi = phi;
+    replaced->delta = delta;
+    replaced->distance = (u16)std::min<uint>(distance, 0xFFFF);
+    replaced->work = logWork;
+}
+
+bool MateSolver::limitReached() {
+    if (engine->stopRequested.load(std::memory_order_relaxed)) { return true; };
+    if (nodeLimit && nodes >= nodeLimit) { return true; };
+    return deadline && (nodes & 1023) == 0 && steadyClockNanoseconds() >= deadline;
+}
+
+std::vector<MoveData*> MateSolver::generateMoves(bool attacking) {
+    std::vector<MoveData*> moves = engine->findLegalMoves(engine->isInCheck() ? engine->findEvasionMoves() : engine->findPseudoLegalMoves());
+    if (!attacking) { return moves; };
+    // The attacker is limited to checks, which keeps the defender's replies to evasions.
+    for (MoveData*& move : moves) {
+        engine->doMove(move);
+        bool givesCheck = engine->isInCheck();
+        engine->undoMove(move);
+        if (givesCheck) { continue; };
+        delete move;
+        move = nullptr;
+    }
+    moves.erase(std::remove(moves.begin(), moves.end(), nullptr), moves.end());
+    return moves;
+}
+
+void MateSolver::search(uint ply, uint thresholdPhi, uint thresholdDelta) {
+    nodes++;
+    if (!aborted && limitReached()) { aborted = true; };
+    if (aborted) { return; };
+    u64 startNodes = nodes;
+    bool attacking = engine->board->currentTurn == attacker;
+    u64 key = engine->board->zobristHash;
+    std::vector<MoveData*> moves = generateMoves(attacking);
+    if (moves.empty()) {
+        // Either the attacker has run out of checks or the defender is mated: the side to move loses.
+        store(key, MATE_SOLVER_INFINITY, 0, 0, 1);
+        return;
+    };
+
+    // Children on the current line, or past the ply cap, are lost for the attack.
+    std::vector<u64> childKeys(moves.size());
+    std::vector<bool> blocked(moves.size());
+    for (size_t i = 0; i < moves.size(); i++) {
+        engine->doMove(moves[i]);
+        childKeys[i] = engine->board->zobristHash;
+        engine->undoMove(moves[i]);
+        blocked[i] = childKeys[i] == key || std::find(path.begin(), path.end(), childKeys[i]) != path.end();
+        if (ply + 1 >= MATE_SOLVER_MAX_PLY) {
+            blocked[i] = true;
+            truncated = true;
+        };
+    }
+    path.push_back(key);
+
+    uint phi, delta, distance;
+    while (true) {
+        // phi is the smallest child delta, delta the sum of the child phis.
+        phi = MATE_SOLVER_INFINITY;
+        u64 deltaSum = 0;
+        uint secondDelta = MATE_SOLVER_INFINITY;
+        uint bestPhi = 0;
+        size_t best = 0;
+        uint winDistance = 0xFFFF, lossDistance = 0;
+        for (size_t i = 0; i < moves.size(); i++) {
+            uint childPhi, childDelta, childDistance;
+            if (blocked[i]) {
+                childPhi = attacking ? 0 : MATE_SOLVER_INFINITY;
+                childDelta = attacking ? MATE_SOLVER_INFINITY : 0;
+                childDistance = 0;
+            }
+            else {
+                lookup(childKeys[i], childPhi, childDelta, childDistance);
+            };
+            if (childDelta < phi) {
+                secondDelta = phi;
+                phi = childDelta;
+                bestPhi = childPhi;
+                best = i;
+            }
+            else if (childDelta < secondDelta) {
+                secondDelta = childDelta;
+            };
+            deltaSum += childPhi;
+            if (childDelta == 0) { winDistance = std::min(winDistance, childDistance + 1); };
+            lossDistance = std::max(lossDistance, childDistance + 1);
+        }
+        delta = (uint)std::min<u64>(deltaSum, MATE_SOLVER_INFINITY);
+        distance = phi == 0 ? winDistance : (delta == 0 ? lossDistance : 0);
+        if (phi >= thresholdPhi || delta >= thresholdDelta || aborted) { break; };
+
+        // Expand the most proving child, with thresholds that return as soon as another child
+        // becomes the better choice.
+        uint childThresholdPhi = thresholdDelta >= MATE_SOLVER_INFINITY ? MATE_SOLVER_INFINITY
+            : (uint)std::min<u64>((u64)thresholdDelta + bestPhi - delta, MATE_SOLVER_INFINITY);
+        uint childThresholdDelta = std::min(thresholdPhi, secondDelta >= MATE_SOLVER_INFINITY ? MATE_SOLVER_INFINITY : secondDelta + 1);
+        engine->doMove(moves[best]);
+        search(ply + 1, childThresholdPhi, childThresholdDelta);
+        engine->undoMove(moves[best]);
+    }
+    path.pop_back();
+    store(key, phi, delta, distance, nodes - startNodes + 1);
+    Eval::releaseMoves(moves);
+}
+
+std::vector<u16> MateSolver::findProofLine(uint maxLength) {
+    // The attacker follows the shortest proven reply, the defender the longest resistance.
+    std::vector<u16> line;
+    std::vector<MoveData*> played;
+    while (line.size() < maxLength) {
+        bool attacking = engine->board->currentTurn == attacker;
+        std::vector<MoveData*> moves = generateMoves(attacking);
+        MoveData* chosen = nullptr;
+        uint chosenDistance = 0;
+        for (MoveData* move : moves) {
+            engine->doMove(move);
+            uint phi, delta, distance;
+            bool found = lookup(engine->board->zobristHash, phi, delta, distance);
+            engine->undoMove(move);
+            if (!found || (attacking && delta != 0) || (!attacking && phi != 0)) { continue; };
+            if (!chosen || (attacking ? distance < chosenDistance : distance > chosenDistance)) {
+                chosen = move;
+                chosenDistance = distance;
+            };
+        }
+        if (!chosen) {
+            Eval::releaseMoves(moves);
+            break;
+        };
+        line.push_back(chosen->encode());
+        moves.erase(std::find(moves.begin(), moves.end(), chosen));
+        Eval::releaseMoves(moves);
+        engine->doMove(chosen);
+        played.push_back(chosen);
+    }
+    while (!played.empty()) {
+        engine->undoMove(played.back());
+        delete played.back();
+        played.pop_back();
+    }
+    return line;
+}
+
+MateResult MateSolver::solve(u64 limit, u64 moveTime) {
+    MateResult result;
+    u64 startTime = steadyClockNanoseconds();
+    attacker = engine->board->currentTurn;
+    aborted = false;
+    truncated = false;
+    nodes = 0;
+    nodeLimit = limit;
+    deadline = moveTime ? startTime + moveTime * 1000000 : 0;
+    path.clear();
+    search(0, MATE_SOLVER_INFINITY, MATE_SOLVER_INFINITY);
+
+    uint phi, delta, distance;
+    lookup(engine->board->zobristHash, phi, delta, distance);
+    result.proven = phi == 0;
+    // Repeating a position never helps the attacker, but a line cut off by the ply cap might have.
+    result.disproven = !aborted && !truncated && delta == 0;
+    if (result.proven) {
+        result.plies = distance;
+        result.pv = findProofLine(distance);
+        if (!result.pv.empty()) { result.move = result.pv[0]; };
+    };
+    result.nodes = nodes;
+    result.time = (steadyClockNanoseconds() - startTime) / 1000000;
+    return result;
+}
@@ -0,0 +1,147 @@
+#include "../inc/Perft.h"
+
+void PerftTable::resize(uint megabytes) {
+    u64 count = 1;
+    while (count * 2 * sizeof(Entry) <= (u64)megabytes << 20) { count *= 2; }
+    entries.reset(new Entry[count]);
+    mask = count - 1;
+}
+
+void PerftTable::clear() {
+    for (u64 i = 0; entries && i <= mask; i++) {
+        entries[i].check.store(0, std::memory_order_relaxed);
+        entries[i].count.store(0, std::memory_order_relaxed);
+    }
+}
+
+u64 PerftTable::key(u64 hash, uint depth) {
+    // Mixing the depth in keeps counts of the same position at different depths apart.
+    return hash ^ ((depth + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+bool PerftTable::probe(u64 hash, uint depth, u64& count) {
+    if (!entries) { return false; };
+    u64 entryKey = key(hash, depth);
+    Entry& entry = entries[entryKey & mask];
+    u64 stored = entry.count.load(std::memory_order_relaxed);
+    if ((entry.check.load(std::memory_order_relaxed) ^ stored) != entryKey) { return false; };
+    count = stored;
+    return true;
+}
+
+void PerftTable::store(u64 hash, uint depth, u64 count) {
+    if (!entries) { return; };
+    u64 entryKey = key(hash, depth);
+    Entry& entry = entries[entryKey & mask];
+    entry.count.store(count, std::memory_order_relaxed);
+    entry.check.store(entryKey ^ count, std::memory_order_relaxed);
+}
+
+Perft::Perft(uint threads, uint hashMegabytes) : pool(threads) {
+    if (hashMegabytes) { table.resize(hashMegabytes); };
+    for (uint i = 0; i < pool.size(); i++) {
+        boards.push_back(new Board());
+        engines.push_back(new Eval(boards.back()));
+    }
+    rootEngine = new Eval(&rootBoard);
+}
+
+Perft::~Perft() {
+    pool.wait();
+    for (uint i = 0; i < engines.size(); i++) {
+        delete engines[i];
+        delete boards[i];
+    }
+    delete rootEngine;
+}
+
+u64 Perft::count(Eval* engine, uint depth, PerftTable* table) {
+    if (depth == 0) { return 1; };
+    u64 hash = engine->board->zobristHash;
+    u64 nodes = 0;
+    if (table && depth > 1 && table->probe(hash, depth, nodes)) { return nodes; };
+    std::vector<MoveData*> moves = engine->findLegalMoves(engine->isInCheck() ? engine->findEvasionMoves() : engine->findPseudoLegalMoves());
+    if (depth == 1) {
+        nodes = moves.size();
+    }
+    else {
+        for (MoveData* move : moves) {
+            engine->doMove(move);
+            nodes += count(engine, depth - 1, table);
+            engine->undoMove(move);
+        }
+    };
+    Eval::releaseMoves(moves);
+    if (table && depth > 1) { table->store(hash, depth, nodes); };
+    return nodes;
+}
+
+void Perft::split(uint worker, const PackedPosition& position, uint depth, std::atomic<u64>* total) {
+    Eval* engine = engines[worker];
+    engine->board->unpack(position);
+    engine->resetGameHistory();
+    if (depth < PERFT_SPLIT_DEPTH) {
+        *total += count(engine, depth, &table);
+        return;
+    };
+    std::vector<MoveData*> moves = engine->findLegalMoves(engine->isInCheck() ? engine->findEvasionMoves() : engine->findPseudoLegalMoves());
+    try {
+        for (MoveData* move : moves) {
+            engine->doMove(move);
+            PackedPosition child = engine->board->pack();
+            engine->undoMove(move);
+            pool.submit([this, child, depth, total](uint index) { splitTask(index, child, depth - 1, total); });
+        }
+    }
+    catch (...) {
+        Eval::releaseMoves(moves);
+        throw;
+    }
+    Eval::releaseMoves(moves);
+}
+
+void Perft::splitTask(uint worker, const PackedPosition& position, uint depth, std::atomic<u64>* total) {
+    // An exception escaping a pool worker would terminate the process, so it is kept for run.
+    if (failed.load(std::memory_order_relaxed)) { return; };
+    try {
+        split(worker, position, depth, total);
+    }
+    catch (...) {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        if (!error) { error = std::current_exception(); };
+        failed = true;
+    }
+}
+
+u64 Perft::run(const std::string& fen, uint depth, std::vector<std::pair<u16, u64>>* divide) {
+    rootBoard.loadFEN(fen);
+    rootEngine->resetGameHistory();
+    if (depth == 0) { return 1; };
+    // Positions reach the workers packed, so make sure the root survives the round trip here.
+    Board unpacked;
+    unpacked.unpack(rootBoard.pack());
+    error = nullptr;
+    failed = false;
+    std::vector<MoveData*> moves = rootEngine->findLegalMoves(rootEngine->isInCheck() ? rootEngine->findEvasionMoves() : rootEngine->findPseudoLegalMoves());
+    std::unique_ptr<std::atomic<u64>[]> totals(new std::atomic<u64>[moves.size()]);
+    for (size_t i = 0; i < moves.size(); i++) {
+        totals[i] = 0;
+        rootEngine->doMove(moves[i]);
+        PackedPosition child = rootBoard.pack();
+        rootEngine->undoMove(moves[i]);
+        std::atomic<u64>* total = &totals[i];
+        pool.submit([this, child, depth, total](uint index) { splitTask(index, child, depth - 1, total); });
+    }
+    pool.wait();
+    if (error) {
+        Eval::releaseMoves(moves);
+        std::rethrow_exception(error);
+    };
+    u64 nodes = 0;
+    for (size_t i = 0; i < moves.size(); i++) {
+        nodes += totals[i];
+        if (divide) { divide->push_back({moves[i]->encode(), totals[i]}); };
+    }
+    Eval::releaseMoves(moves);
+    return nodes;
+}
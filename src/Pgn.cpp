@@ -0,0 +1,159 @@
+#include "../inc/Pgn.h"
+#include <cstring>
+#include <stdexcept>
+
+static bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool PgnReader::open(const std::string& path) {
+    close();
+    if (!file.open(path)) { return false; };
+    // Skip a UTF-8 byte order mark.
+    if (file.size() >= 3 && std::memcmp(file.bytes(), "\xEF\xBB\xBF", 3) == 0) { position = 3; };
+    return true;
+}
+
+bool PgnReader::next(PgnGame& game) {
+    const char* data = (const char*)file.bytes();
+    size_t size = file.size();
+    while (position < size && isBlank(data[position])) { position++; }
+    if (position >= size) { return false; };
+    size_t start = position;
+    bool movetext = false;
+    while (position < size) {
+        const char* newline = (const char*)std::memchr(data + position, '\n', size - position);
+        size_t lineEnd = newline ? (size_t)(newline - data) + 1 : size;
+        if (data[position] == '[') {
+            if (movetext) { break; };
+        }
+        else if (data[position] != '%') {
+            for (size_t i = position; i < lineEnd && !movetext; i++) { movetext = !isBlank(data[i]); }
+        };
+        position = lineEnd;
+    }
+    game.begin = data + start;
+    game.end = data + position;
+    game.offset = start;
+    return true;
+}
+
+bool Pgn::tagValue(const PgnGame& game, const std::string& name, std::string& value) {
+    // Tags are [Name "value"], one per line, ahead of the movetext; quotes and backslashes in
+    // values are escaped with a backslash.
+    const char* line = game.begin;
+    while (line < game.end && *line == '[') {
+        const char* lineEnd = (const char*)std::memchr(line, '\n', game.end - line);
+        if (!lineEnd) { lineEnd = game.end; };
+        const char* p = line + 1;
+        while (p < lineEnd && isBlank(*p)) { p++; }
+        const char* nameEnd = p;
+        while (nameEnd < lineEnd && !isBlank(*nameEnd) && *nameEnd != '"') { nameEnd++; }
+        if ((size_t)(nameEnd - p) == name.size() && std::memcmp(p, name.data(), name.size()) == 0) {
+            const char* quote = (const char*)std::memchr(nameEnd, '"', lineEnd - nameEnd);
+            if (!quote) { return false; };
+            value.clear();
+            for (p = quote + 1; p < lineEnd && *p != '"'; p++) {
+                if (*p == '\\' && p + 1 < lineEnd) { p++; };
+                value += *p;
+            }
+            return true;
+        };
+        line = lineEnd + 1;
+    }
+    return false;
+}
+
+uint Pgn::parseResult(const std::string& text) {
+    if (text == "1-0") { return RESULT_WHITE_WIN; };
+    if (text == "0-1") { return RESULT_BLACK_WIN; };
+    if (text == "1/2-1/2") { return RESULT_DRAW; };
+    return RESULT_UNKNOWN;
+}
+
+bool Pgn::replay(Eval* engine, const PgnGame& game, uint maxPlies, std::vector<u64>& keys, uint& result, std::string& error) {
+    keys.clear();
+    std::string value;
+    if (tagValue(game, "Variant", value) && value != "Standard" && value != "standard") {
+        error = "unsupported variant " + value;
+        return false;
+    };
+    try {
+        engine->board->loadFEN(tagValue(game, "FEN", value) ? value : STARTING_FEN);
+    }
+    catch (const std::invalid_argument& loadError) {
+        error = loadError.what();
+        return false;
+    }
+    engine->resetGameHistory();
+    result = tagValue(game, "Result", value) ? parseResult(value) : RESULT_UNKNOWN;
+    keys.push_back(engine->board->positionKey());
+
+    uint plies = 0;
+    const char* p = game.begin;
+    const char* end = game.end;
+    while (p < end) {
+        char c = *p;
+        bool lineStart = p == game.begin || p[-1] == '\n';
+        if (isBlank(c)) {
+            p++;
+        }
+        else if ((c == '[' || c == '%') && lineStart) {
+            // Tag lines, and escaped lines that PGN says to ignore.
+            const char* newline = (const char*)std::memchr(p, '\n', end - p);
+            p = newline ? newline + 1 : end;
+        }
+        else if (c == '{') {
+            const char* close = (const char*)std::memchr(p, '}', end - p);
+            p = close ? close + 1 : end;
+        }
+        else if (c == ';') {
+            const char* newline = (const char*)std::memchr(p, '\n', end - p);
+            p = newline ? newline + 1 : end;
+        }
+        else if (c == '(') {
+            // Variations are skipped whole, including any comments and nested variations in them.
+            int depth = 0;
+            for (; p < end; p++) {
+                if (*p == '{') {
+                    const char* close = (const char*)std::memchr(p, '}', end - p);
+                    p = close ? close : end - 1;
+                }
+                else if (*p == '(') { depth++; }
+                else if (*p == ')' && --depth == 0) { p++; break; };
+            }
+        }
+        else if (c == '$' || c == ')' || c == '}') {
+            p++;
+            while (p < end && *p >= '0' && *p <= '9') { p++; }
+        }
+        else {
+            const char* tokenEnd = p;
+            while (tokenEnd < end && !isBlank(*tokenEnd) && !std::strchr("{}();", *tokenEnd)) { tokenEnd++; }
+            std::string token(p, tokenEnd);
+            p = tokenEnd;
+            if (token == "*" || parseResult(token) != RESULT_UNKNOWN) {
+                if (result == RESULT_UNKNOWN) { result = parseResult(token); };
+                break;
+            };
+            // Move numbers, "12." or "12...", may be written against the move that follows.
+            if (token[0] >= '0' && token[0] <= '9' && token.compare(0, 3, "0-0") != 0) {
+                size_t digits = token.find_first_not_of("0123456789");
+                size_t move = digits == std::string::npos ? std::string::npos : token.find_first_not_of('.', digits);
+                if (move == std::string::npos) { continue; };
+                token.erase(0, move);
+            };
+            if (maxPlies && plies >= maxPlies) { break; };
+            MoveData* move = engine->findSanMove(token);
+            if (!move) {
+                error = "illegal or unreadable move " + token + " at ply " + std::to_string(plies + 1);
+                return false;
+            };
+            engine->doMove(move);
+            delete move;
+            plies++;
+            keys.push_back(engine->board->positionKey());
+        };
+    }
+    return true;
+}
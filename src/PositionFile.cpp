@@ -0,0 +1,62 @@
+#include "../inc/PositionFile.h"
+#include <algorithm>
+#include <cstring>
+
+bool PositionWriter::open(const std::string& path) {
+    close();
+    output.open(path, std::ios::binary | std::ios::trunc);
+    if (!output) { return false; };
+    unsigned char header[POSITION_FILE_HEADER_SIZE] = {};
+    std::memcpy(header, POSITION_FILE_MAGIC, 8);
+    uint recordSize = sizeof(PackedPosition);
+    for (int i = 0; i < 4; i++) { header[8 + i] = (unsigned char)(recordSize >> (8 * i)); }
+    output.write((const char*)header, sizeof(header));
+    buffer.reserve(POSITION_WRITER_BUFFER);
+    recordCount = 0;
+    return (bool)output;
+}
+
+bool PositionWriter::write(const PackedPosition* records, size_t count) {
+    if (!output.is_open()) { return false; };
+    while (count > 0) {
+        size_t taken = std::min(count, POSITION_WRITER_BUFFER - buffer.size());
+        buffer.insert(buffer.end(), records, records + taken);
+        records += taken;
+        count -= taken;
+        recordCount += taken;
+        if (buffer.size() == POSITION_WRITER_BUFFER && !flush()) { return false; };
+    }
+    return true;
+}
+
+bool PositionWriter::flush() {
+    if (!output.is_open()) { return false; };
+    if (!buffer.empty()) {
+        output.write((const char*)buffer.data(), buffer.size() * sizeof(PackedPosition));
+        buffer.clear();
+    };
+    return (bool)output;
+}
+
+bool PositionWriter::close() {
+    if (!output.is_open()) { return true; };
+    bool ok = flush();
+    output.close();
+    return ok && !output.fail();
+}
+
+bool PositionReader::open(const std::string& path) {
+    close();
+    if (!file.open(path)) { return false; };
+    const unsigned char* header = file.bytes();
+    uint recordSize = 0;
+    if (file.size() >= POSITION_FILE_HEADER_SIZE) {
+        for (int i = 0; i < 4; i++) { recordSize |= (uint)header[8 + i] << (8 * i); }
+    };
+    if (file.size() < POSITION_FILE_HEADER_SIZE || std::memcmp(header, POSITION_FILE_MAGIC, 8) != 0 || recordSize != sizeof(PackedPosition)) {
+        file.close();
+        return false;
+    };
+    count = (file.size() - POSITION_FILE_HEADER_SIZE) / sizeof(PackedPosition);
+    return true;
+}
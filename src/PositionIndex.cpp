@@ -0,0 +1,146 @@
+#include "../inc/PositionIndex.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+
+PositionIndexBuilder::PositionIndexBuilder(const std::string& setPath, uint workers, size_t memoryBytes) : path(setPath) {
+    if (workers == 0) { workers = 1; };
+    bufferCapacity = std::max<size_t>(1 << 16, memoryBytes / sizeof(PositionStats) / workers);
+    buffers.resize(workers);
+}
+
+PositionIndexBuilder::~PositionIndexBuilder() {
+    for (const std::string& run : runs) { std::remove(run.c_str()); }
+}
+
+void PositionIndexBuilder::combine(std::vector<PositionStats>& buffer) {
+    std::sort(buffer.begin(), buffer.end(), [](const PositionStats& a, const PositionStats& b) { return a.key < b.key; });
+    size_t kept = 0;
+    for (size_t i = 0; i < buffer.size(); i++) {
+        if (kept > 0 && buffer[kept - 1].key == buffer[i].key) {
+            buffer[kept - 1].whiteWins += buffer[i].whiteWins;
+            buffer[kept - 1].draws += buffer[i].draws;
+            buffer[kept - 1].blackWins += buffer[i].blackWins;
+        }
+        else {
+            buffer[kept++] = buffer[i];
+        };
+    }
+    buffer.resize(kept);
+}
+
+bool PositionIndexBuilder::addGame(uint worker, std::vector<u64>& keys, uint result) {
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    std::vector<PositionStats>& buffer = buffers[worker];
+    for (u64 key : keys) {
+        buffer.push_back(PositionStats{key, result == RESULT_WHITE_WIN, result == RESULT_DRAW, result == RESULT_BLACK_WIN, 0});
+    }
+    if (buffer.size() < bufferCapacity) { return true; };
+    // Openings repeat so often that merging alone usually frees most of the buffer.
+    combine(buffer);
+    return buffer.size() <= bufferCapacity / 2 || spill(buffer);
+}
+
+bool PositionIndexBuilder::spill(std::vector<PositionStats>& buffer) {
+    std::string runPath;
+    {
+        std::lock_guard<std::mutex> lock(runsMutex);
+        runPath = path + ".run" + std::to_string(runs.size());
+        runs.push_back(runPath);
+    }
+    std::ofstream output(runPath, std::ios::binary | std::ios::trunc);
+    output.write((const char*)buffer.data(), buffer.size() * sizeof(PositionStats));
+    buffer.clear();
+    return (bool)output;
+}
+
+bool PositionIndexBuilder::finish() {
+    // Every run and every buffer is sorted, so a k-way merge over them writes the index in order.
+    struct Source {
+        const PositionStats* next;
+        const PositionStats* end;
+    };
+    std::vector<Source> sources;
+    std::vector<std::unique_ptr<MappedFile>> files;
+    for (const std::string& run : runs) {
+        files.emplace_back(new MappedFile());
+        if (!files.back()->open(run)) { return false; };
+        const PositionStats* records = (const PositionStats*)files.back()->bytes();
+        sources.push_back(Source{records, records + files.back()->size() / sizeof(PositionStats)});
+    }
+    for (std::vector<PositionStats>& buffer : buffers) {
+        combine(buffer);
+        if (!buffer.empty()) { sources.push_back(Source{buffer.data(), buffer.data() + buffer.size()}); };
+    }
+
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+    if (!output) { return false; };
+    unsigned char header[POSITION_INDEX_HEADER_SIZE] = {};
+    std::memcpy(header, POSITION_INDEX_MAGIC, 8);
+    uint recordSize = sizeof(PositionStats);
+    for (int i = 0; i < 4; i++) { header[8 + i] = (unsigned char)(recordSize >> (8 * i)); }
+    output.write((const char*)header, sizeof(header));
+
+    auto later = [](const Source& a, const Source& b) { return a.next->key > b.next->key; };
+    std::make_heap(sources.begin(), sources.end(), later);
+    std::vector<PositionStats> pending;
+    pending.reserve(1 << 16);
+    positionCount = 0;
+    while (!sources.empty()) {
+        std::pop_heap(sources.begin(), sources.end(), later);
+        Source& source = sources.back();
+        const PositionStats& record = *source.next++;
+        if (!pending.empty() && pending.back().key == record.key) {
+            pending.back().whiteWins += record.whiteWins;
+            pending.back().draws += record.draws;
+            pending.back().blackWins += record.blackWins;
+        }
+        else {
+            if (pending.size() == pending.capacity()) {
+                // Keep the last record back: the next run may still add to it.
+                output.write((const char*)pending.data(), (pending.size() - 1) * sizeof(PositionStats));
+                pending.erase(pending.begin(), pending.end() - 1);
+            };
+            pending.push_back(record);
+            positionCount++;
+        };
+        if (source.next == source.end) { sources.pop_back(); }
+        else { std::push_heap(sources.begin(), sources.end(), later); };
+    }
+    output.write((const char*)pending.data(), pending.size() * sizeof(PositionStats));
+    output.close();
+
+    files.clear();
+    for (const std::string& run : runs) { std::remove(run.c_str()); }
+    runs.clear();
+    for (std::vector<PositionStats>& buffer : buffers) { std::vector<PositionStats>().swap(buffer); }
+    return !output.fail();
+}
+
+bool PositionIndex::open(const std::string& path) {
+    close();
+    if (!file.open(path)) { return false; };
+    const unsigned char* header = file.bytes();
+    uint recordSize = 0;
+    if (file.size() >= POSITION_INDEX_HEADER_SIZE) {
+        for (int i = 0; i < 4; i++) { recordSize |= (uint)header[8 + i] << (8 * i); }
+    };
+    if (file.size() < POSITION_INDEX_HEADER_SIZE || std::memcmp(header, POSITION_INDEX_MAGIC, 8) != 0 || recordSize != sizeof(PositionStats)) {
+        file.close();
+        return false;
+    };
+    count = (file.size() - POSITION_INDEX_HEADER_SIZE) / sizeof(PositionStats);
+    return true;
+}
+
+bool PositionIndex::find(u64 key, PositionStats& stats) {
+    const PositionStats* first = records();
+    const PositionStats* last = first + count;
+    const PositionStats* found = std::lower_bound(first, last, key, [](const PositionStats& record, u64 value) { return record.key < value; });
+    if (found == last || found->key != key) { return false; };
+    stats = *found;
+    return true;
+}
@@ -0,0 +1,204 @@
+#include "../inc/SearchTask.h"
+#include "../inc/Clock.h"
+#include <algorithm>
+
+SearchResult Eval::search(SearchLimits limits) {
+    // Runs the whole search at once; the scheduler resumes tasks in slices instead.
+    SearchTask task(this, limits);
+    task.resume();
+    return task.result();
+}
+
+bool Eval::searchLimitReached() {
+    if (stopRequested.load(std::memory_order_relaxed)) { return true; };
+    if (nodeLimit && nodes >= nodeLimit) { return true; };
+    // Reading the clock is comparatively slow, so it is only checked every 1024 nodes.
+    if ((nodes & 1023) == 0 && !pondering.load(std::memory_order_relaxed)) {
+        long long searchDeadline = deadline.load(std::memory_order_relaxed);
+        if (searchDeadline && (long long)steadyClockNanoseconds() >= searchDeadline) { return true; };
+    };
+    return false;
+}
+
+void Eval::stopSearch() {
+    stopRequested = true;
+}
+
+void Eval::ponderHit() {
+    // The opponent played the expected move, so the clock starts now.
+    u64 moveTime = searchMoveTime.load(std::memory_order_relaxed);
+    if (moveTime) { deadline = (long long)(steadyClockNanoseconds() + moveTime * 1000000); };
+    pondering = false;
+}
+
+std::vector<u16> Eval::findPrincipalVariation(uint maxLength, u16 firstMove) {
+    // Follows best moves stored in the transposition table, stopping at a missing entry or a repeated key.
+    // A first move, such as a MultiPV line's root move, is played before the table is followed.
+    std::vector<u16> line;
+    std::vector<MoveData*> played;
+    std::vector<u64> seen;
+    if (firstMove != NULL_MOVE && maxLength > 0) {
+        MoveData* move = findLegalMove(firstMove);
+        if (!move) { return line; };
+        seen.push_back(board->zobristHash);
+        line.push_back(firstMove);
+        doMove(move);
+        played.push_back(move);
+    };
+    while (line.size() < maxLength) {
+        Transposition tp = transpositionCache[board->zobristHash & transpositionMask];
+        if (tp.key != board->zobristHash || tp.refutation == NULL_MOVE) { break; };
+        if (std::find(seen.begin(), seen.end(), board->zobristHash) != seen.end()) { break; };
+        MoveData* move = findLegalMove(tp.refutation);
+        if (!move) { break; };
+        seen.push_back(board->zobristHash);
+        line.push_back(tp.refutation);
+        doMove(move);
+        played.push_back(move);
+    }
+    while (!played.empty()) {
+        undoMove(played.back());
+        delete played.back();
+        played.pop_back();
+    }
+    return line;
+}
+
+MoveData* Eval::findLegalMove(u16 code) {
+    // Returns a new MoveData for the legal move with this encoding, or nullptr if there is none.
+    MoveData* found = nullptr;
+    std::vector<MoveData*> moves = findLegalMoves(isInCheck() ? findEvasionMoves() : findPseudoLegalMoves());
+    std::vector<MoveData*>::iterator it;
+    for (it = moves.begin(); it != moves.end(); ++it) {
+        if ((*it)->encode() == code) {
+            found = *it;
+            moves.erase(it);
+            break;
+        };
+    }
+    releaseMoves(moves);
+    return found;
+}
+
+MoveData* Eval::findSanMove(const std::string& san) {
+    // Standard algebraic notation, e.g. Nbd7, exd8=Q+ or O-O. Returns a new MoveData for the one
+    // legal move it describes, or nullptr when it describes none or several.
+    std::string text = san;
+    while (!text.empty() && std::string("+#!?").find(text.back()) != std::string::npos) { text.pop_back(); }
+    if (text == "O-O" || text == "0-0" || text == "O-O-O" || text == "0-0-0") {
+        uint from = board->currentTurn ? 4 : 60;
+        uint to = text.size() == 3 ? from + 2 : from - 2;
+        return findLegalMove((u16)(from | (to << 6)));
+    };
+    // Piece types by engine index for white: king 2, pawn 3, bishop 4, knight 5, rook 6, queen 7.
+    const std::string pieceLetters = "KPBNRQ";
+    int pieceType = 3;
+    if (!text.empty() && text[0] != 'P' && pieceLetters.find(text[0]) != std::string::npos) {
+        pieceType = 2 + (int)pieceLetters.find(text[0]);
+        text.erase(0, 1);
+    }
+    else if (!text.empty() && text[0] == 'P') {
+        text.erase(0, 1);
+    };
+    int promotionType = 0;
+    if (!text.empty() && pieceLetters.find(text.back()) > 1 && pieceLetters.find(text.back()) != std::string::npos) {
+        promotionType = 2 + (int)pieceLetters.find(text.back());
+        text.pop_back();
+        if (!text.empty() && text.back() == '=') { text.pop_back(); };
+    };
+    if (text.size() < 2) { return nullptr; };
+    char toFile = text[text.size() - 2], toRank = text[text.size() - 1];
+    if (toFile < 'a' || toFile > 'h' || toRank < '1' || toRank > '8') { return nullptr; };
+    int to = (toFile - 'a') + 8 * (toRank - '1');
+    // What is left between the piece and the target square disambiguates the origin.
+    int fromFile = -1, fromRank = -1;
+    for (size_t i = 0; i + 2 < text.size(); i++) {
+        char c = text[i];
+        if (c >= 'a' && c <= 'h') { fromFile = c - 'a'; }
+        else if (c >= '1' && c <= '8') { fromRank = c - '1'; }
+        else if (c != 'x' && c != '-' && c != ':') { return nullptr; };
+    }
+
+    // Only the moves that fit the text are tested for legality, which is most of the cost.
+    std::vector<MoveData*> candidates;
+    std::vector<MoveData*> moves = isInCheck() ? findEvasionMoves() : findPseudoLegalMoves();
+    for (MoveData* move : moves) {
+        int type = move->piece > 8 ? move->piece - 7 : move->piece;
+        int promoted = move->pPiece > 0 ? (move->pPiece > 8 ? move->pPiece - 7 : move->pPiece) : 0;
+        bool fits = type == pieceType && move->newSquare == to && promoted == promotionType
+            && (fromFile < 0 || move->oldSquare % 8 == fromFile) && (fromRank < 0 || move->oldSquare / 8 == fromRank);
+        if (fits) { candidates.push_back(move); }
+        else { delete move; };
+    }
+    candidates = findLegalMoves(candidates);
+    if (candidates.size() == 1) { return candidates[0]; };
+    releaseMoves(candidates);
+    return nullptr;
+}
+
+void Eval::resetGameHistory() {
+    hashHistory.clear();
+    enPassantHistory.clear();
+    castlingRightsHistory.clear();
+    halfMoveClockHistory.clear();
+    pliesFromNullHistory.clear();
+    pliesFromNull = 0;
+    currentDepth = 0;
+}
+
+bool Eval::isRepetition() {
+    // Only positions since the last irreversible move or null move can recur, and only with the
+    // same side to move, so the scan covers that window in steps of two plies.
+    uint window = std::min<uint>(std::min(board->halfMoveClock, pliesFromNull), (uint)hashHistory.size());
+    size_t size = hashHistory.size();
+    uint earlier = 0;
+    for (uint back = 4; back <= window; back += 2) {
+        if (hashHistory[size - back] != board->zobristHash) { continue; };
+        // Within the search one recurrence is a draw, since the same moves can repeat it again;
+        // positions from before the root must have occurred twice, as the rule requires.
+        if (back <= currentDepth || ++earlier == 2) { return true; };
+    }
+    return false;
+}
+
+bool Eval::isDrawByRule() {
+    if (board->halfMoveClock >= FIFTY_MOVE_PLIES) {
+        // Mate on the hundredth ply still stands.
+        if (!isInCheck()) { return true; };
+        std::vector<MoveData*> moves = findLegalMoves(findEvasionMoves());
+        bool hasMoves = !moves.empty();
+        releaseMoves(moves);
+        return hasMoves;
+    };
+    return isRepetition();
+}
+
+std::string Eval::moveToString(u16 move) {
+    // Long algebraic (UCI) notation, e.g. e2e4 or e7e8q.
+    if (move == NULL_MOVE) { return "0000"; };
+    std::string text;
+    uint from = move & 63;
+    uint to = (move >> 6) & 63;
+    uint promotion = move >> 12;
+    text += (char)('a' + from % 8);
+    text += (char)('1' + from / 8);
+    text += (char)('a' + to % 8);
+    text += (char)('1' + to / 8);
+    if (promotion) { text += "bnrq"[promotion - 1]; };
+    return text;
+}
+
+u16 Eval::stringToMove(std::string text) {
+    if (text.size() < 4 || text[0] < 'a' || text[0] > 'h' || text[1] < '1' || text[1] > '8'
+        || text[2] < 'a' || text[2] > 'h' || text[3] < '1' || text[3] > '8') {
+        return NULL_MOVE;
+    };
+    uint from = (text[0] - 'a') + 8 * (text[1] - '1');
+    uint to = (text[2] - 'a') + 8 * (text[3] - '1');
+    uint promotion = 0;
+    if (text.size() > 4) {
+        size_t piece = std::string("bnrq").find(text[4]);
+        promotion = piece == std::string::npos ? 0 : (uint)piece + 1;
+    };
+    return (u16)(from | (to << 6) | (promotion << 12));
+}
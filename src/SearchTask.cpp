@@ -0,0 +1,459 @@
+#include "../inc/SearchTask.h"
+#include "../inc/Clock.h"
+#include "../inc/Tablebase.h"
+#include <algorithm>
+
+SearchTask::SearchTask(Eval* setEngine, SearchLimits setLimits) : engine(setEngine), limits(setLimits) {
+    frames.resize(2 * MAX_SEARCH_PLY);
+}
+
+SearchTask::~SearchTask() {
+    // A task dropped part way leaves its engine between moves; take them back.
+    while (height > 0) {
+        Frame& frame = frames[height - 1];
+        if (frame.stage == AFTER_NULL_MOVE) {
+            engine->currentDepth--;
+            engine->undoNullMove();
+        }
+        else if (frame.stage == AFTER_VERIFICATION) {
+            engine->nullMoveDisabled--;
+        }
+        else if (frame.stage == AFTER_REDUCED || frame.stage == AFTER_CHILD) {
+            engine->currentDepth--;
+            engine->undoMove(frame.moves[frame.moveIndex]);
+        };
+        Eval::releaseMoves(frame.moves);
+        height--;
+    }
+    engine->excludedRootMoves.clear();
+}
+
+void SearchTask::start() {
+    started = true;
+    engine->nodes = 0;
+    engine->stats.reset();
+    engine->evalCacheProbes = 0;
+    engine->evalCacheHits = 0;
+    engine->nodeLimit = limits.nodes;
+    engine->searchAborted = false;
+    engine->currentDepth = 0;
+    engine->searchStartTime = steadyClockNanoseconds();
+    engine->searchMoveTime = limits.moveTime;
+    engine->deadline = limits.moveTime ? (long long)(engine->searchStartTime + limits.moveTime * 1000000) : 0;
+    // A root covered by the tables is played straight from DTM.
+    if (engine->tablebases) {
+        Score score;
+        u16 move = engine->tablebases->probeRootMove(engine, score);
+        if (move != NULL_MOVE) {
+            searchResult.bestMove = move;
+            searchResult.score = score;
+            searchResult.depth = 1;
+            searchResult.lines.assign(1, SearchLine{move, score, 1});
+            searchResult.nodes = engine->nodes;
+            searchResult.time = (steadyClockNanoseconds() - engine->searchStartTime) / 1000000;
+            if (engine->onIteration) { engine->onIteration(searchResult); };
+            engine->deadline = 0;
+            engine->nodeLimit = 0;
+            done = true;
+            return;
+        };
+    };
+    lineCount = std::max(1u, limits.multiPV);
+    if (lineCount > 1) {
+        std::vector<MoveData*> moves = engine->findLegalMoves(engine->isInCheck() ? engine->findEvasionMoves() : engine->findPseudoLegalMoves());
+        lineCount = std::max<uint>(1, std::min<uint>(lineCount, (uint)moves.size()));
+        Eval::releaseMoves(moves);
+    };
+    maxDepth = (limits.depth > 0 && limits.depth < MAX_SEARCH_PLY) ? limits.depth : MAX_SEARCH_PLY - 1;
+    iterationDepth = 1;
+}
+
+void SearchTask::finish() {
+    if (searchResult.bestMove == NULL_MOVE) {
+        // Stopped before the first iteration finished: any legal move beats none.
+        std::vector<MoveData*> moves = engine->findLegalMoves(engine->isInCheck() ? engine->findEvasionMoves() : engine->findPseudoLegalMoves());
+        if (!moves.empty()) {
+            searchResult.bestMove = moves[0]->encode();
+            searchResult.lines.assign(1, SearchLine{searchResult.bestMove, 0, 0});
+        };
+        Eval::releaseMoves(moves);
+    };
+    searchResult.nodes = engine->nodes;
+    searchResult.time = (steadyClockNanoseconds() - engine->searchStartTime) / 1000000;
+    engine->nodeLimit = 0;
+    engine->deadline = 0;
+    done = true;
+}
+
+bool SearchTask::resume(u64 nodeBudget) {
+    if (!started) { start(); };
+    yieldAt = nodeBudget ? engine->nodes + nodeBudget : ~0ULL;
+    while (!done) {
+        // MultiPV: each pass searches the root with exact bounds and without the moves found so far.
+        // Later passes mostly hit entries the first one left at the same depth.
+        if (height == 0) {
+            engine->rootBestMove = NULL_MOVE;
+            push(iterationDepth, -SCORE_INFINITE, SCORE_INFINITE);
+        };
+        if (!runFrames()) { return false; };
+        if (!finishRootSearch(returned)) { finish(); };
+    }
+    return true;
+}
+
+bool SearchTask::finishRootSearch(Score score) {
+    // Iterative deepening: each completed iteration replaces the result, so an aborted one is discarded.
+    if (!engine->searchAborted) {
+        lines.push_back(SearchLine{engine->rootBestMove, score, iterationDepth});
+        if (engine->rootBestMove != NULL_MOVE && lines.size() < lineCount) {
+            engine->excludedRootMoves.push_back(engine->rootBestMove);
+            return true;
+        };
+    };
+    engine->excludedRootMoves.clear();
+    if (lines.empty()) { return false; };
+    for (const SearchLine& previous : searchResult.lines) {
+        if (lines.size() >= lineCount) { break; };
+        bool found = std::any_of(lines.begin(), lines.end(), [&](const SearchLine& line) { return line.move == previous.move; });
+        if (!found) { lines.push_back(previous); };
+    }
+    searchResult.lines.swap(lines);
+    lines.clear();
+    searchResult.bestMove = searchResult.lines[0].move;
+    searchResult.score = searchResult.lines[0].score;
+    searchResult.depth = iterationDepth;
+    searchResult.nodes = engine->nodes;
+    searchResult.time = (steadyClockNanoseconds() - engine->searchStartTime) / 1000000;
+    if (!engine->searchAborted) { engine->stats.finishIteration(iterationDepth); };
+    if (engine->onIteration) { engine->onIteration(searchResult); };
+    if (engine->searchAborted) { return false; };
+    // No legal moves, or forced mates on every line, will not change with more depth.
+    bool allMates = std::all_of(searchResult.lines.begin(), searchResult.lines.end(), [](const SearchLine& line) { return Scores::isMate(line.score); });
+    if (searchResult.bestMove == NULL_MOVE || allMates) { return false; };
+    return ++iterationDepth <= maxDepth;
+}
+
+void SearchTask::push(uint depth, Score alpha, Score beta) {
+    if (height == frames.size()) { frames.resize(frames.size() * 2); };
+    Frame& frame = frames[height++];
+    frame.stage = ENTER;
+    frame.depth = depth;
+    frame.alpha = alpha;
+    frame.beta = beta;
+}
+
+void SearchTask::pop(Score value, bool pathDependent) {
+    returned = value;
+    returnedPathDependent = pathDependent;
+    height--;
+}
+
+bool SearchTask::nearClockLimit(uint depth) {
+    return engine->board->halfMoveClock + depth >= FIFTY_MOVE_PLIES;
+}
+
+bool SearchTask::runFrames() {
+    Eval* e = engine;
+    Board* board = e->board;
+    while (height > 0) {
+        // push may grow the frame vector, so the reference is not used after a push.
+        Frame& f = frames[height - 1];
+        switch (f.stage) {
+            case ENTER: {
+                if (e->nodes >= yieldAt) { return false; };
+                e->nodes++;
+                STATS_INC(e->stats, STAT_NODES);
+                if (!e->searchAborted && e->searchLimitReached()) { e->searchAborted = true; };
+                if (e->searchAborted) { pop(0); break; };
+                // A drawn cycle scores as a draw at once, which prunes the whole repeating subtree. This comes
+                // before the table, whose entries do not know the path that led here.
+                if (e->currentDepth > 0 && e->isDrawByRule()) {
+                    STATS_INC(e->stats, STAT_RULE_DRAWS);
+                    pop(0, true);
+                    break;
+                };
+                if (f.depth == 0) { pop(e->evaluatePosition()); break; };
+                // Probe before generating moves: the entry was prefetched by doMove, and a hit skips generation entirely.
+                // The root always searches, so that it reports a best move. Stored scores ignore the clock,
+                // so they are not trusted where the fifty-move rule could cut this subtree short.
+                if (e->currentDepth > 0) {
+                    Score ttEval = nearClockLimit(f.depth) ? SCORE_NONE : e->checkTransposition(board->zobristHash, f.depth, f.alpha, f.beta);
+                    if (ttEval != SCORE_NONE) { pop(ttEval); break; };
+                    // Endgame tables are exact, so a hit ends the subtree; nearer wins score higher.
+                    if (e->tablebases && e->tablebases->covers(board)) {
+                        TablebaseResult result = e->tablebases->probeWDL(board);
+                        if (result != TB_UNKNOWN) {
+                            STATS_INC(e->stats, STAT_TABLEBASE_HITS);
+                            int sideScore = result == TB_WIN ? TABLEBASE_WIN_SCORE - (int)e->currentDepth : (result == TB_LOSS ? (int)e->currentDepth - TABLEBASE_WIN_SCORE : 0);
+                            pop((Score)(board->currentTurn ? sideScore : -sideScore));
+                            break;
+                        };
+                    };
+                };
+                f.turn = board->currentTurn;
+                f.inCheck = e->isInCheck();
+                f.staticEval = f.inCheck ? 0 : e->evaluatePosition();
+
+                // Null move pruning: if passing still fails high, a real move almost certainly will too.
+                bool previousNull = e->currentDepth > 0 && e->moveStack[e->currentDepth - 1] == NULL_MOVE;
+                if (e->searchOptions.nullMovePruning && !e->nullMoveDisabled && !f.inCheck && !previousNull
+                    && e->currentDepth > 0 && f.depth >= NULL_MOVE_MIN_DEPTH && e->hasNonPawnMaterial()
+                    && (f.turn ? f.staticEval >= f.beta : f.staticEval <= f.alpha)
+                ) {
+                    f.reduction = f.depth > 6 ? NULL_MOVE_REDUCTION + 1 : NULL_MOVE_REDUCTION;
+                    STATS_INC(e->stats, STAT_NULL_MOVE_TRIES);
+                    e->moveStack[e->currentDepth] = NULL_MOVE;
+                    e->doNullMove();
+                    e->currentDepth++;
+                    f.stage = AFTER_NULL_MOVE;
+                    uint depth = f.depth - 1 - f.reduction;
+                    Score alpha = f.turn ? f.beta - NULL_WINDOW : f.alpha;
+                    Score beta = f.turn ? f.beta : f.alpha + NULL_WINDOW;
+                    push(depth, alpha, beta);
+                    break;
+                };
+                f.stage = GENERATE;
+                break;
+            }
+            case AFTER_NULL_MOVE: {
+                Score nullEval = returned;
+                e->currentDepth--;
+                e->undoNullMove();
+                if (e->searchAborted) { pop(0); break; };
+                if (f.turn ? nullEval >= f.beta : nullEval <= f.alpha) {
+                    if (!e->isZugzwangProne()) {
+                        STATS_INC(e->stats, STAT_NULL_MOVE_CUTOFFS);
+                        pop(f.turn ? f.beta : f.alpha, returnedPathDependent);
+                        break;
+                    };
+                    // Near zugzwang the null move assumption is unsafe, so confirm with a reduced search without null moves.
+                    e->nullMoveDisabled++;
+                    f.stage = AFTER_VERIFICATION;
+                    uint depth = f.depth - f.reduction;
+                    Score alpha = f.alpha, beta = f.beta;
+                    push(depth, alpha, beta);
+                    break;
+                };
+                f.stage = GENERATE;
+                break;
+            }
+            case AFTER_VERIFICATION: {
+                Score verifyEval = returned;
+                e->nullMoveDisabled--;
+                if (e->searchAborted) { pop(0); break; };
+                if (f.turn ? verifyEval >= f.beta : verifyEval <= f.alpha) {
+                    STATS_INC(e->stats, STAT_NULL_MOVE_CUTOFFS);
+                    pop(verifyEval, returnedPathDependent);
+                    break;
+                };
+                f.stage = GENERATE;
+                break;
+            }
+            case GENERATE: {
+                {
+                    STATS_SCOPE(e->stats, TIMER_MOVE_GENERATION);
+                    f.moves = e->findLegalMoves(f.inCheck ? e->findEvasionMoves() : e->findPseudoLegalMoves());
+                }
+                if (f.moves.empty()) {
+                    // Checkmate is scored against the side to move, nearer mates further from zero; stalemate is a draw.
+                    pop(f.inCheck ? Scores::mated(e->currentDepth, f.turn) : 0);
+                    break;
+                };
+                if (e->currentDepth == 0 && !e->excludedRootMoves.empty()) {
+                    for (MoveData*& move : f.moves) {
+                        if (std::find(e->excludedRootMoves.begin(), e->excludedRootMoves.end(), move->encode()) == e->excludedRootMoves.end()) { continue; };
+                        delete move;
+                        move = nullptr;
+                    }
+                    f.moves.erase(std::remove(f.moves.begin(), f.moves.end(), nullptr), f.moves.end());
+                };
+                // Futility pruning: at frontier nodes, quiet moves cannot lift a hopeless static eval back into the window.
+                f.futile = e->searchOptions.futilityPruning && f.depth == 1 && !f.inCheck
+                    && (f.turn ? f.staticEval + FUTILITY_MARGIN <= f.alpha : f.staticEval - FUTILITY_MARGIN >= f.beta);
+                f.eval = f.turn ? -SCORE_INFINITE : SCORE_INFINITE;
+                f.bestMove = f.moves[0];
+                f.type = f.turn ? ALPHA : BETA;
+                f.pathDependent = false;
+                f.moveIndex = 0;
+                f.stage = NEXT_MOVE;
+                break;
+            }
+            case NEXT_MOVE: {
+                if (f.moveIndex >= f.moves.size()) {
+                    f.stage = FINISH;
+                    break;
+                };
+                MoveData* move = f.moves[f.moveIndex];
+                f.quiet = move->isQuiet() && move->score < COUNTER_ORDER_SCORE;
+                e->moveStack[e->currentDepth] = move->encode();
+                e->doMove(move);
+                f.givesCheck = e->isInCheck();
+                if (f.futile && f.quiet && !f.givesCheck && f.moveIndex > 0) {
+                    STATS_INC(e->stats, STAT_FUTILITY_PRUNES);
+                    e->undoMove(move);
+                    f.moveIndex++;
+                    break;
+                };
+                e->currentDepth++;
+                bool reducible = f.quiet && !f.inCheck && !f.givesCheck;
+                if (e->searchOptions.lateMoveReductions && reducible && f.depth >= LMR_MIN_DEPTH && f.moveIndex >= LMR_MIN_MOVES) {
+                    // Late quiet moves rarely improve on the earlier ones, so test them with a reduced null window search first.
+                    uint reduction = (f.depth >= 2 * LMR_MIN_DEPTH && f.moveIndex >= 2 * LMR_MIN_MOVES) ? 2 : 1;
+                    STATS_INC(e->stats, STAT_LMR_REDUCTIONS);
+                    f.stage = AFTER_REDUCED;
+                    uint depth = f.depth - 1 - reduction;
+                    Score alpha = f.turn ? f.alpha : f.beta - NULL_WINDOW;
+                    Score beta = f.turn ? f.alpha + NULL_WINDOW : f.beta;
+                    push(depth, alpha, beta);
+                    break;
+                };
+                f.stage = AFTER_CHILD;
+                uint depth = f.depth - 1;
+                Score alpha = f.alpha, beta = f.beta;
+                push(depth, alpha, beta);
+                break;
+            }
+            case AFTER_REDUCED: {
+                // A reduced score that stays inside the bound stands; otherwise search again at full depth.
+                f.stage = AFTER_CHILD;
+                bool failsHigh = f.turn ? returned > f.alpha : returned < f.beta;
+                if (!failsHigh) { break; };
+                STATS_INC(e->stats, STAT_LMR_RESEARCHES);
+                uint depth = f.depth - 1;
+                Score alpha = f.alpha, beta = f.beta;
+                push(depth, alpha, beta);
+                break;
+            }
+            case AFTER_CHILD: {
+                Score score = returned;
+                MoveData* move = f.moves[f.moveIndex];
+                e->currentDepth--;
+                e->undoMove(move);
+                if (e->searchAborted) {
+                    Eval::releaseMoves(f.moves);
+                    pop(0);
+                    break;
+                };
+                bool cutoff;
+                // The node's score follows its best child, and so does whether it rests on a rule draw.
+                if (f.turn) {
+                    if (score > f.eval) {
+                        f.eval = score;
+                        f.bestMove = move;
+                        f.pathDependent = returnedPathDependent;
+                    };
+                    cutoff = f.eval >= f.beta;
+                    if (!cutoff && f.eval > f.alpha) {
+                        f.alpha = f.eval;
+                        f.type = EXACT;
+                    };
+                }
+                else {
+                    if (score < f.eval) {
+                        f.eval = score;
+                        f.bestMove = move;
+                        f.pathDependent = returnedPathDependent;
+                    };
+                    cutoff = f.eval <= f.alpha;
+                    if (!cutoff && f.eval < f.beta) {
+                        f.beta = f.eval;
+                        f.type = EXACT;
+                    };
+                };
+                if (cutoff) {
+                    STATS_INC(e->stats, STAT_BETA_CUTOFFS);
+                    if (f.moveIndex == 0) { STATS_INC(e->stats, STAT_FIRST_MOVE_CUTOFFS); };
+                    e->updateQuietHeuristics(move, f.depth);
+                    f.type = f.turn ? BETA : ALPHA;
+                    f.stage = FINISH;
+                    break;
+                };
+                f.moveIndex++;
+                f.stage = NEXT_MOVE;
+                break;
+            }
+            case FINISH: {
+                if (e->currentDepth == 0) { e->rootBestMove = f.bestMove->encode(); };
+                // A score that rests on a rule draw, or that the clock could still change, keeps only its
+                // move: stored at depth 0 it orders moves and extends the PV but never cuts a search off.
+                bool pathDependent = f.pathDependent || nearClockLimit(f.depth);
+                if (pathDependent) { STATS_INC(e->stats, STAT_PATH_DEPENDENT_STORES); };
+                // A root searched without its best moves must not replace the entry the full root left.
+                if (e->currentDepth > 0 || e->excludedRootMoves.empty()) {
+                    Transposition tp;
+                    tp.init(board->zobristHash, f.bestMove->encode(), pathDependent ? 0 : f.depth, Scores::toTransposition(f.eval, e->currentDepth), f.type);
+                    e->addTransposition(tp);
+                };
+                Score eval = f.eval;
+                Eval::releaseMoves(f.moves);
+                pop(eval, pathDependent);
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+SearchScheduler::SearchScheduler(uint threadCount, u64 setQuantum) : quantum(setQuantum) {
+    if (threadCount == 0) { threadCount = 1; };
+    for (uint i = 0; i < threadCount; i++) { workers.emplace_back(&SearchScheduler::workerLoop, this); }
+}
+
+SearchScheduler::~SearchScheduler() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (std::thread& worker : workers) { worker.join(); }
+}
+
+// The heap keeps the task with the fewest nodes on top.
+static bool usedMoreNodes(const std::shared_ptr<SearchTask>& a, const std::shared_ptr<SearchTask>& b) {
+    return a->nodes() > b->nodes();
+}
+
+void SearchScheduler::submit(std::shared_ptr<SearchTask> task, std::function<void(const SearchResult&)> callback) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ready.push_back(Entry{task, callback});
+        std::push_heap(ready.begin(), ready.end(), [](const Entry& a, const Entry& b) { return usedMoreNodes(a.task, b.task); });
+        pending++;
+    }
+    taskAvailable.notify_one();
+}
+
+void SearchScheduler::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this]() { return pending == 0; });
+}
+
+void SearchScheduler::workerLoop() {
+    auto order = [](const Entry& a, const Entry& b) { return usedMoreNodes(a.task, b.task); };
+    while (true) {
+        Entry entry;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskAvailable.wait(lock, [this]() { return stopping || !ready.empty(); });
+            if (ready.empty()) { return; };
+            std::pop_heap(ready.begin(), ready.end(), order);
+            entry = std::move(ready.back());
+            ready.pop_back();
+        }
+        bool done = entry.task->resume(quantum);
+        if (done && entry.callback) { entry.callback(entry.task->result()); };
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (done) {
+                pending--;
+                if (pending == 0) { finished.notify_all(); };
+            }
+            else {
+                ready.push_back(std::move(entry));
+                std::push_heap(ready.begin(), ready.end(), order);
+            };
+        }
+        if (!done) { taskAvailable.notify_one(); };
+    }
+}
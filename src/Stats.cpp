@@ -0,0 +1,65 @@
+#include "../inc/Stats.h"
+#include "../inc/Clock.h"
+#include <sstream>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+static const char* COUNTER_NAMES[STAT_COUNTER_COUNT] = {
+    "nodes", "ttProbes", "ttHits", "ttCutoffs", "betaCutoffs", "firstMoveCutoffs", "nullMoveTries",
+    "nullMoveCutoffs", "lmrReductions", "lmrResearches", "futilityPrunes", "tablebaseHits",
+    "ruleDraws", "pathDependentStores"
+};
+static const char* TIMER_NAMES[STAT_TIMER_COUNT] = {"moveGeneration", "makeUnmake", "evaluation", "transposition"};
+
+unsigned long long SearchStats::readCycles() {
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return steadyClockNanoseconds();
+#endif
+}
+
+void SearchStats::finishIteration(unsigned int completedDepth) {
+    previousIterationNodes = iterationNodes;
+    iterationNodes = counters[STAT_NODES] - nodesAtLastIteration;
+    nodesAtLastIteration = counters[STAT_NODES];
+    depth = completedDepth;
+}
+
+void SearchStats::merge(const SearchStats& other) {
+    for (int i = 0; i < STAT_COUNTER_COUNT; i++) { counters[i] += other.counters[i]; }
+    for (int i = 0; i < STAT_TIMER_COUNT; i++) { cycles[i] += other.cycles[i]; }
+    iterationNodes += other.iterationNodes;
+    previousIterationNodes += other.previousIterationNodes;
+    nodesAtLastIteration += other.nodesAtLastIteration;
+    if (other.depth > depth) { depth = other.depth; };
+}
+
+double SearchStats::effectiveBranchingFactor() const {
+    return previousIterationNodes ? (double)iterationNodes / previousIterationNodes : 0;
+}
+
+static double ratio(unsigned long long part, unsigned long long whole) {
+    return whole ? (double)part / whole : 0;
+}
+
+std::string SearchStats::toJson() const {
+    std::ostringstream json;
+    json << "{\"depth\":" << depth;
+    for (int i = 0; i < STAT_COUNTER_COUNT; i++) { json << ",\"" << COUNTER_NAMES[i] << "\":" << counters[i]; }
+    json << ",\"ttHitRate\":" << ratio(counters[STAT_TT_HITS], counters[STAT_TT_PROBES])
+         << ",\"firstMoveCutoffRate\":" << ratio(counters[STAT_FIRST_MOVE_CUTOFFS], counters[STAT_BETA_CUTOFFS])
+         << ",\"effectiveBranchingFactor\":" << effectiveBranchingFactor();
+#if MYCHESS_STATS_TIMERS
+    json << ",\"cycles\":{";
+    for (int i = 0; i < STAT_TIMER_COUNT; i++) { json << (i ? "," : "") << "\"" << TIMER_NAMES[i] << "\":" << cycles[i]; }
+    json << "}";
+#else
+    (void)TIMER_NAMES;
+#endif
+    json << "}";
+    return json.str();
+}
@@ -0,0 +1,737 @@
+#include "../inc/Tablebase.h"
+#include "../inc/Eval.h"
+#include "../inc/Clock.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#define TABLEBASE_WDL_MAGIC "MCTBWDL1"
+#define TABLEBASE_DTM_MAGIC "MCTBDTM1"
+
+static const char PIECE_LETTERS[] = "  KPBNRQ";
+static const int STRENGTH_ORDER[] = {7, 6, 4, 5, 3}; // Q R B N P, as white piece indices.
+
+static int swapColour(int piece) { return piece < 8 ? piece + 7 : piece - 7; }
+static int pieceType(int piece) { return piece > 7 ? piece - 7 : piece; }
+static bool isWhitePiece(int piece) { return piece < 8; }
+
+static int strengthRank(int piece) {
+    int type = pieceType(piece);
+    for (int i = 0; i < 5; i++) {
+        if (STRENGTH_ORDER[i] == type) { return i; };
+    }
+    return 5;
+}
+
+static int transformSquare(int square, int transform) {
+    if (transform & 1) { square ^= 7; };
+    if (transform & 2) { square ^= 56; };
+    if (transform & 4) { square = ((square >> 3) | (square << 3)) & 63; };
+    return square;
+}
+
+// Slot of the white king square, or -1 when a symmetry must move it first.
+static int kingSlot(int square, bool hasPawns) {
+    int file = square & 7;
+    int rank = square >> 3;
+    if (hasPawns) { return file <= 3 ? rank * 4 + file : -1; };
+    if (file > 3 || rank > file) { return -1; };
+    static const int RANK_START[4] = {0, 3, 5, 6};
+    return RANK_START[rank] + file;
+}
+
+static int slotSquare(int slot, bool hasPawns) {
+    for (int square = 0; square < 64; square++) {
+        if (kingSlot(square, hasPawns) == slot) { return square; };
+    }
+    return -1;
+}
+
+TablebaseMaterial TablebaseMaterial::fromName(const std::string& name) {
+    size_t split = name.find('v');
+    if (split == std::string::npos || name[0] != 'K' || split + 1 >= name.size() || name[split + 1] != 'K') {
+        throw std::invalid_argument("tablebase name must look like KQvKR: " + name);
+    };
+    std::vector<int> pieces = {2, 9};
+    for (size_t i = 0; i < name.size(); i++) {
+        if (i == 0 || i == split || i == split + 1) { continue; };
+        const char* letter = std::strchr(PIECE_LETTERS + 3, name[i]);
+        if (!letter) {
+            throw std::invalid_argument("unknown piece in tablebase name " + name);
+        };
+        int piece = (int)(letter - PIECE_LETTERS);
+        pieces.push_back(i < split ? piece : swapColour(piece));
+    }
+    if (pieces.size() > TABLEBASE_MAX_PIECES) {
+        throw std::invalid_argument("tablebases are limited to " + std::to_string(TABLEBASE_MAX_PIECES) + " pieces: " + name);
+    };
+    bool swapped;
+    return fromPieces(pieces, swapped);
+}
+
+TablebaseMaterial TablebaseMaterial::fromPieces(const std::vector<int>& pieces, bool& coloursSwapped) {
+    std::vector<int> white, black;
+    for (int piece : pieces) {
+        if (pieceType(piece) == 2) { continue; };
+        if (isWhitePiece(piece)) { white.push_back(piece); }
+        else { black.push_back(swapColour(piece)); };
+    }
+    auto byStrength = [](int a, int b) { return strengthRank(a) < strengthRank(b); };
+    std::sort(white.begin(), white.end(), byStrength);
+    std::sort(black.begin(), black.end(), byStrength);
+    // The stronger side is stored as white: more pieces first, then the stronger pieces.
+    coloursSwapped = false;
+    if (black.size() != white.size()) { coloursSwapped = black.size() > white.size(); }
+    else {
+        for (size_t i = 0; i < white.size(); i++) {
+            if (strengthRank(white[i]) != strengthRank(black[i])) {
+                coloursSwapped = strengthRank(black[i]) < strengthRank(white[i]);
+                break;
+            };
+        }
+    };
+    if (coloursSwapped) { std::swap(white, black); };
+
+    TablebaseMaterial material;
+    material.pieces = {2, 9};
+    material.name = "K";
+    for (int piece : white) {
+        material.pieces.push_back(piece);
+        material.name += PIECE_LETTERS[piece];
+    }
+    material.name += "vK";
+    for (int piece : black) {
+        material.pieces.push_back(swapColour(piece));
+        material.name += PIECE_LETTERS[piece];
+    }
+    for (int piece : material.pieces) {
+        if (pieceType(piece) == 3) { material.hasPawns = true; };
+    }
+    return material;
+}
+
+u64 TablebaseMaterial::entryCount() const {
+    u64 count = 2 * (hasPawns ? 32 : 10);
+    for (size_t i = 1; i < pieces.size(); i++) { count *= 64; }
+    return count;
+}
+
+u64 TablebaseMaterial::index(const int* squares, bool whiteToMove) const {
+    int transform = 0;
+    while (kingSlot(transformSquare(squares[0], transform), hasPawns) < 0) { transform++; }
+    u64 index = (whiteToMove ? 1 : 0) * (hasPawns ? 32 : 10) + kingSlot(transformSquare(squares[0], transform), hasPawns);
+    for (size_t i = 1; i < pieces.size(); i++) { index = index * 64 + transformSquare(squares[i], transform); }
+    return index;
+}
+
+void TablebaseMaterial::decode(u64 index, int* squares, bool& whiteToMove) const {
+    for (size_t i = pieces.size() - 1; i > 0; i--) {
+        squares[i] = (int)(index & 63);
+        index >>= 6;
+    }
+    uint slots = hasPawns ? 32 : 10;
+    squares[0] = slotSquare((int)(index % slots), hasPawns);
+    whiteToMove = index / slots;
+}
+
+u64 TablebaseMaterial::materialKey(bool coloursSwapped) const {
+    u64 key = 0;
+    for (int piece : pieces) {
+        if (pieceType(piece) == 2) { continue; };
+        key += 1ULL << (4 * (coloursSwapped ? swapColour(piece) : piece));
+    }
+    return key;
+}
+
+// Probing
+
+uint Tablebases::load(const std::string& directory) {
+    tables.clear();
+    byMaterial.clear();
+    maxPieces = 0;
+    std::error_code error;
+    for (const auto& file : std::filesystem::directory_iterator(directory, error)) {
+        if (file.path().extension() != ".wdl") { continue; };
+        std::unique_ptr<Table> table(new Table());
+        try {
+            table->material = TablebaseMaterial::fromName(file.path().stem().string());
+        }
+        catch (const std::invalid_argument&) {
+            continue;
+        }
+        std::string base = (std::filesystem::path(directory) / table->material.name).string();
+        if (!table->wdl.open(base + ".wdl") || table->wdl.size() < TABLEBASE_HEADER_SIZE
+            || std::memcmp(table->wdl.bytes(), TABLEBASE_WDL_MAGIC, 8) != 0) { continue; };
+        if (table->dtm.open(base + ".dtm")) {
+            if (table->dtm.size() < TABLEBASE_HEADER_SIZE + 4 || std::memcmp(table->dtm.bytes(), TABLEBASE_DTM_MAGIC, 8) != 0) {
+                table->dtm.close();
+            }
+            else {
+                std::memcpy(&table->blockCount, table->dtm.bytes() + TABLEBASE_HEADER_SIZE, 4);
+            };
+        };
+        Table* stored = table.get();
+        tables.push_back(std::move(table));
+        byMaterial[stored->material.materialKey(false)] = {stored, false};
+        u64 swappedKey = stored->material.materialKey(true);
+        if (!byMaterial.count(swappedKey)) { byMaterial[swappedKey] = {stored, true}; };
+        maxPieces = std::max(maxPieces, (int)stored->material.pieces.size());
+    }
+    return (uint)tables.size();
+}
+
+u64 Tablebases::boardMaterialKey(Board* board) {
+    u64 key = 0;
+    for (int piece = 3; piece < 15; piece++) {
+        if (piece == 8 || piece == 9) { continue; };
+        key += (u64)BitOps::countSetBits(board->pieceLocations[piece]) << (4 * piece);
+    }
+    return key;
+}
+
+bool Tablebases::covers(Board* board) {
+    if (tables.empty() || board->castlingRights || board->enPassantCapturePossible()) { return false; };
+    if (BitOps::countSetBits(board->pieceLocations[0]) > maxPieces) { return false; };
+    u64 key = boardMaterialKey(board);
+    return key == 0 || byMaterial.count(key);
+}
+
+Tablebases::Table* Tablebases::locate(Board* board, int* squares, bool& whiteToMove) {
+    std::unordered_map<u64, std::pair<Table*, bool>>::iterator found = byMaterial.find(boardMaterialKey(board));
+    if (found == byMaterial.end()) { return nullptr; };
+    Table* table = found->second.first;
+    bool swapped = found->second.second;
+    u64 remaining[15];
+    std::memcpy(remaining, board->pieceLocations, sizeof(remaining));
+    for (size_t i = 0; i < table->material.pieces.size(); i++) {
+        int piece = swapped ? swapColour(table->material.pieces[i]) : table->material.pieces[i];
+        int square = BitOps::countTrailingZeroes(remaining[piece]);
+        remaining[piece] &= remaining[piece] - 1;
+        squares[i] = swapped ? square ^ 56 : square;
+    }
+    whiteToMove = swapped ? !board->currentTurn : board->currentTurn;
+    return table;
+}
+
+TablebaseResult Tablebases::probeWDL(Board* board) {
+    if (!covers(board)) { return TB_UNKNOWN; };
+    int squares[TABLEBASE_MAX_PIECES];
+    bool whiteToMove;
+    Table* table = locate(board, squares, whiteToMove);
+    if (!table) { return TB_DRAW; }; // Bare kings.
+    u64 index = table->material.index(squares, whiteToMove);
+    unsigned char packed = table->wdl.bytes()[TABLEBASE_HEADER_SIZE + index / 4];
+    return (TablebaseResult)((packed >> (2 * (index % 4))) & 3);
+}
+
+bool Tablebases::probeDTM(Board* board, int& value) {
+    if (!covers(board)) { return false; };
+    int squares[TABLEBASE_MAX_PIECES];
+    bool whiteToMove;
+    Table* table = locate(board, squares, whiteToMove);
+    value = 0;
+    if (!table) { return true; };
+    if (!table->dtm.isOpen()) { return false; };
+    u64 index = table->material.index(squares, whiteToMove);
+    const unsigned char* bytes = table->dtm.bytes();
+    uint block = (uint)(index / TABLEBASE_BLOCK_SIZE);
+    uint offsets[2];
+    std::memcpy(offsets, bytes + TABLEBASE_HEADER_SIZE + 4 + 4 * block, 8);
+    const unsigned char* data = bytes + TABLEBASE_HEADER_SIZE + 4 + 4 * (table->blockCount + 1);
+    // Runs are (length, value) byte pairs; skip whole runs until the entry is reached.
+    uint skip = (uint)(index % TABLEBASE_BLOCK_SIZE);
+    for (uint at = offsets[0]; at < offsets[1]; at += 2) {
+        if (skip < data[at]) {
+            value = data[at + 1];
+            return true;
+        };
+        skip -= data[at];
+    }
+    return false;
+}
+
+u16 Tablebases::probeRootMove(Eval* engine, Score& score) {
+    Board* board = engine->board;
+    if (!covers(board)) { return NULL_MOVE; };
+    std::vector<MoveData*> moves = engine->findLegalMoves(engine->isInCheck() ? engine->findEvasionMoves() : engine->findPseudoLegalMoves());
+    // Rank moves for the side to move: quickest win, then a draw, then the slowest loss.
+    u16 bestMove = NULL_MOVE;
+    int bestRank = -1000;
+    int bestPlies = 0;
+    for (MoveData* move : moves) {
+        engine->doMove(move);
+        int value;
+        bool known = probeDTM(board, value);
+        engine->undoMove(move);
+        if (!known) {
+            Eval::releaseMoves(moves);
+            return NULL_MOVE;
+        };
+        int rank = 0;
+        int plies = TablebaseValue::plies(value) + 1;
+        if (TablebaseValue::isLoss(value)) { rank = 500 - plies; }
+        else if (TablebaseValue::isWin(value)) { rank = -500 + plies; };
+        if (rank > bestRank) {
+            bestRank = rank;
+            bestMove = move->encode();
+            bestPlies = value ? plies : 0;
+        };
+    }
+    Eval::releaseMoves(moves);
+    int sideScore = bestRank > 0 ? TABLEBASE_WIN_SCORE - bestPlies : (bestRank < 0 ? -TABLEBASE_WIN_SCORE + bestPlies : 0);
+    score = (Score)(board->currentTurn ? sideScore : -sideScore);
+    return bestMove;
+}
+
+// Generation
+
+TablebaseGenerator::TablebaseGenerator(const std::string& directory) : directory(directory) {
+    board = new Board();
+    engine = new Eval(board);
+}
+
+TablebaseGenerator::~TablebaseGenerator() {
+    delete engine;
+    delete board;
+}
+
+std::vector<std::string> TablebaseGenerator::allMaterials(int maxPieces) {
+    // Every distinct split of up to maxPieces - 2 extra pieces between the two sides.
+    std::vector<std::string> names;
+    std::vector<int> extra;
+    std::function<void(int)> extend = [&](int first) {
+        if (!extra.empty()) {
+            for (uint mask = 0; mask < (1u << extra.size()); mask++) {
+                std::vector<int> pieces = {2, 9};
+                for (size_t i = 0; i < extra.size(); i++) { pieces.push_back((mask >> i) & 1 ? swapColour(extra[i]) : extra[i]); }
+                bool swapped;
+                std::string name = TablebaseMaterial::fromPieces(pieces, swapped).name;
+                if (std::find(names.begin(), names.end(), name) == names.end()) { names.push_back(name); };
+            }
+        };
+        if ((int)extra.size() + 2 >= maxPieces) { return; };
+        for (int i = first; i < 5; i++) {
+            extra.push_back(STRENGTH_ORDER[i]);
+            extend(i);
+            extra.pop_back();
+        }
+    };
+    extend(0);
+    std::stable_sort(names.begin(), names.end(), [](const std::string& a, const std::string& b) { return a.size() < b.size(); });
+    return names;
+}
+
+const std::vector<unsigned char>& TablebaseGenerator::require(const std::string& name) {
+    std::unordered_map<std::string, std::vector<unsigned char>>::iterator found = solved.find(name);
+    if (found != solved.end()) { return found->second; };
+    TablebaseMaterial material = TablebaseMaterial::fromName(name);
+    std::vector<unsigned char> values;
+    if (!readTable(directory, material, values)) {
+        generate(name);
+        return solved[name];
+    };
+    return solved[name] = std::move(values);
+}
+
+TablebaseGenerator::Stats TablebaseGenerator::generate(const std::string& name) {
+    TablebaseMaterial material = TablebaseMaterial::fromName(name);
+    Stats stats;
+    unsigned long long start = steadyClockNanoseconds();
+    prepareExits(material);
+    std::vector<unsigned char> reduced;
+    solve(material, reduced, stats);
+    if (!writeTable(directory, material, reduced)) {
+        throw std::runtime_error("cannot write tablebase " + material.name + " to " + directory);
+    };
+    solved[material.name] = std::move(reduced);
+    stats.seconds = secondsSince(start);
+    if (onTableFinished) { onTableFinished(material.name, stats); };
+    return stats;
+}
+
+int TablebaseGenerator::exitCode(int captured, int promoting, int promotion) {
+    return (captured + 1) + 5 * (promoting + 1) + 25 * promotion;
+}
+
+void TablebaseGenerator::prepareExits(TablebaseMaterial& material) {
+    // Every capture and promotion leaves this table; solve their targets up front so that the
+    // generation loop only does lookups.
+    std::unordered_map<int, Exit> prepared;
+    int count = (int)material.pieces.size();
+    for (int captured = -1; captured < count; captured++) {
+        if (captured >= 0 && pieceType(material.pieces[captured]) == 2) { continue; };
+        for (int promoting = -1; promoting < count; promoting++) {
+            if (promoting == captured) { continue; };
+            if (promoting >= 0 && pieceType(material.pieces[promoting]) != 3) { continue; };
+            if (captured < 0 && promoting < 0) { continue; };
+            for (int type : {7, 6, 4, 5}) {
+                int promotion = promoting < 0 ? 0 : (isWhitePiece(material.pieces[promoting]) ? type : swapColour(type));
+                std::vector<int> pieces;
+                std::vector<int> slots;
+                for (int i = 0; i < count; i++) {
+                    if (i == captured) { continue; };
+                    pieces.push_back(i == promoting ? promotion : material.pieces[i]);
+                    slots.push_back(i);
+                }
+                Exit exit;
+                exit.material = TablebaseMaterial::fromPieces(pieces, exit.coloursSwapped);
+                std::vector<bool> used(pieces.size(), false);
+                for (size_t k = 0; k < exit.material.pieces.size(); k++) {
+                    int wanted = exit.coloursSwapped ? swapColour(exit.material.pieces[k]) : exit.material.pieces[k];
+                    for (size_t j = 0; j < pieces.size(); j++) {
+                        if (!used[j] && pieces[j] == wanted) {
+                            used[j] = true;
+                            exit.source[k] = slots[j];
+                            break;
+                        };
+                    }
+                }
+                if (pieces.size() > 2) { exit.values = &require(exit.material.name); };
+                prepared[exitCode(captured, promoting, promotion)] = exit;
+                if (promoting < 0) { break; };
+            }
+        }
+    }
+    exits = std::move(prepared);
+}
+
+int TablebaseGenerator::probeExit(const Move& move) {
+    const Exit& exit = exits.at(exitCode(move.captured, move.promoting, move.promotion));
+    if (!exit.values) { return 0; };
+    int squares[TABLEBASE_MAX_PIECES];
+    for (size_t k = 0; k < exit.material.pieces.size(); k++) {
+        int square = move.child.squares[exit.source[k]];
+        squares[k] = exit.coloursSwapped ? square ^ 56 : square;
+    }
+    bool whiteToMove = exit.coloursSwapped ? !move.child.whiteToMove : move.child.whiteToMove;
+    return (*exit.values)[exit.material.index(squares, whiteToMove)];
+}
+
+u64 TablebaseGenerator::fullIndex(const Position& position) {
+    u64 index = position.whiteToMove ? 1 : 0;
+    for (int i = 0; i < position.count; i++) { index = index * 64 + position.squares[i]; }
+    return index;
+}
+
+void TablebaseGenerator::decodeFull(u64 index, Position& position) {
+    for (int i = position.count - 1; i >= 0; i--) {
+        position.squares[i] = (int)(index & 63);
+        index >>= 6;
+    }
+    position.whiteToMove = index & 1;
+}
+
+u64 TablebaseGenerator::attacksFrom(int piece, int square, u64 occupancy) {
+    u64 bit = 1ULL << square;
+    switch (pieceType(piece)) {
+        case 2: return engine->kingMovesTable[square];
+        case 3:
+            if (isWhitePiece(piece)) { return ((bit << 7) & ~0x8080808080808080ULL) | ((bit << 9) & ~0x0101010101010101ULL); };
+            return ((bit >> 9) & ~0x8080808080808080ULL) | ((bit >> 7) & ~0x0101010101010101ULL);
+        case 4: return engine->lookupBishopAttacks(square, occupancy);
+        case 5: return engine->knightMovesTable[square];
+        case 6: return engine->lookupRookAttacks(square, occupancy);
+        default: return engine->lookupBishopAttacks(square, occupancy) | engine->lookupRookAttacks(square, occupancy);
+    }
+}
+
+bool TablebaseGenerator::isAttacked(const Position& position, int square, bool byWhite, u64 occupancy, int ignore) {
+    for (int i = 0; i < position.count; i++) {
+        if (i == ignore || isWhitePiece(position.pieces[i]) != byWhite) { continue; };
+        if (attacksFrom(position.pieces[i], position.squares[i], occupancy) & (1ULL << square)) { return true; };
+    }
+    return false;
+}
+
+bool TablebaseGenerator::isValid(const Position& position) {
+    u64 occupancy = 0;
+    for (int i = 0; i < position.count; i++) {
+        u64 bit = 1ULL << position.squares[i];
+        if (occupancy & bit) { return false; };
+        occupancy |= bit;
+        int rank = position.squares[i] >> 3;
+        if (pieceType(position.pieces[i]) == 3 && (rank == 0 || rank == 7)) { return false; };
+    }
+    // The side that just moved cannot have left its king in check.
+    int king = position.whiteToMove ? 1 : 0;
+    return !isAttacked(position, position.squares[king], position.whiteToMove, occupancy, -1);
+}
+
+int TablebaseGenerator::generateMoves(const Position& position, Move* moves) {
+    int count = 0;
+    bool white = position.whiteToMove;
+    u64 occupancy = 0, own = 0, enemy = 0;
+    for (int i = 0; i < position.count; i++) {
+        u64 bit = 1ULL << position.squares[i];
+        occupancy |= bit;
+        if (isWhitePiece(position.pieces[i]) == white) { own |= bit; }
+        else { enemy |= bit; };
+    }
+    for (int i = 0; i < position.count; i++) {
+        int piece = position.pieces[i];
+        if (isWhitePiece(piece) != white) { continue; };
+        int from = position.squares[i];
+        bool pawn = pieceType(piece) == 3;
+        u64 targets;
+        if (pawn) {
+            int push = white ? from + 8 : from - 8;
+            targets = attacksFrom(piece, from, occupancy) & enemy;
+            if (!((occupancy >> push) & 1)) {
+                targets |= 1ULL << push;
+                int doublePush = white ? push + 8 : push - 8;
+                if ((from >> 3) == (white ? 1 : 6) && !((occupancy >> doublePush) & 1)) { targets |= 1ULL << doublePush; };
+            };
+        }
+        else {
+            targets = attacksFrom(piece, from, occupancy) & ~own;
+        };
+        while (targets) {
+            int to = BitOps::countTrailingZeroes(targets);
+            targets &= targets - 1;
+            int captured = -1;
+            for (int j = 0; j < position.count; j++) {
+                if (position.squares[j] == to) { captured = j; };
+            }
+            Move& move = moves[count];
+            move.child = position;
+            move.child.squares[i] = to;
+            move.child.whiteToMove = !white;
+            move.captured = captured;
+            move.promoting = -1;
+            move.promotion = 0;
+            u64 childOccupancy = (occupancy & ~(1ULL << from)) | (1ULL << to);
+            if (isAttacked(move.child, move.child.squares[white ? 0 : 1], !white, childOccupancy, captured)) { continue; };
+            if (pawn && (to >> 3) == (white ? 7 : 0)) {
+                for (int type : {7, 6, 4, 5}) {
+                    moves[count] = move;
+                    moves[count].promoting = i;
+                    moves[count].promotion = white ? type : swapColour(type);
+                    moves[count].child.pieces[i] = moves[count].promotion;
+                    count++;
+                }
+                continue;
+            };
+            count++;
+        }
+    }
+    return count;
+}
+
+int TablebaseGenerator::generateUnmoves(const Position& position, u64* predecessors) {
+    // Reverses quiet moves of the side that just moved; captures and promotions come from other tables.
+    int count = 0;
+    bool mover = !position.whiteToMove;
+    u64 occupancy = 0;
+    for (int i = 0; i < position.count; i++) { occupancy |= 1ULL << position.squares[i]; }
+    for (int i = 0; i < position.count; i++) {
+        int piece = position.pieces[i];
+        if (isWhitePiece(piece) != mover) { continue; };
+        int square = position.squares[i];
+        int rank = square >> 3;
+        u64 origins = 0;
+        if (pieceType(piece) == 3) {
+            int back = mover ? square - 8 : square + 8;
+            if ((mover ? rank >= 2 : rank <= 5) && !((occupancy >> back) & 1)) {
+                origins |= 1ULL << back;
+                int doubleBack = mover ? back - 8 : back + 8;
+                if (rank == (mover ? 3 : 4) && !((occupancy >> doubleBack) & 1)) { origins |= 1ULL << doubleBack; };
+            };
+        }
+        else {
+            origins = attacksFrom(piece, square, occupancy) & ~occupancy;
+        };
+        while (origins) {
+            int origin = BitOps::countTrailingZeroes(origins);
+            origins &= origins - 1;
+            Position previous = position;
+            previous.squares[i] = origin;
+            previous.whiteToMove = mover;
+            u64 previousOccupancy = occupancy ^ (1ULL << square) ^ (1ULL << origin);
+            if (isAttacked(previous, previous.squares[mover ? 1 : 0], mover, previousOccupancy, -1)) { continue; };
+            predecessors[count++] = fullIndex(previous);
+        }
+    }
+    return count;
+}
+
+void TablebaseGenerator::solve(TablebaseMaterial& material, std::vector<unsigned char>& reduced, Stats& stats) {
+    // Solved over every placement so that move and unmove counts match exactly; symmetry is
+    // only applied when the result is folded into the stored table.
+    Position position;
+    position.count = (int)material.pieces.size();
+    std::copy(material.pieces.begin(), material.pieces.end(), position.pieces);
+    u64 total = 2ULL << (6 * position.count);
+    std::vector<unsigned char> value(total, 0);
+    std::vector<unsigned char> remaining(total, 0); // In-table moves not yet known to lose.
+    std::vector<unsigned char> exitLoss(total, 0); // Longest loss through an exit, 255 if an exit holds.
+    std::vector<std::vector<uint32_t>> winSeeds(256), lossSeeds(256);
+    std::vector<uint32_t> lost, won;
+    Move moves[256];
+    u64 predecessors[256];
+
+    for (u64 index = 0; index < total; index++) {
+        decodeFull(index, position);
+        if (!isValid(position)) {
+            value[index] = TABLEBASE_INVALID;
+            continue;
+        };
+        int moveCount = generateMoves(position, moves);
+        if (moveCount == 0) {
+            u64 occupancy = 0;
+            for (int i = 0; i < position.count; i++) { occupancy |= 1ULL << position.squares[i]; }
+            bool white = position.whiteToMove;
+            if (isAttacked(position, position.squares[white ? 0 : 1], !white, occupancy, -1)) {
+                value[index] = 1;
+                lost.push_back((uint32_t)index);
+            }
+            else {
+                exitLoss[index] = 255;
+            };
+            continue;
+        };
+        int inTable = 0, bestWin = 0, worstLoss = 0;
+        bool holds = false;
+        for (int m = 0; m < moveCount; m++) {
+            if (moves[m].captured < 0 && !moves[m].promotion) {
+                inTable++;
+                continue;
+            };
+            int child = probeExit(moves[m]);
+            if (child == 0) { holds = true; }
+            else if (TablebaseValue::isLoss(child)) {
+                int plies = TablebaseValue::plies(child) + 1;
+                bestWin = bestWin ? std::min(bestWin, plies) : plies;
+            }
+            else { worstLoss = std::max(worstLoss, TablebaseValue::plies(child) + 1); };
+        }
+        remaining[index] = (unsigned char)inTable;
+        exitLoss[index] = (bestWin || holds) ? 255 : (unsigned char)worstLoss;
+        if (bestWin) { winSeeds[bestWin].push_back((uint32_t)index); }
+        else if (!holds && inTable == 0) { lossSeeds[worstLoss].push_back((uint32_t)index); };
+    }
+
+    // Breadth-first by distance: wins at odd plies from losses one ply earlier, losses at even
+    // plies once every move is known to lose.
+    for (int ply = 1; ply < TABLEBASE_INVALID - 1; ply++) {
+        std::vector<uint32_t> next;
+        if (ply & 1) {
+            for (uint32_t index : lost) {
+                decodeFull(index, position);
+                int count = generateUnmoves(position, predecessors);
+                for (int p = 0; p < count; p++) {
+                    if (value[predecessors[p]] != 0) { continue; };
+                    value[predecessors[p]] = (unsigned char)(ply + 1);
+                    next.push_back((uint32_t)predecessors[p]);
+                }
+            }
+            for (uint32_t index : winSeeds[ply]) {
+                if (value[index] != 0) { continue; };
+                value[index] = (unsigned char)(ply + 1);
+                next.push_back(index);
+            }
+            if (!next.empty()) { stats.longestMate = ply; };
+            won = std::move(next);
+        }
+        else {
+            for (uint32_t index : won) {
+                decodeFull(index, position);
+                int count = generateUnmoves(position, predecessors);
+                for (int p = 0; p < count; p++) {
+                    u64 previous = predecessors[p];
+                    if (value[previous] != 0 || exitLoss[previous] == 255 || --remaining[previous] != 0) { continue; };
+                    int distance = std::max(ply, (int)exitLoss[previous]);
+                    if (distance > ply) {
+                        lossSeeds[distance].push_back((uint32_t)previous);
+                        continue;
+                    };
+                    value[previous] = (unsigned char)(ply + 1);
+                    next.push_back((uint32_t)previous);
+                }
+            }
+            for (uint32_t index : lossSeeds[ply]) {
+                if (value[index] != 0) { continue; };
+                value[index] = (unsigned char)(ply + 1);
+                next.push_back(index);
+            }
+            if (!next.empty()) { stats.longestMate = ply; };
+            lost = std::move(next);
+        };
+    }
+
+    reduced.assign(material.entryCount(), 0);
+    for (u64 index = 0; index < reduced.size(); index++) {
+        bool whiteToMove;
+        material.decode(index, position.squares, whiteToMove);
+        position.whiteToMove = whiteToMove;
+        unsigned char result = value[fullIndex(position)];
+        if (result == TABLEBASE_INVALID) { continue; };
+        reduced[index] = result;
+        if (TablebaseValue::isWin(result)) { stats.wins++; }
+        else if (TablebaseValue::isLoss(result)) { stats.losses++; }
+        else { stats.draws++; };
+    }
+}
+
+static void writeU32(std::ofstream& output, uint value) {
+    unsigned char bytes[4] = {(unsigned char)value, (unsigned char)(value >> 8), (unsigned char)(value >> 16), (unsigned char)(value >> 24)};
+    output.write((const char*)bytes, 4);
+}
+
+static void writeHeader(std::ofstream& output, const char* magic, u64 entries) {
+    output.write(magic, 8);
+    writeU32(output, (uint)entries);
+    writeU32(output, (uint)(entries >> 32));
+}
+
+bool TablebaseGenerator::writeTable(const std::string& directory, TablebaseMaterial& material, const std::vector<unsigned char>& values) {
+    std::string base = (std::filesystem::path(directory) / material.name).string();
+    // WDL: two bits per entry, read in place by the search.
+    std::ofstream wdl(base + ".wdl", std::ios::binary);
+    writeHeader(wdl, TABLEBASE_WDL_MAGIC, values.size());
+    std::vector<unsigned char> packed((values.size() + 3) / 4, 0);
+    for (size_t i = 0; i < values.size(); i++) {
+        TablebaseResult result = TablebaseValue::isWin(values[i]) ? TB_WIN : (TablebaseValue::isLoss(values[i]) ? TB_LOSS : TB_DRAW);
+        packed[i / 4] |= (unsigned char)(result << (2 * (i % 4)));
+    }
+    wdl.write((const char*)packed.data(), packed.size());
+
+    // DTM: run-length coded blocks behind an offset table, so one probe decodes one block at most.
+    std::vector<unsigned char> data;
+    std::vector<uint> offsets;
+    for (size_t start = 0; start < values.size(); start += TABLEBASE_BLOCK_SIZE) {
+        offsets.push_back((uint)data.size());
+        size_t end = std::min(values.size(), start + TABLEBASE_BLOCK_SIZE);
+        for (size_t i = start; i < end;) {
+            size_t run = 1;
+            while (i + run < end && run < 255 && values[i + run] == values[i]) { run++; }
+            data.push_back((unsigned char)run);
+            data.push_back(values[i]);
+            i += run;
+        }
+    }
+    offsets.push_back((uint)data.size());
+    std::ofstream dtm(base + ".dtm", std::ios::binary);
+    writeHeader(dtm, TABLEBASE_DTM_MAGIC, values.size());
+    writeU32(dtm, (uint)offsets.size() - 1);
+    for (uint offset : offsets) { writeU32(dtm, offset); }
+    dtm.write((const char*)data.data(), data.size());
+    return wdl.good() && dtm.good();
+}
+
+bool TablebaseGenerator::readTable(const std::string& directory, TablebaseMaterial& material, std::vector<unsigned char>& values) {
+    MappedFile file;
+    if (!file.open((std::filesystem::path(directory) / (material.name + ".dtm")).string())) { return false; };
+    if (file.size() < TABLEBASE_HEADER_SIZE + 4 || std::memcmp(file.bytes(), TABLEBASE_DTM_MAGIC, 8) != 0) { return false; };
+    u64 entries = 0;
+    for (int i = 15; i >= 8; i--) { entries = (entries << 8) | file.bytes()[i]; }
+    if (entries != material.entryCount()) { return false; };
+    uint blockCount;
+    std::memcpy(&blockCount, file.bytes() + TABLEBASE_HEADER_SIZE, 4);
+    size_t dataStart = TABLEBASE_HEADER_SIZE + 4 + 4 * ((size_t)blockCount + 1);
+    values.clear();
+    values.reserve(entries);
+    for (size_t at = dataStart; at + 1 < file.size(); at += 2) { values.insert(values.end(), file.bytes()[at], file.bytes()[at + 1]); }
+    return values.size() == entries;
+}
@@ -0,0 +1,133 @@
+#include "../inc/ThreadPool.h"
+
+ThreadPool::ThreadPool(unsigned int threadCount, size_t maxQueued) : maxQueued(maxQueued) {
+    if (threadCount == 0) { threadCount = defaultThreadCount(); };
+    for (unsigned int i = 0; i < threadCount; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (std::thread& worker : workers) { worker.join(); }
+}
+
+unsigned int ThreadPool::defaultThreadCount() {
+    unsigned int count = std::thread::hardware_concurrency();
+    return count > 0 ? count : 1;
+}
+
+void ThreadPool::submit(std::function<void(unsigned int)> task) {
+    std::unique_lock<std::mutex> lock(mutex);
+    spaceAvailable.wait(lock, [this] { return maxQueued == 0 || tasks.size() < maxQueued; });
+    tasks.push(std::move(task));
+    lock.unlock();
+    taskAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return tasks.empty() && running == 0; });
+}
+
+void ThreadPool::workerLoop(unsigned int index) {
+    while (true) {
+        std::function<void(unsigned int)> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskAvailable.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) { return; };
+            task = std::move(tasks.front());
+            tasks.pop();
+            running++;
+        }
+        spaceAvailable.notify_one();
+        task(index);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            running--;
+        }
+        finished.notify_all();
+    }
+}
+
+// The pool and worker index of the calling thread, so tasks can submit onto their own deque.
+static thread_local WorkStealingPool* currentPool = nullptr;
+static thread_local unsigned int currentWorker = 0;
+
+WorkStealingPool::WorkStealingPool(unsigned int threadCount) {
+    if (threadCount == 0) { threadCount = ThreadPool::defaultThreadCount(); };
+    for (unsigned int i = 0; i < threadCount; i++) { queues.emplace_back(new Queue()); }
+    for (unsigned int i = 0; i < threadCount; i++) {
+        workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (std::thread& worker : workers) { worker.join(); }
+}
+
+void WorkStealingPool::submit(std::function<void(unsigned int)> task) {
+    unsigned int index = currentPool == this ? currentWorker : nextQueue++ % (unsigned int)queues.size();
+    pending++;
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+        queued++;
+    }
+    // Taking the lock orders this against a worker checking queued before it sleeps.
+    { std::lock_guard<std::mutex> lock(mutex); }
+    taskAvailable.notify_one();
+}
+
+void WorkStealingPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [this] { return pending == 0; });
+}
+
+bool WorkStealingPool::takeTask(unsigned int index, std::function<void(unsigned int)>& task) {
+    for (unsigned int offset = 0; offset < queues.size(); offset++) {
+        Queue& queue = *queues[(index + offset) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) { continue; };
+        if (offset == 0) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+        else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        };
+        queued--;
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::workerLoop(unsigned int index) {
+    currentPool = this;
+    currentWorker = index;
+    while (true) {
+        std::function<void(unsigned int)> task;
+        if (!takeTask(index, task)) {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskAvailable.wait(lock, [this] { return stopping || queued > 0; });
+            if (stopping && queued == 0) { return; };
+            continue;
+        };
+        task(index);
+        if (--pending == 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished.notify_all();
+        };
+    }
+}
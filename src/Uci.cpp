@@ -0,0 +1,321 @@
+#include "../inc/Uci.h"
+#include <cctype>
+#include <charconv>
+#include <iomanip>
+
+#define UCI_ENGINE_NAME "myChess2"
+#define UCI_DEFAULT_HASH_MB 64
+#define UCI_DEFAULT_EVAL_HASH_MB 1
+#define UCI_MOVES_TO_GO 30 // Assumed moves left when the GUI does not say.
+#define UCI_MOVE_OVERHEAD 50 // Milliseconds kept back for communication lag.
+
+static bool parseInteger(const std::string& text, int& value) {
+    // The whole value must be a number: "abc" and "12abc" are both rejected.
+    const char* end = text.data() + text.size();
+    while (end > text.data() && std::isspace((unsigned char)end[-1])) { end--; }
+    std::from_chars_result parsed = std::from_chars(text.data(), end, value);
+    return parsed.ec == std::errc() && parsed.ptr == end && end > text.data();
+}
+
+Uci::Uci() {
+    board = new Board();
+    engine = new Eval(board);
+    engine->resizeTranspositionCache(UCI_DEFAULT_HASH_MB);
+    engine->resizeEvalCache(UCI_DEFAULT_EVAL_HASH_MB);
+    engine->onIteration = [this](const SearchResult& result) { reportIteration(result); };
+    mateSolver = new MateSolver(engine);
+}
+
+Uci::~Uci() {
+    engine->stopSearch();
+    waitForSearch();
+    delete mateSolver;
+    delete engine;
+    delete board;
+}
+
+void Uci::loop(std::istream& input) {
+    std::string line;
+    while (std::getline(input, line)) {
+        std::istringstream stream(line);
+        std::string command;
+        stream >> command;
+        if (command == "uci") {
+            send("id name " UCI_ENGINE_NAME);
+            send("option name Hash type spin default " + std::to_string(UCI_DEFAULT_HASH_MB) + " min 1 max 65536");
+            send("option name MateHash type spin default " + std::to_string(MATE_SOLVER_DEFAULT_HASH_MB) + " min 1 max 4096");
+            send("option name EvalHash type spin default " + std::to_string(UCI_DEFAULT_EVAL_HASH_MB) + " min 0 max 1024");
+            send("option name MultiPV type spin default 1 min 1 max 256");
+            send("option name Ponder type check default false");
+            send("option name NullMove type check default true");
+            send("option name LateMoveReductions type check default true");
+            send("option name FutilityPruning type check default true");
+            send("option name OwnBook type check default false");
+            send("option name BookFile type string default <empty>");
+            send("option name BookKeys type string default <empty>");
+            send("option name TablebasePath type string default <empty>");
+            send("uciok");
+        }
+        else if (command == "isready") {
+            send("readyok");
+        }
+        else if (command == "setoption") {
+            handleSetOption(stream);
+        }
+        else if (command == "ucinewgame") {
+            waitForSearch();
+            engine->clearTranspositionCache();
+            engine->clearEvalCache();
+            mateSolver->clear();
+            engine->clearSearchHeuristics();
+        }
+        else if (command == "position") {
+            waitForSearch();
+            handlePosition(stream);
+        }
+        else if (command == "go") {
+            waitForSearch();
+            handleGo(stream);
+        }
+        else if (command == "stop") {
+            releaseBestMove(true);
+            engine->stopSearch();
+        }
+        else if (command == "ponderhit") {
+            releaseBestMove(false);
+        }
+        else if (command == "quit") {
+            break;
+        };
+    }
+    releaseBestMove(true);
+    engine->stopSearch();
+    waitForSearch();
+}
+
+void Uci::handlePosition(std::istringstream& stream) {
+    std::string token, fen;
+    stream >> token;
+    if (token == "startpos") {
+        fen = STARTING_FEN;
+        stream >> token;
+    }
+    else if (token == "fen") {
+        while (stream >> token && token != "moves") { fen += (fen.empty() ? "" : " ") + token; }
+    }
+    else {
+        return;
+    };
+    try {
+        board->loadFEN(fen);
+    }
+    catch (const std::invalid_argument& error) {
+        send(std::string("info string ") + error.what());
+        return;
+    }
+    engine->resetGameHistory();
+    // Game moves stay made, so the history stacks describe the game leading to this position.
+    while (stream >> token) {
+        MoveData* move = engine->findLegalMove(Eval::stringToMove(token));
+        if (!move) {
+            send("info string illegal move " + token);
+            return;
+        };
+        engine->doMove(move);
+        delete move;
+    }
+}
+
+void Uci::handleGo(std::istringstream& stream) {
+    SearchLimits limits;
+    bool infinite = false;
+    bool ponder = false;
+    u64 timeLeft[2] = {0, 0};
+    u64 increment[2] = {0, 0};
+    u64 movesToGo = 0;
+    uint mateMoves = 0;
+    std::string token;
+    while (stream >> token) {
+        if (token == "infinite") { infinite = true; }
+        else if (token == "ponder") { ponder = true; }
+        else if (token == "depth") { stream >> limits.depth; }
+        else if (token == "nodes") { stream >> limits.nodes; }
+        else if (token == "movetime") { stream >> limits.moveTime; }
+        else if (token == "mate") { stream >> mateMoves; }
+        else if (token == "wtime") { stream >> timeLeft[1]; }
+        else if (token == "btime") { stream >> timeLeft[0]; }
+        else if (token == "winc") { stream >> increment[1]; }
+        else if (token == "binc") { stream >> increment[0]; }
+        else if (token == "movestogo") { stream >> movesToGo; };
+    }
+    bool turn = board->currentTurn;
+    if (!limits.moveTime && timeLeft[turn]) {
+        // Spread the remaining time over the moves still to play, plus most of the increment.
+        u64 budget = timeLeft[turn] / (movesToGo ? movesToGo : UCI_MOVES_TO_GO) + increment[turn] * 3 / 4;
+        u64 safeLimit = timeLeft[turn] > UCI_MOVE_OVERHEAD ? timeLeft[turn] - UCI_MOVE_OVERHEAD : 1;
+        limits.moveTime = std::max<u64>(1, std::min(budget, safeLimit));
+    };
+    if (!limits.depth && !limits.nodes && !limits.moveTime && !mateMoves) { infinite = true; };
+
+    // Book moves are answered straight away without starting a search.
+    if (ownBook && !infinite && !ponder) {
+        MoveData* move = engine->findLegalMove(book.pickMove(board));
+        if (move) {
+            send("info string book move");
+            send("bestmove " + Eval::moveToString(move->encode()));
+            delete move;
+            return;
+        };
+    };
+
+    limits.multiPV = multiPV;
+    engine->stopRequested = false;
+    engine->pondering = ponder;
+    // Set before the thread starts, so a ponderhit that beats SearchTask::start still sees it.
+    engine->searchMoveTime = limits.moveTime;
+    holdBestMove = infinite;
+    searchThread = std::thread(&Uci::runSearch, this, limits, mateMoves);
+}
+
+void Uci::handleSetOption(std::istringstream& stream) {
+    std::string token, name, value;
+    stream >> token;
+    while (stream >> token && token != "value") { name += (name.empty() ? "" : " ") + token; }
+    std::getline(stream >> std::ws, value);
+    bool enabled = value == "true";
+    int number = 0;
+    bool numeric = name == "Hash" || name == "MateHash" || name == "EvalHash" || name == "MultiPV";
+    if (numeric && !parseInteger(value, number)) {
+        // A bad value keeps the old setting rather than ending the engine.
+        send("info string invalid value " + value + " for " + name);
+        return;
+    };
+    if (name == "Hash") {
+        waitForSearch();
+        engine->resizeTranspositionCache((uint)std::max(1, number));
+    }
+    else if (name == "MateHash") {
+        waitForSearch();
+        mateSolver->resize((uint)std::max(1, number));
+    }
+    else if (name == "EvalHash") {
+        waitForSearch();
+        engine->resizeEvalCache((uint)std::max(0, number));
+    }
+    else if (name == "MultiPV") { multiPV = (uint)std::max(1, number); }
+    else if (name == "Ponder") { ponderEnabled = enabled; }
+    else if (name == "NullMove") { engine->searchOptions.nullMovePruning = enabled; }
+    else if (name == "LateMoveReductions") { engine->searchOptions.lateMoveReductions = enabled; }
+    else if (name == "FutilityPruning") { engine->searchOptions.futilityPruning = enabled; }
+    else if (name == "OwnBook") { ownBook = enabled; }
+    else if (name == "BookFile") {
+        if (!book.open(value)) { send("info string cannot open book " + value); };
+    }
+    else if (name == "BookKeys") {
+        if (!book.loadKeys(value)) { send("info string " + value + " does not hold the Polyglot random table"); };
+    }
+    else if (name == "TablebasePath") {
+        waitForSearch();
+        uint count = tablebases.load(value);
+        engine->tablebases = count ? &tablebases : nullptr;
+        send("info string loaded " + std::to_string(count) + " tablebases");
+    };
+}
+
+void Uci::runSearch(SearchLimits limits, uint mateMoves) {
+    SearchResult result;
+    if (mateMoves) {
+        // go mate runs the proof-number solver first, and the normal search only if it finds nothing.
+        // The solver's line may be longer than the shortest mate, so a proof beyond the requested
+        // length counts as none: the full-width search below can still find the shorter mate.
+        MateResult mate = mateSolver->solve(limits.nodes, limits.moveTime);
+        uint maxPlies = 2 * mateMoves - 1;
+        if (mate.proven && mate.plies > maxPlies) {
+            send("info string mate search found mate in " + std::to_string((mate.plies + 1) / 2) + ", longer than asked");
+        }
+        else if (mate.proven) {
+            std::string line = "info depth " + std::to_string(mate.plies) + " score mate " + std::to_string((mate.plies + 1) / 2)
+                + " nodes " + std::to_string(mate.nodes) + " time " + std::to_string(mate.time) + " pv";
+            for (u16 move : mate.pv) { line += " " + Eval::moveToString(move); }
+            send(line);
+            result.bestMove = mate.move;
+        }
+        else {
+            send(mate.disproven ? "info string no mate by checks" : "info string mate search stopped");
+        };
+    };
+    if (result.bestMove == NULL_MOVE) {
+        if (mateMoves && !limits.depth && !limits.nodes && !limits.moveTime) { limits.depth = 2 * mateMoves - 1; };
+        result = engine->search(limits);
+    };
+    // While pondering or in infinite mode the GUI expects bestmove only after ponderhit or stop.
+    {
+        std::unique_lock<std::mutex> lock(holdMutex);
+        bestMoveReleased.wait(lock, [this] { return !engine->pondering && !holdBestMove; });
+    }
+    if (engine->evalCacheProbes) {
+        std::ostringstream rate;
+        rate << std::fixed << std::setprecision(1) << engine->evalCacheHitRate() * 100;
+        send("info string eval cache hit rate " + rate.str() + "%");
+    };
+    std::string line = "bestmove " + Eval::moveToString(result.bestMove);
+    if (ponderEnabled && result.bestMove != NULL_MOVE) {
+        MoveData* move = engine->findLegalMove(result.bestMove);
+        if (move) {
+            engine->doMove(move);
+            std::vector<u16> reply = engine->findPrincipalVariation(1);
+            engine->undoMove(move);
+            delete move;
+            if (!reply.empty()) { line += " ponder " + Eval::moveToString(reply[0]); };
+        };
+    };
+    send(line);
+}
+
+void Uci::reportIteration(const SearchResult& result) {
+    for (size_t i = 0; i < result.lines.size(); i++) {
+        const SearchLine& searched = result.lines[i];
+        std::string line = "info depth " + std::to_string(searched.depth)
+            + (result.lines.size() > 1 ? " multipv " + std::to_string(i + 1) : "") + " score " + formatScore(searched.score)
+            + " nodes " + std::to_string(result.nodes) + " time " + std::to_string(result.time)
+            + " nps " + std::to_string(result.nodes * 1000 / (result.time ? result.time : 1)) + " pv";
+        std::vector<u16> pv = engine->findPrincipalVariation(searched.depth, searched.move);
+        if (pv.empty()) { pv.assign(1, searched.move); };
+        for (u16 move : pv) { line += " " + Eval::moveToString(move); }
+        send(line);
+    }
+#if MYCHESS_STATS
+    send("info string stats " + engine->stats.toJson());
+#endif
+}
+
+std::string Uci::formatScore(Score score) {
+    // UCI scores are from the engine's point of view, with mates given in moves.
+    int sideScore = board->currentTurn ? score : -score;
+    if (Scores::isMate(sideScore)) { return "mate " + std::to_string(Scores::mateInMoves(sideScore)); };
+    return "cp " + std::to_string(sideScore);
+}
+
+void Uci::releaseBestMove(bool endPonder) {
+    // stop ends pondering and infinite mode outright; ponderhit starts the clock on the search instead.
+    {
+        std::lock_guard<std::mutex> lock(holdMutex);
+        if (endPonder) {
+            holdBestMove = false;
+            engine->pondering = false;
+        }
+        else {
+            engine->ponderHit();
+        };
+    }
+    bestMoveReleased.notify_all();
+}
+
+void Uci::waitForSearch() {
+    if (searchThread.joinable()) { searchThread.join(); };
+}
+
+void Uci::send(const std::string& line) {
+    std::lock_guard<std::mutex> lock(outputMutex);
+    std::cout << line << std::endl;
+}
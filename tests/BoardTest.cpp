@@ -0,0 +1,43 @@
+#include "../inc/Board.h"
+#include <cstdio>
+
+// FEN loading regression checks; prints each failure and exits non-zero if any fail.
+static int failures = 0;
+
+static void expectLoads(const char* fen, bool valid, const char* what) {
+    Board board;
+    bool loaded = true;
+    try {
+        board.loadFEN(fen);
+    }
+    catch (const std::invalid_argument&) {
+        loaded = false;
+    }
+    if (loaded != valid) {
+        std::printf("FAILED: %s (%s)\n", what, fen);
+        failures++;
+    };
+}
+
+int main() {
+    expectLoads(STARTING_FEN, true, "start position loads");
+    expectLoads("rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq e6 0 2", true, "en passant square on the sixth rank loads");
+    expectLoads("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1", true, "en passant square on the third rank loads");
+    expectLoads("k7/8/8/8/8/8/8/K6Q b - - 0 1", true, "side to move may be in check");
+
+    expectLoads("k7/8/8/8/8/8/8/K6Q w - - 0 1", false, "side not to move in check by a queen");
+    expectLoads("k7/1P6/8/8/8/8/8/K7 w - - 0 1", false, "side not to move in check by a pawn");
+    expectLoads("k7/2N5/8/8/8/8/8/K7 w - - 0 1", false, "side not to move in check by a knight");
+    expectLoads("8/8/8/3kK3/8/8/8/8 b - - 0 1", false, "kings next to each other");
+    expectLoads("rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq e3 0 2", false, "en passant square on the wrong rank");
+    expectLoads("rnbqkbnr/pppp1ppp/8/4p3/4P3/8/PPPP1PPP/RNBQKBNR w KQkq e5 0 2", false, "en passant square on a middle rank");
+    expectLoads("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQ1BNR w KQkq - 0 1", false, "white castling without the king at home");
+    expectLoads("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBN1 w K - 0 1", false, "white short castling without the h1 rook");
+    expectLoads("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/1NBQKBNR w Q - 0 1", false, "white long castling without the a1 rook");
+    expectLoads("rnbqkbn1/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w k - 0 1", false, "black short castling without the h8 rook");
+    expectLoads("1nbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w q - 0 1", false, "black long castling without the a8 rook");
+    expectLoads("rnbqkbnr/pppppppp/8/8/4P3/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", false, "more than 32 pieces");
+
+    if (!failures) { std::printf("All board checks passed\n"); };
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,30 @@
+#include "../inc/myChess2.h"
+#include <cstdio>
+#include <cstring>
+
+// C ABI regression checks; prints each failure and exits non-zero if any fail.
+static int failures = 0;
+
+static void expect(bool condition, const char* what) {
+    if (!condition) {
+        std::printf("FAILED: %s\n", what);
+        failures++;
+    };
+}
+
+int main() {
+    mc2_packed_position packed;
+    char fen[100];
+    const char* start = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+    expect(mc2_pack_fen(start, &packed) == MC2_OK, "start position packs");
+    expect(mc2_unpack_to_fen(&packed, fen, sizeof(fen)) == MC2_OK && std::strcmp(fen, start) == 0, "start position round trips");
+
+    // 33 pieces do not fit the 16 bytes of a packed record.
+    std::memset(&packed, 0, sizeof(packed));
+    expect(mc2_pack_fen("rnbqkbnr/pppppppp/8/8/4P3/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", &packed) == MC2_ERROR_POSITION,
+           "33-piece FEN is rejected");
+    expect(packed.occupancy == 0, "rejected FEN leaves the record untouched");
+
+    if (!failures) { std::printf("All C API checks passed\n"); };
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,155 @@
+// Streams an EPD file and analyses its positions in parallel, one Board/Eval pair per worker.
+// Usage: batchAnalysis <input.epd> <output.epd> [--threads N] [--depth D] [--nodes N] [--hash MB] [--stats out.json]
+// Each output line is the input position followed by acd (depth), acn (nodes), ce (centipawns for
+// the side to move) and pm (best move in coordinate notation), plus the original operations.
+// Lines are written as soon as their analysis finishes, so they are in completion order.
+// --stats writes the search counters of all workers, merged, as JSON (needs a MYCHESS_STATS build).
+#include "../inc/Arguments.h"
+#include "../inc/Clock.h"
+#include "../inc/Eval.h"
+#include "../inc/ThreadPool.h"
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+struct EpdRecord {
+    std::string position; // The four FEN fields, plus move clocks when the line carries them.
+    std::string operations;
+};
+
+static bool parseEpdLine(const std::string& line, EpdRecord& record) {
+    std::istringstream stream(line);
+    std::string fields[4];
+    for (int i = 0; i < 4; i++) {
+        if (!(stream >> fields[i])) { return false; };
+    }
+    record.position = fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3];
+    std::string rest;
+    std::getline(stream, rest);
+    // Plain FEN lines carry the half and full move clocks instead of operations.
+    std::istringstream clocks(rest);
+    uint halfMoves, fullMoves;
+    if (clocks >> halfMoves >> fullMoves) {
+        record.position += " " + std::to_string(halfMoves) + " " + std::to_string(fullMoves);
+        rest.clear();
+        std::getline(clocks, rest);
+    };
+    size_t start = rest.find_first_not_of(" \t");
+    record.operations = start == std::string::npos ? "" : rest.substr(start);
+    return true;
+}
+
+static int scoreToCentipawns(Score score, bool whiteToMove) {
+    return whiteToMove ? score : -score;
+}
+
+static const char* USAGE = "usage: batchAnalysis <input.epd> <output.epd> [--threads N] [--depth D] [--nodes N] [--hash MB] [--stats out.json]";
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << USAGE << std::endl;
+        return 1;
+    };
+    uint threads = ThreadPool::defaultThreadCount();
+    SearchLimits limits;
+    uint hashMegabytes = 16;
+    std::string statsPath;
+    for (int i = 3; i < argc; i += 2) {
+        std::string option = argv[i];
+        bool known = option == "--stats" || option == "--threads" || option == "--depth" || option == "--nodes" || option == "--hash";
+        if (!known) {
+            std::cerr << "unknown option " << option << std::endl << USAGE << std::endl;
+            return 1;
+        };
+        if (i + 1 == argc) {
+            std::cerr << "option " << option << " needs a value" << std::endl << USAGE << std::endl;
+            return 1;
+        };
+        if (option == "--stats") {
+            statsPath = argv[i + 1];
+            continue;
+        };
+        unsigned long long value = 0;
+        if (!parseCount(argv[i + 1], value)) {
+            std::cerr << "bad value " << argv[i + 1] << " for " << option << std::endl << USAGE << std::endl;
+            return 1;
+        };
+        if (option == "--threads") { threads = (uint)value; }
+        else if (option == "--depth") { limits.depth = (uint)value; }
+        else if (option == "--nodes") { limits.nodes = value; }
+        else { hashMegabytes = (uint)value; };
+    }
+    if (limits.depth == 0 && limits.nodes == 0) { limits.depth = 6; };
+
+    std::ifstream input(argv[1]);
+    if (!input) {
+        std::cerr << "cannot open " << argv[1] << std::endl;
+        return 1;
+    };
+    std::ofstream output(argv[2]);
+    if (!output) {
+        std::cerr << "cannot open " << argv[2] << std::endl;
+        return 1;
+    };
+
+    // Engines are created once per worker so their tables stay warm across positions.
+    ThreadPool pool(threads, 4 * (size_t)threads);
+    std::vector<Board*> boards;
+    std::vector<Eval*> engines;
+    for (uint i = 0; i < pool.size(); i++) {
+        boards.push_back(new Board());
+        engines.push_back(new Eval(boards.back()));
+        engines.back()->resizeTranspositionCache(hashMegabytes);
+    }
+
+    std::vector<SearchStats> workerStats(pool.size());
+    std::mutex outputMutex;
+    std::atomic<u64> analysed(0);
+    std::atomic<u64> totalNodes(0);
+    u64 startTime = steadyClockNanoseconds();
+    std::string line;
+    u64 lineNumber = 0;
+    while (std::getline(input, line)) {
+        lineNumber++;
+        EpdRecord record;
+        if (!parseEpdLine(line, record)) { continue; };
+        pool.submit([&, record, lineNumber](uint worker) {
+            Board* board = boards[worker];
+            Eval* engine = engines[worker];
+            try {
+                board->loadFEN(record.position);
+            }
+            catch (const std::invalid_argument& error) {
+                std::lock_guard<std::mutex> lock(outputMutex);
+                std::cerr << "line " << lineNumber << ": " << error.what() << std::endl;
+                return;
+            }
+            engine->clearSearchHeuristics();
+            SearchResult result = engine->search(limits);
+            totalNodes += result.nodes;
+            workerStats[worker].merge(engine->stats);
+            std::ostringstream text;
+            text << record.position << " acd " << result.depth << "; acn " << result.nodes
+                 << "; ce " << scoreToCentipawns(result.score, board->currentTurn)
+                 << "; pm " << Eval::moveToString(result.bestMove) << ";";
+            if (!record.operations.empty()) { text << " " << record.operations; };
+            std::lock_guard<std::mutex> lock(outputMutex);
+            output << text.str() << "\n";
+            output.flush();
+            analysed++;
+        });
+    }
+    pool.wait();
+
+    double seconds = secondsSince(startTime);
+    std::cerr << "analysed " << analysed << " positions with " << pool.size() << " threads in " << seconds
+              << "s, " << (u64)(totalNodes / (seconds > 0 ? seconds : 1)) << " nodes/s" << std::endl;
+    if (!statsPath.empty()) {
+        if (!MYCHESS_STATS) { std::cerr << "built without MYCHESS_STATS, so the counters are all zero" << std::endl; };
+        SearchStats total;
+        for (const SearchStats& stats : workerStats) { total.merge(stats); }
+        std::ofstream(statsPath) << total.toJson() << "\n";
+    };
+    return 0;
+}
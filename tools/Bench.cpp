@@ -0,0 +1,332 @@
+// Microbenchmarks for the engine's hot primitives over a fixed corpus of positions, plus a
+// fixed-depth signature search whose node count identifies the search behaviour.
+// Usage: bench [--repeat R] [--rounds N] [--depth D] [--cpu C] [--filter TEXT]
+// Each benchmark runs N rounds over the corpus per repetition and reports the best and median
+// time per operation over R repetitions. Pin to one core with --cpu for stable numbers.
+#include "../inc/Arguments.h"
+#include "../inc/Clock.h"
+#include "../inc/SearchTask.h"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#endif
+
+struct BenchPosition {
+    const char* name;
+    const char* fen;
+};
+
+static const BenchPosition CORPUS[] = {
+    {"start", STARTING_FEN},
+    {"kiwipete", "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"},
+    {"rook endgame", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1"},
+    {"promotions", "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1"},
+    {"discovered checks", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8"},
+    {"middlegame", "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10"},
+    {"pinned bishop check", "rnbqkbnr/ppp2ppp/8/1B1pp3/4P3/8/PPPP1PPP/RNBQK1NR b KQkq - 1 3"},
+    {"queen endgame", "8/6k1/6p1/8/4Q3/6P1/q4PK1/8 w - - 0 50"},
+};
+static const size_t CORPUS_SIZE = sizeof(CORPUS) / sizeof(CORPUS[0]);
+
+struct BenchOptions {
+    uint repetitions = 5;
+    uint rounds = 200;
+    uint depth = 5;
+    int cpu = -1;
+    std::string filter;
+};
+
+static volatile u64 sink; // Keeps results observable so the work is not optimised away.
+
+static bool pinToCpu(int cpu) {
+#ifdef _WIN32
+    return SetThreadAffinityMask(GetCurrentThread(), 1ULL << cpu) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+// Runs body once per repetition; body returns how many operations it performed.
+template <typename Body>
+static void runBenchmark(const BenchOptions& options, const std::string& name, Body body) {
+    if (!options.filter.empty() && name.find(options.filter) == std::string::npos) { return; };
+    std::vector<double> perOperation;
+    u64 operations = 0;
+    for (uint repetition = 0; repetition < options.repetitions; repetition++) {
+        u64 start = steadyClockNanoseconds();
+        operations = body();
+        u64 elapsed = steadyClockNanoseconds() - start;
+        perOperation.push_back(operations ? (double)elapsed / operations : 0);
+    }
+    std::sort(perOperation.begin(), perOperation.end());
+    std::cout << std::left << std::setw(34) << name << std::right << std::fixed << std::setprecision(2)
+              << std::setw(12) << perOperation.front() << std::setw(14) << perOperation[perOperation.size() / 2]
+              << std::setw(12) << operations << std::endl;
+}
+
+static const char* USAGE = "usage: bench [--repeat R] [--rounds N] [--depth D] [--cpu C] [--filter TEXT]";
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    for (int i = 1; i < argc; i += 2) {
+        std::string option = argv[i];
+        if (i + 1 == argc) {
+            std::cerr << "option " << option << " needs a value" << std::endl << USAGE << std::endl;
+            return 1;
+        };
+        const char* value = argv[i + 1];
+        bool numeric = true;
+        if (option == "--repeat") { numeric = parseCount(value, options.repetitions); }
+        else if (option == "--rounds") { numeric = parseCount(value, options.rounds); }
+        else if (option == "--depth") { numeric = parseCount(value, options.depth); }
+        else if (option == "--cpu") { numeric = parseInteger(value, options.cpu); }
+        else if (option == "--filter") { options.filter = value; }
+        else {
+            std::cerr << "unknown option " << option << std::endl << USAGE << std::endl;
+            return 1;
+        };
+        if (!numeric) {
+            std::cerr << "bad value " << value << " for " << option << std::endl << USAGE << std::endl;
+            return 1;
+        };
+    }
+    options.repetitions = std::max(1u, options.repetitions);
+    options.rounds = std::max(1u, options.rounds);
+    options.depth = std::max(1u, options.depth);
+    if (options.cpu >= 0 && !pinToCpu(options.cpu)) { std::cerr << "could not pin to cpu " << options.cpu << std::endl; };
+
+    // One board per corpus position; the engine is pointed at each in turn.
+    std::vector<Board> boards(CORPUS_SIZE);
+    for (size_t i = 0; i < CORPUS_SIZE; i++) { boards[i].loadFEN(CORPUS[i].fen); }
+    Board scratch;
+    Eval engine(&scratch);
+    std::vector<u64> bitboards;
+    for (Board& board : boards) { bitboards.insert(bitboards.end(), board.pieceLocations, board.pieceLocations + 15); }
+
+    std::cout << std::left << std::setw(34) << "benchmark" << std::right << std::setw(12) << "best ns/op"
+              << std::setw(14) << "median ns/op" << std::setw(12) << "ops" << std::endl;
+
+    // BitOps
+    runBenchmark(options, "BitOps::countTrailingZeroes", [&]() {
+        u64 total = 0;
+        for (uint round = 0; round < options.rounds; round++) {
+            for (u64 bitboard : bitboards) { total += BitOps::countTrailingZeroes(bitboard); }
+        }
+        sink = total;
+        return (u64)options.rounds * bitboards.size();
+    });
+    runBenchmark(options, "BitOps::countSetBits", [&]() {
+        u64 total = 0;
+        for (uint round = 0; round < options.rounds; round++) {
+            for (u64 bitboard : bitboards) { total += BitOps::countSetBits(bitboard); }
+        }
+        sink = total;
+        return (u64)options.rounds * bitboards.size();
+    });
+    runBenchmark(options, "BitOps::knightAttacks", [&]() {
+        u64 total = 0;
+        for (uint round = 0; round < options.rounds; round++) {
+            for (u64 bitboard : bitboards) { total ^= BitOps::knightAttacks(bitboard); }
+        }
+        sink = total;
+        return (u64)options.rounds * bitboards.size();
+    });
+    runBenchmark(options, "BitOps::slidingAttacks", [&]() {
+        u64 total = 0;
+        for (uint round = 0; round < options.rounds; round++) {
+            for (Board& board : boards) {
+                total ^= BitOps::slidingAttacks(board.pieceLocations[6] | board.pieceLocations[7],
+                    board.pieceLocations[4] | board.pieceLocations[7], board.pieceLocations[0]);
+            }
+        }
+        sink = total;
+        return (u64)options.rounds * boards.size();
+    });
+
+    // Move generation. Generated moves are heap allocated, so releasing them is part of the cost.
+    auto generatorBenchmark = [&](const std::string& name, auto generate) {
+        runBenchmark(options, name, [&]() {
+            u64 total = 0;
+            u64 calls = 0;
+            for (uint round = 0; round < options.rounds; round++) {
+                for (Board& board : boards) {
+                    engine.board = &board;
+                    std::vector<MoveData*> moves;
+                    if (!generate(board, moves)) { continue; };
+                    total += moves.size();
+                    calls++;
+                    Eval::releaseMoves(moves);
+                }
+            }
+            sink = total;
+            return calls;
+        });
+    };
+    generatorBenchmark("Eval::findKingMoves", [&](Board& board, std::vector<MoveData*>& moves) {
+        moves = engine.findKingMoves(BitOps::countTrailingZeroes(board.pieceLocations[board.currentTurn ? 2 : 9]));
+        return true;
+    });
+    generatorBenchmark("Eval::findPawnMoves", [&](Board& board, std::vector<MoveData*>& moves) {
+        moves = engine.findPawnMoves(board.pieceLocations[board.currentTurn ? 3 : 10]);
+        return true;
+    });
+    generatorBenchmark("Eval::findBishopMoves", [&](Board& board, std::vector<MoveData*>& moves) {
+        moves = engine.findBishopMoves(board.pieceLocations[board.currentTurn ? 4 : 11]);
+        return true;
+    });
+    generatorBenchmark("Eval::findKnightMoves", [&](Board& board, std::vector<MoveData*>& moves) {
+        moves = engine.findKnightMoves(board.pieceLocations[board.currentTurn ? 5 : 12]);
+        return true;
+    });
+    generatorBenchmark("Eval::findRookMoves", [&](Board& board, std::vector<MoveData*>& moves) {
+        moves = engine.findRookMoves(board.pieceLocations[board.currentTurn ? 6 : 13]);
+        return true;
+    });
+    generatorBenchmark("Eval::findPseudoLegalMoves", [&](Board&, std::vector<MoveData*>& moves) {
+        moves = engine.findPseudoLegalMoves();
+        return true;
+    });
+    generatorBenchmark("Eval::findEvasionMoves", [&](Board&, std::vector<MoveData*>& moves) {
+        if (!engine.isInCheck()) { return false; };
+        moves = engine.findEvasionMoves();
+        return true;
+    });
+    generatorBenchmark("Eval::findLegalMoves", [&](Board&, std::vector<MoveData*>& moves) {
+        moves = engine.findLegalMoves(engine.isInCheck() ? engine.findEvasionMoves() : engine.findPseudoLegalMoves());
+        return true;
+    });
+
+    // Make/unmake over every legal move of every position.
+    std::vector<std::vector<MoveData*>> legalMoves(CORPUS_SIZE);
+    for (size_t i = 0; i < CORPUS_SIZE; i++) {
+        engine.board = &boards[i];
+        legalMoves[i] = engine.findLegalMoves(engine.isInCheck() ? engine.findEvasionMoves() : engine.findPseudoLegalMoves());
+    }
+    runBenchmark(options, "Eval::doMove+undoMove", [&]() {
+        u64 total = 0;
+        u64 pairs = 0;
+        for (uint round = 0; round < options.rounds; round++) {
+            for (size_t i = 0; i < CORPUS_SIZE; i++) {
+                engine.board = &boards[i];
+                for (MoveData* move : legalMoves[i]) {
+                    engine.doMove(move);
+                    total ^= boards[i].zobristHash;
+                    engine.undoMove(move);
+                }
+                pairs += legalMoves[i].size();
+            }
+        }
+        sink = total;
+        return pairs;
+    });
+    for (std::vector<MoveData*>& moves : legalMoves) { Eval::releaseMoves(moves); }
+
+    runBenchmark(options, "Board::calculateZobristHash", [&]() {
+        u64 total = 0;
+        for (uint round = 0; round < options.rounds; round++) {
+            for (Board& board : boards) { total ^= board.calculateZobristHash(); }
+        }
+        sink = total;
+        return (u64)options.rounds * boards.size();
+    });
+    // The corpus is walked repeatedly, so the cache would turn every round after the first into lookups.
+    engine.resizeEvalCache(0);
+    runBenchmark(options, "Eval::evaluatePosition", [&]() {
+        int total = 0;
+        for (uint round = 0; round < options.rounds; round++) {
+            for (Board& board : boards) {
+                engine.board = &board;
+                total += engine.evaluatePosition();
+            }
+        }
+        sink = (u64)total;
+        return (u64)options.rounds * boards.size();
+    });
+
+    // Transposition table with random keys, so most accesses miss the CPU caches as in search.
+    engine.resizeTranspositionCache(64);
+    const u64 ttOperations = (u64)options.rounds * 1000;
+    runBenchmark(options, "Eval::addTransposition", [&]() {
+        u64 key = 0x9E3779B97F4A7C15ULL;
+        for (u64 i = 0; i < ttOperations; i++) {
+            key ^= key << 13; key ^= key >> 7; key ^= key << 17;
+            Transposition tp;
+            tp.init(key, NULL_MOVE, 1, 0, EXACT);
+            engine.addTransposition(tp);
+        }
+        return ttOperations;
+    });
+    runBenchmark(options, "Eval::checkTransposition", [&]() {
+        u64 key = 0x9E3779B97F4A7C15ULL;
+        int total = 0;
+        for (u64 i = 0; i < ttOperations; i++) {
+            key ^= key << 13; key ^= key >> 7; key ^= key << 17;
+            total += engine.checkTransposition(key, 1, -SCORE_INFINITE, SCORE_INFINITE);
+        }
+        sink = (u64)total;
+        return ttOperations;
+    });
+
+    // Signature search: the node total changes exactly when search behaviour does.
+    if (options.filter.empty() || std::string("signature").find(options.filter) != std::string::npos) {
+        engine.resizeTranspositionCache(16);
+        engine.resizeEvalCache(1);
+        u64 signature = 0;
+        u64 evalProbes = 0, evalHits = 0;
+        double bestNps = 0;
+        for (uint repetition = 0; repetition < options.repetitions; repetition++) {
+            u64 nodes = 0;
+            evalProbes = evalHits = 0;
+            u64 start = steadyClockNanoseconds();
+            for (Board& board : boards) {
+                Board copy = board;
+                engine.board = &copy;
+                engine.clearTranspositionCache();
+                engine.clearEvalCache();
+                engine.clearSearchHeuristics();
+                engine.resetGameHistory();
+                SearchLimits limits;
+                limits.depth = options.depth;
+                nodes += engine.search(limits).nodes;
+                evalProbes += engine.evalCacheProbes;
+                evalHits += engine.evalCacheHits;
+            }
+            double seconds = (steadyClockNanoseconds() - start) / 1e9;
+            bestNps = std::max(bestNps, nodes / (seconds > 0 ? seconds : 1e-9));
+            if (signature && signature != nodes) { std::cerr << "warning: node count changed between repetitions" << std::endl; };
+            signature = nodes;
+        }
+        std::cout << "signature depth " << options.depth << ": " << signature << " nodes, "
+                  << (u64)bestNps << " nps (best of " << options.repetitions << "), eval cache hit rate "
+                  << (evalProbes ? 100.0 * evalHits / evalProbes : 0) << "%" << std::endl;
+
+        // The same searches sliced into small quanta and interleaved on the scheduler must give the same total.
+        std::vector<Board> sliceBoards(boards);
+        std::vector<Eval*> sliceEngines;
+        SearchScheduler scheduler(2, 64);
+        std::atomic<u64> slicedNodes(0);
+        for (Board& board : sliceBoards) {
+            sliceEngines.push_back(new Eval(&board));
+            sliceEngines.back()->resizeTranspositionCache(16);
+            SearchLimits limits;
+            limits.depth = options.depth;
+            scheduler.submit(std::make_shared<SearchTask>(sliceEngines.back(), limits), [&](const SearchResult& result) { slicedNodes += result.nodes; });
+        }
+        scheduler.wait();
+        for (Eval* sliceEngine : sliceEngines) { delete sliceEngine; }
+        std::cout << "sliced signature: " << slicedNodes << " nodes" << std::endl;
+        if (slicedNodes != signature) { std::cerr << "warning: sliced search differs from the plain search" << std::endl; };
+    };
+    engine.board = &scratch;
+    return 0;
+}
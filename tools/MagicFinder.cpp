@@ -0,0 +1,164 @@
+// Searches slider magics in parallel and writes them as a header (normally inc/Magics.h).
+// Usage: magicFinder [--output Magics.h] [--threads N] [--tries N] [--reduce N] [--seed S]
+// Every square starts from its current magic and tries for one with up to --reduce fewer index
+// bits than its relevant occupancy bits, keeping the smallest that is found. Each result is then
+// checked against every blocker set, and the header is only written when all 128 pass.
+#include "../inc/Arguments.h"
+#include "../inc/Clock.h"
+#include "../inc/Eval.h"
+#include "../inc/ThreadPool.h"
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+
+struct MagicResult {
+    u64 magic;
+    uint bits;
+};
+
+// Checks that the magic sends every blocker set to a slot holding the same attacks.
+static bool verifyMagic(Eval* engine, uint square, Eval::MagicPiece piece, u64 magic, uint bits) {
+    bool bishop = piece == Eval::BISHOP;
+    u64 mask = bishop ? engine->diagonalMasks[square] : engine->cardinalMasks[square];
+    uint relevantBits = bishop ? Eval::relevantBitsBishop[square] : Eval::relevantBitsRook[square];
+    std::vector<u64> slots((size_t)1 << bits, 0);
+    for (uint i = 0; i < (1u << relevantBits); i++) {
+        u64 occupancy = Eval::initBlockersPermutation(i, relevantBits, mask);
+        u64 attacks = bishop ? engine->initBishopAttacksForPosition(square, occupancy) : engine->initRookAttacksForPosition(square, occupancy);
+        u64& slot = slots[(size_t)((occupancy * magic) >> (64 - bits))];
+        if (slot != 0 && slot != attacks) { return false; };
+        slot = attacks;
+    }
+    return true;
+}
+
+static void writeRows(std::ofstream& output, const MagicResult* results, bool bits) {
+    for (uint square = 0; square < 64; square++) {
+        if (square % (bits ? 8 : 4) == 0) { output << "       "; };
+        if (bits) { output << " " << results[square].bits << ","; }
+        else { output << " 0x" << std::hex << std::uppercase << std::setw(16) << std::setfill('0') << results[square].magic << "ULL," << std::dec; };
+        if (square % (bits ? 8 : 4) == (bits ? 7u : 3u)) { output << "\n"; };
+    }
+}
+
+static bool writeHeader(const std::string& path, const MagicResult* bishop, const MagicResult* rook) {
+    u64 bishopSize = 0, rookSize = 0;
+    for (uint square = 0; square < 64; square++) {
+        bishopSize += 1ULL << bishop[square].bits;
+        rookSize += 1ULL << rook[square].bits;
+    }
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream output(temporary);
+        if (!output) { return false; };
+        output << "#pragma once\n\n";
+        output << "// Magic multipliers for the slider attack tables. This file is written by the magicFinder tool,\n";
+        output << "// which verifies every entry exhaustively. Index bits may be below the relevant occupancy bits\n";
+        output << "// where a magic for a smaller table was found.\n";
+        output << "#define MAGIC_BISHOP_TABLE_SIZE " << bishopSize << "\n";
+        output << "#define MAGIC_ROOK_TABLE_SIZE " << rookSize << "\n\n";
+        output << "struct Magics {\n";
+        output << "    static constexpr unsigned long long bishop[64] = {\n";
+        writeRows(output, bishop, false);
+        output << "    };\n    static constexpr unsigned int bishopBits[64] = {\n";
+        writeRows(output, bishop, true);
+        output << "    };\n    static constexpr unsigned long long rook[64] = {\n";
+        writeRows(output, rook, false);
+        output << "    };\n    static constexpr unsigned int rookBits[64] = {\n";
+        writeRows(output, rook, true);
+        output << "    };\n};\n";
+        if (!output) { return false; };
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+static const char* USAGE = "usage: magicFinder [--output Magics.h] [--threads N] [--tries N] [--reduce N] [--seed S]";
+
+int main(int argc, char** argv) {
+    std::string outputPath = "Magics.h";
+    uint threads = ThreadPool::defaultThreadCount();
+    u64 tries = 10000000;
+    uint reduce = 1;
+    u64 seed = 1;
+    for (int i = 1; i < argc; i += 2) {
+        std::string option = argv[i];
+        if (i + 1 == argc) {
+            std::cerr << "option " << option << " needs a value" << std::endl << USAGE << std::endl;
+            return 1;
+        };
+        const char* value = argv[i + 1];
+        bool numeric = true;
+        if (option == "--output") { outputPath = value; }
+        else if (option == "--threads") { numeric = parseCount(value, threads); }
+        else if (option == "--tries") { numeric = parseCount(value, tries); }
+        else if (option == "--reduce") { numeric = parseCount(value, reduce); }
+        else if (option == "--seed") { numeric = parseCount(value, seed); }
+        else {
+            std::cerr << "unknown option " << option << std::endl << USAGE << std::endl;
+            return 1;
+        };
+        if (!numeric) {
+            std::cerr << "bad value " << value << " for " << option << std::endl << USAGE << std::endl;
+            return 1;
+        };
+    }
+
+    // The searches only read the masks and attack generators, so one engine serves every thread.
+    Board* board = new Board();
+    Eval* engine = new Eval(board);
+    MagicResult bishop[64], rook[64];
+    for (uint square = 0; square < 64; square++) {
+        bishop[square] = {Magics::bishop[square], Magics::bishopBits[square]};
+        rook[square] = {Magics::rook[square], Magics::rookBits[square]};
+    }
+
+    std::mutex outputMutex;
+    u64 startTime = steadyClockNanoseconds();
+    ThreadPool pool(threads);
+    for (uint job = 0; job < 128; job++) {
+        pool.submit([&, job](uint) {
+            uint square = job % 64;
+            Eval::MagicPiece piece = job < 64 ? Eval::ROOK : Eval::BISHOP;
+            MagicResult& result = piece == Eval::BISHOP ? bishop[square] : rook[square];
+            uint relevantBits = piece == Eval::BISHOP ? Eval::relevantBitsBishop[square] : Eval::relevantBitsRook[square];
+            std::mt19937_64 generator(seed * 0x9E3779B97F4A7C15ULL + job);
+            // A stored magic may have been invalidated by an edited mask, so it has to earn its place.
+            if (!verifyMagic(engine, square, piece, result.magic, result.bits)) { result = {0, 0}; };
+            uint floor = relevantBits > reduce ? relevantBits - reduce : 1;
+            for (uint bits = result.bits ? result.bits - 1 : relevantBits; bits >= floor; bits--) {
+                u64 magic = engine->initMagicAttacks(square, piece, bits, generator, tries);
+                if (!magic) { break; };
+                result = {magic, bits};
+            }
+            std::lock_guard<std::mutex> lock(outputMutex);
+            std::cerr << (piece == Eval::BISHOP ? "bishop " : "rook ") << square << ": "
+                      << (result.bits ? std::to_string(result.bits) + " bits" : "no magic found")
+                      << " (relevant " << relevantBits << ")" << std::endl;
+        });
+    }
+    pool.wait();
+
+    uint failures = 0, reduced = 0;
+    for (uint square = 0; square < 64; square++) {
+        failures += !bishop[square].bits || !verifyMagic(engine, square, Eval::BISHOP, bishop[square].magic, bishop[square].bits);
+        failures += !rook[square].bits || !verifyMagic(engine, square, Eval::ROOK, rook[square].magic, rook[square].bits);
+        reduced += (bishop[square].bits < Eval::relevantBitsBishop[square]) + (rook[square].bits < Eval::relevantBitsRook[square]);
+    }
+    double seconds = secondsSince(startTime);
+    if (failures) {
+        std::cerr << failures << " magics failed verification, " << outputPath << " not written" << std::endl;
+        return 1;
+    };
+    if (!writeHeader(outputPath, bishop, rook)) {
+        std::cerr << "cannot write " << outputPath << std::endl;
+        return 1;
+    };
+    u64 entries = 0;
+    for (uint square = 0; square < 64; square++) { entries += (1ULL << bishop[square].bits) + (1ULL << rook[square].bits); }
+    std::cerr << "all 128 magics verified, " << reduced << " with reduced index bits, tables " << entries * 8 / 1024
+              << " KB, in " << seconds << "s; written to " << outputPath << std::endl;
+    delete engine;
+    delete board;
+    return 0;
+}
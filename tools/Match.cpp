@@ -0,0 +1,446 @@
+// Plays two UCI engines against each other to tell whether a change gains or loses strength.
+// Usage: match --engine <command> [--option Name=value ...] --engine <command> [--option ...]
+//              [--openings file.epd|file.pgn] [--games N] [--concurrency N]
+//              [--tc base+inc | --movetime ms | --nodes N | --depth D] [--margin ms]
+//              [--sprt elo0 elo1] [--alpha A] [--beta B] [--resign cp moves]
+//              [--draw cp moves fromMove] [--max-plies N]
+// The engines may be two builds or one build with different options; each --option applies to
+// the --engine before it. Every opening is played twice with colours swapped, so a lucky
+// opening cancels out, and the pairs feed a pentanomial sequential probability ratio test of
+// elo0 against elo1 (logistic Elo) that stops the match as soon as either is accepted. Games end
+// on mate, stalemate, the fifty-move rule, threefold repetition, bare minors, the ply cap, loss
+// on time, an illegal move, a crashed engine, or score adjudication. The time control is in
+// seconds and is the default, at 10+0.1.
+#include "../inc/Arguments.h"
+#include "../inc/Clock.h"
+#include "../inc/EngineProcess.h"
+#include "../inc/Eval.h"
+#include "../inc/Pgn.h"
+#include "../inc/ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+#define MATCH_STARTUP_TIMEOUT 10000 // Milliseconds an engine has to answer uci and isready.
+#define MATCH_MATE_SCORE 30000 // Engine mate scores, in centipawns, for adjudication.
+
+struct EngineSpec {
+    std::string command;
+    std::vector<std::pair<std::string, std::string>> options;
+};
+
+struct MatchSettings {
+    EngineSpec engines[2];
+    std::vector<std::string> openings;
+    uint games = 1000;
+    uint concurrency = ThreadPool::defaultThreadCount();
+    double baseTime = 10000; // Milliseconds, with the increment, when no other limit is given.
+    double increment = 100;
+    u64 moveTime = 0;
+    u64 nodes = 0;
+    uint depth = 0;
+    u64 margin = 100; // Milliseconds an engine may overrun its clock before it loses on time.
+    bool sprt = false;
+    double elo0 = 0, elo1 = 5, alpha = 0.05, beta = 0.05;
+    int resignScore = 0; // Zero turns resign adjudication off.
+    uint resignMoves = 3;
+    int drawScore = -1; // Negative turns draw adjudication off.
+    uint drawMoves = 8;
+    uint drawFromMove = 40;
+    uint maxPlies = 400;
+};
+
+struct GameOutcome {
+    uint result = RESULT_DRAW;
+    std::string reason;
+};
+
+// One engine process as a player: started lazily and restarted after a crash or hang.
+struct Player {
+    EngineSpec spec;
+    EngineProcess process;
+    bool ready = false;
+
+    bool prepare() {
+        if (!ready || !process.isRunning()) {
+            ready = process.start(spec.command) && process.send("uci") && process.waitFor("uciok", MATCH_STARTUP_TIMEOUT);
+            for (const std::pair<std::string, std::string>& option : spec.options) {
+                ready = ready && process.send("setoption name " + option.first + " value " + option.second);
+            }
+            if (!ready) { return false; };
+        };
+        ready = process.send("ucinewgame") && process.send("isready") && process.waitFor("readyok", MATCH_STARTUP_TIMEOUT);
+        return ready;
+    };
+};
+
+static bool insufficientMaterial(Board* board) {
+    // Bare kings, or a lone bishop or knight, cannot mate.
+    u64 kings = board->pieceLocations[2] | board->pieceLocations[9];
+    u64 minors = board->pieceLocations[4] | board->pieceLocations[5] | board->pieceLocations[11] | board->pieceLocations[12];
+    u64 others = board->pieceLocations[0] & ~kings;
+    return others == 0 || (others == minors && BitOps::countSetBits(minors) == 1);
+}
+
+static GameOutcome playGame(Player* white, Player* black, Eval* referee, const std::string& opening, const MatchSettings& settings) {
+    GameOutcome outcome;
+    Player* players[2] = {black, white}; // Indexed by Board::currentTurn.
+    for (Player* player : players) {
+        if (!player->prepare()) {
+            outcome.result = player == white ? RESULT_BLACK_WIN : RESULT_WHITE_WIN;
+            outcome.reason = "engine failed to start";
+            return outcome;
+        };
+    }
+    Board* board = referee->board;
+    board->loadFEN(opening);
+    referee->resetGameHistory();
+    bool timed = !settings.moveTime && !settings.nodes && !settings.depth;
+    double clocks[2] = {settings.baseTime, settings.baseTime};
+    int lastScores[2] = {0, 0};
+    uint resignCounts[2] = {0, 0};
+    uint drawCount = 0;
+    std::string moves;
+    uint startMove = board->turnsTaken / 2 + 1;
+    for (uint ply = 0; ; ply++) {
+        std::vector<MoveData*> legal = referee->findLegalMoves(referee->isInCheck() ? referee->findEvasionMoves() : referee->findPseudoLegalMoves());
+        bool noMoves = legal.empty();
+        Eval::releaseMoves(legal);
+        bool side = board->currentTurn;
+        if (noMoves) {
+            bool mated = referee->isInCheck();
+            outcome.result = mated ? (side ? RESULT_BLACK_WIN : RESULT_WHITE_WIN) : RESULT_DRAW;
+            outcome.reason = mated ? "mate" : "stalemate";
+            return outcome;
+        };
+        if (board->halfMoveClock >= FIFTY_MOVE_PLIES) { outcome.reason = "fifty-move rule"; return outcome; };
+        if (referee->isRepetition()) { outcome.reason = "repetition"; return outcome; };
+        if (insufficientMaterial(board)) { outcome.reason = "insufficient material"; return outcome; };
+        if (ply >= settings.maxPlies) { outcome.reason = "ply limit"; return outcome; };
+
+        Player* player = players[side];
+        std::string go = "go";
+        if (timed) {
+            go += " wtime " + std::to_string((long long)clocks[1]) + " btime " + std::to_string((long long)clocks[0])
+                + " winc " + std::to_string((long long)settings.increment) + " binc " + std::to_string((long long)settings.increment);
+        }
+        else {
+            if (settings.moveTime) { go += " movetime " + std::to_string(settings.moveTime); };
+            if (settings.nodes) { go += " nodes " + std::to_string(settings.nodes); };
+            if (settings.depth) { go += " depth " + std::to_string(settings.depth); };
+        };
+        // Fixed depth and node searches have no clock; they are only cut off if they hang.
+        int timeout = timed ? (int)(clocks[side] + settings.margin) : (settings.moveTime ? (int)(settings.moveTime + settings.margin) : 60000);
+        u64 start = steadyClockNanoseconds();
+        player->process.send("position fen " + opening + (moves.empty() ? "" : " moves" + moves));
+        player->process.send(go);
+        std::string line, bestMove;
+        bool answered = false;
+        while (!answered) {
+            int remaining = timeout - (int)((steadyClockNanoseconds() - start) / 1000000);
+            if (remaining < 0 || !player->process.readLine(line, remaining)) { break; };
+            std::istringstream stream(line);
+            std::string token;
+            stream >> token;
+            if (token == "bestmove") {
+                stream >> bestMove;
+                answered = true;
+            }
+            else if (token == "info") {
+                while (stream >> token) {
+                    if (token != "score") { continue; };
+                    std::string kind;
+                    int value;
+                    if (stream >> kind >> value) {
+                        if (kind == "cp") { lastScores[side] = value; }
+                        else if (kind == "mate") { lastScores[side] = value > 0 ? MATCH_MATE_SCORE : -MATCH_MATE_SCORE; };
+                    };
+                    break;
+                }
+            };
+        }
+        double elapsed = (double)(steadyClockNanoseconds() - start) / 1e6;
+        if (!answered) {
+            outcome.result = side ? RESULT_BLACK_WIN : RESULT_WHITE_WIN;
+            outcome.reason = player->process.isRunning() ? "loss on time" : "engine crashed";
+            // A hung engine is restarted before its next game.
+            player->ready = false;
+            return outcome;
+        };
+        if (timed) {
+            clocks[side] -= elapsed;
+            if (clocks[side] < -(double)settings.margin) {
+                outcome.result = side ? RESULT_BLACK_WIN : RESULT_WHITE_WIN;
+                outcome.reason = "loss on time";
+                return outcome;
+            };
+            clocks[side] = std::max(0.0, clocks[side]) + settings.increment;
+        };
+        MoveData* move = referee->findLegalMove(Eval::stringToMove(bestMove));
+        if (!move) {
+            outcome.result = side ? RESULT_BLACK_WIN : RESULT_WHITE_WIN;
+            outcome.reason = "illegal move " + bestMove;
+            return outcome;
+        };
+        referee->doMove(move);
+        delete move;
+        moves += " " + bestMove;
+
+        // Score adjudication: a side that has seen itself lost for several moves resigns, and a
+        // long level game is agreed drawn.
+        resignCounts[side] = settings.resignScore && lastScores[side] <= -settings.resignScore ? resignCounts[side] + 1 : 0;
+        if (settings.resignScore && resignCounts[side] >= settings.resignMoves) {
+            outcome.result = side ? RESULT_BLACK_WIN : RESULT_WHITE_WIN;
+            outcome.reason = "resign adjudication";
+            return outcome;
+        };
+        bool level = settings.drawScore >= 0 && std::abs(lastScores[side]) <= settings.drawScore && startMove + ply / 2 >= settings.drawFromMove;
+        drawCount = level ? drawCount + 1 : 0;
+        if (level && drawCount >= 2 * settings.drawMoves) { outcome.reason = "draw adjudication"; return outcome; };
+    }
+}
+
+// Pentanomial statistics over game pairs: counts[k] pairs in which the first engine scored k / 2.
+struct MatchStats {
+    u64 counts[5] = {};
+    u64 wins = 0, draws = 0, losses = 0;
+
+    u64 pairs() const { return counts[0] + counts[1] + counts[2] + counts[3] + counts[4]; };
+    void moments(double& mean, double& variance) const {
+        double n = (double)pairs();
+        mean = variance = 0;
+        for (int k = 0; k < 5; k++) { mean += counts[k] * (k / 4.0) / n; }
+        for (int k = 0; k < 5; k++) { variance += counts[k] * (k / 4.0 - mean) * (k / 4.0 - mean) / n; }
+    };
+    static double scoreOf(double elo) { return 1 / (1 + std::pow(10, -elo / 400)); };
+    static double eloOf(double score) {
+        score = std::min(std::max(score, 1e-6), 1 - 1e-6);
+        return -400 * std::log10(1 / score - 1);
+    };
+    // Log-likelihood ratio of elo1 against elo0 in the normal approximation.
+    double llr(double elo0, double elo1) const {
+        double mean, variance;
+        moments(mean, variance);
+        if (pairs() == 0 || variance <= 0) { return 0; };
+        double score0 = scoreOf(elo0), score1 = scoreOf(elo1);
+        return pairs() * (score1 - score0) * (2 * mean - score0 - score1) / (2 * variance);
+    };
+};
+
+static bool loadOpenings(const std::string& path, std::vector<std::string>& openings) {
+    if (path.size() > 4 && path.compare(path.size() - 4, 4, ".pgn") == 0) {
+        // Each game's final position is an opening.
+        PgnReader reader;
+        if (!reader.open(path)) { return false; };
+        Board board;
+        Eval engine(&board);
+        engine.resizeTranspositionCache(1);
+        std::vector<u64> keys;
+        std::string error;
+        PgnGame game;
+        while (reader.next(game)) {
+            uint result;
+            if (Pgn::replay(&engine, game, 0, keys, result, error)) { openings.push_back(board.toFEN()); };
+        }
+        return true;
+    };
+    std::ifstream input(path);
+    if (!input) { return false; };
+    std::string line;
+    while (std::getline(input, line)) {
+        // FEN or EPD: the four position fields, then the move clocks only if they are there.
+        std::istringstream stream(line);
+        std::string field, fen;
+        for (int i = 0; i < 6 && stream >> field; i++) {
+            if (i >= 4 && field.find_first_not_of("0123456789") != std::string::npos) { break; };
+            fen += (fen.empty() ? "" : " ") + field;
+        }
+        if (std::count(fen.begin(), fen.end(), ' ') >= 3) { openings.push_back(fen); };
+    }
+    return true;
+}
+
+static bool parseSettings(int argc, char** argv, MatchSettings& settings) {
+    int engineCount = 0;
+    std::string openingsPath;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) { throw std::invalid_argument(option + " needs a value"); };
+            return argv[++i];
+        };
+        auto nextCount = [&](auto& value) {
+            std::string text = next();
+            if (!parseCount(text.c_str(), value)) { throw std::invalid_argument("bad value " + text + " for " + option); };
+        };
+        auto nextInteger = [&](int& value) {
+            std::string text = next();
+            if (!parseInteger(text.c_str(), value)) { throw std::invalid_argument("bad value " + text + " for " + option); };
+        };
+        auto nextDecimal = [&](double& value) {
+            std::string text = next();
+            if (!parseDecimal(text.c_str(), value)) { throw std::invalid_argument("bad value " + text + " for " + option); };
+        };
+        if (option == "--engine") {
+            if (engineCount == 2) { throw std::invalid_argument("only two engines play a match"); };
+            settings.engines[engineCount++].command = next();
+        }
+        else if (option == "--option") {
+            std::string value = next();
+            size_t equals = value.find('=');
+            if (engineCount == 0 || equals == std::string::npos) { throw std::invalid_argument("--option Name=value follows an --engine"); };
+            settings.engines[engineCount - 1].options.push_back({value.substr(0, equals), value.substr(equals + 1)});
+        }
+        else if (option == "--openings") { openingsPath = next(); }
+        else if (option == "--games") { nextCount(settings.games); }
+        else if (option == "--concurrency") {
+            nextCount(settings.concurrency);
+            settings.concurrency = std::max(1u, settings.concurrency);
+        }
+        else if (option == "--tc") {
+            std::string value = next();
+            size_t plus = value.find('+');
+            std::string base = value.substr(0, plus);
+            std::string increment = plus == std::string::npos ? "0" : value.substr(plus + 1);
+            if (!parseDecimal(base.c_str(), settings.baseTime) || !parseDecimal(increment.c_str(), settings.increment)
+                || settings.baseTime < 0 || settings.increment < 0) {
+                throw std::invalid_argument("bad value " + value + " for --tc");
+            };
+            settings.baseTime *= 1000;
+            settings.increment *= 1000;
+        }
+        else if (option == "--movetime") { nextCount(settings.moveTime); }
+        else if (option == "--nodes") { nextCount(settings.nodes); }
+        else if (option == "--depth") { nextCount(settings.depth); }
+        else if (option == "--margin") { nextCount(settings.margin); }
+        else if (option == "--sprt") {
+            settings.sprt = true;
+            nextDecimal(settings.elo0);
+            nextDecimal(settings.elo1);
+        }
+        else if (option == "--alpha") { nextDecimal(settings.alpha); }
+        else if (option == "--beta") { nextDecimal(settings.beta); }
+        else if (option == "--resign") {
+            nextInteger(settings.resignScore);
+            nextCount(settings.resignMoves);
+        }
+        else if (option == "--draw") {
+            nextInteger(settings.drawScore);
+            nextCount(settings.drawMoves);
+            nextCount(settings.drawFromMove);
+        }
+        else if (option == "--max-plies") { nextCount(settings.maxPlies); }
+        else { throw std::invalid_argument("unknown option " + option); };
+    }
+    if (engineCount != 2) { throw std::invalid_argument("give two engines"); };
+    if (settings.sprt && settings.elo1 <= settings.elo0) { throw std::invalid_argument("--sprt needs elo0 < elo1"); };
+    if (!(settings.alpha > 0 && settings.alpha < 1 && settings.beta > 0 && settings.beta < 1)) {
+        throw std::invalid_argument("--alpha and --beta must lie between 0 and 1");
+    };
+    if (!openingsPath.empty() && !loadOpenings(openingsPath, settings.openings)) { throw std::invalid_argument("cannot read openings from " + openingsPath); };
+    if (settings.openings.empty()) {
+        if (!openingsPath.empty()) { throw std::invalid_argument("no openings in " + openingsPath); };
+        std::cerr << "warning: no opening suite, every pair starts from the initial position" << std::endl;
+        settings.openings.push_back(STARTING_FEN);
+    };
+    return true;
+}
+
+static const char* RESULT_TEXT[4] = {"*", "1-0", "1/2-1/2", "0-1"};
+
+int main(int argc, char** argv) {
+    MatchSettings settings;
+    try {
+        parseSettings(argc, argv, settings);
+    }
+    catch (const std::exception& error) {
+        std::cerr << error.what() << std::endl
+                  << "usage: match --engine <command> [--option Name=value ...] --engine <command> [--option ...]" << std::endl
+                  << "             [--openings file.epd|file.pgn] [--games N] [--concurrency N]" << std::endl
+                  << "             [--tc base+inc | --movetime ms | --nodes N | --depth D] [--margin ms]" << std::endl
+                  << "             [--sprt elo0 elo1] [--alpha A] [--beta B] [--resign cp moves]" << std::endl
+                  << "             [--draw cp moves fromMove] [--max-plies N]" << std::endl;
+        return 1;
+    }
+    double lowerBound = std::log(settings.beta / (1 - settings.alpha));
+    double upperBound = std::log((1 - settings.beta) / settings.alpha);
+    std::cerr << "A: " << settings.engines[0].command << std::endl << "B: " << settings.engines[1].command << std::endl
+              << settings.openings.size() << " openings, up to " << settings.games << " games on " << settings.concurrency << " threads";
+    if (settings.sprt) { std::cerr << ", SPRT elo0 " << settings.elo0 << " elo1 " << settings.elo1 << " bounds [" << lowerBound << ", " << upperBound << "]"; };
+    std::cerr << std::endl;
+
+    ThreadPool pool(settings.concurrency, 2 * (size_t)settings.concurrency);
+    // Every worker keeps both engines running between games, and a referee position.
+    std::vector<std::unique_ptr<Player>> players;
+    std::vector<Board*> boards;
+    std::vector<Eval*> referees;
+    for (uint i = 0; i < pool.size(); i++) {
+        for (int engine = 0; engine < 2; engine++) {
+            players.emplace_back(new Player());
+            players.back()->spec = settings.engines[engine];
+        }
+        boards.push_back(new Board());
+        referees.push_back(new Eval(boards.back()));
+        referees.back()->resizeTranspositionCache(1);
+        referees.back()->resizeEvalCache(0);
+    }
+
+    std::mutex statsMutex;
+    MatchStats stats;
+    std::atomic<bool> decided(false);
+    std::string verdict;
+    u64 startTime = steadyClockNanoseconds();
+    for (uint pair = 0; 2 * pair < settings.games && !decided; pair++) {
+        pool.submit([&, pair](uint worker) {
+            if (decided) { return; };
+            const std::string& opening = settings.openings[pair % settings.openings.size()];
+            Player* a = players[2 * worker].get();
+            Player* b = players[2 * worker + 1].get();
+            GameOutcome first = playGame(a, b, referees[worker], opening, settings);
+            GameOutcome second = playGame(b, a, referees[worker], opening, settings);
+            // Points for A out of two, counted in half points.
+            uint halfPoints = (first.result == RESULT_WHITE_WIN ? 2 : first.result == RESULT_DRAW ? 1 : 0)
+                            + (second.result == RESULT_BLACK_WIN ? 2 : second.result == RESULT_DRAW ? 1 : 0);
+            std::lock_guard<std::mutex> lock(statsMutex);
+            if (decided) { return; };
+            stats.counts[halfPoints]++;
+            for (uint points : {first.result == RESULT_WHITE_WIN ? 2u : first.result == RESULT_DRAW ? 1u : 0u,
+                                second.result == RESULT_BLACK_WIN ? 2u : second.result == RESULT_DRAW ? 1u : 0u}) {
+                if (points == 2) { stats.wins++; } else if (points == 1) { stats.draws++; } else { stats.losses++; };
+            }
+            double mean, variance;
+            stats.moments(mean, variance);
+            double spread = 1.96 * std::sqrt(variance / stats.pairs());
+            double llr = stats.llr(settings.elo0, settings.elo1);
+            std::ostringstream text;
+            text << "pair " << pair + 1 << " (" << opening << "): A-B " << RESULT_TEXT[first.result] << " (" << first.reason
+                 << "), B-A " << RESULT_TEXT[second.result] << " (" << second.reason << ")" << std::endl
+                 << "  A: +" << stats.wins << " =" << stats.draws << " -" << stats.losses << std::fixed << std::setprecision(1)
+                 << ", elo " << MatchStats::eloOf(mean) << " [" << MatchStats::eloOf(mean - spread) << ", "
+                 << MatchStats::eloOf(mean + spread) << "]";
+            if (settings.sprt) { text << std::setprecision(2) << ", LLR " << llr << " [" << lowerBound << ", " << upperBound << "]"; };
+            std::cout << text.str() << std::endl;
+            if (settings.sprt && (llr <= lowerBound || llr >= upperBound)) {
+                verdict = llr >= upperBound ? "H1 accepted: A is at least elo1 stronger" : "H0 accepted: A is at most elo0 stronger";
+                decided = true;
+            };
+        });
+    }
+    pool.wait();
+
+    double seconds = secondsSince(startTime);
+    std::cout << stats.wins + stats.draws + stats.losses << " games in " << std::fixed << std::setprecision(1) << seconds << "s, pentanomial "
+              << stats.counts[0] << " " << stats.counts[1] << " " << stats.counts[2] << " " << stats.counts[3] << " "
+              << stats.counts[4] << "; " << (verdict.empty() ? (settings.sprt ? "SPRT inconclusive" : "no SPRT") : verdict) << std::endl;
+    players.clear();
+    for (uint i = 0; i < pool.size(); i++) {
+        delete referees[i];
+        delete boards[i];
+    }
+    return 0;
+}
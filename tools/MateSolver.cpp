@@ -0,0 +1,153 @@
+// Proves forced mates for a file of puzzles in parallel, one Board/Eval/MateSolver per worker.
+// Usage: mateSolver <input.epd> [--threads N] [--hash MB] [--nodes N] [--time ms]
+// Lines are FEN or EPD; a "dm N" operation gives the expected mate in N moves. Each output line
+// is the position followed by the result (mate in N, no mate, or unknown when a limit ran out),
+// the proof's main line, nodes and milliseconds. The exit status is non-zero when a position
+// with a dm operation could not be proven. The proof found is not always the shortest, so
+// length differences are reported but are not failures.
+#include "../inc/Arguments.h"
+#include "../inc/Clock.h"
+#include "../inc/MateSolver.h"
+#include "../inc/ThreadPool.h"
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+struct Puzzle {
+    std::string position;
+    uint expectedMoves = 0; // From the dm operation, zero when there is none.
+};
+
+// False for lines without a position; throws std::invalid_argument on a bad dm operation.
+static bool parsePuzzle(const std::string& line, Puzzle& puzzle) {
+    std::istringstream stream(line);
+    std::string fields[4];
+    for (int i = 0; i < 4; i++) {
+        if (!(stream >> fields[i])) { return false; };
+    }
+    puzzle.position = fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3];
+    std::string token;
+    while (stream >> token) {
+        if (token == "dm" && stream >> token) {
+            std::string count = token.back() == ';' ? token.substr(0, token.size() - 1) : token;
+            if (!parseCount(count.c_str(), puzzle.expectedMoves)) { throw std::invalid_argument("bad dm operation " + token); };
+        };
+    }
+    return true;
+}
+
+static const char* USAGE = "usage: mateSolver <input.epd> [--threads N] [--hash MB] [--nodes N] [--time ms]";
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << USAGE << std::endl;
+        return 1;
+    };
+    uint threads = ThreadPool::defaultThreadCount();
+    uint hashMegabytes = MATE_SOLVER_DEFAULT_HASH_MB;
+    u64 nodeLimit = 10000000;
+    u64 moveTime = 0;
+    for (int i = 2; i < argc; i += 2) {
+        std::string option = argv[i];
+        if (i + 1 == argc) {
+            std::cerr << "option " << option << " needs a value" << std::endl << USAGE << std::endl;
+            return 1;
+        };
+        const char* value = argv[i + 1];
+        bool numeric;
+        if (option == "--threads") { numeric = parseCount(value, threads); }
+        else if (option == "--hash") { numeric = parseCount(value, hashMegabytes); }
+        else if (option == "--nodes") { numeric = parseCount(value, nodeLimit); }
+        else if (option == "--time") { numeric = parseCount(value, moveTime); }
+        else {
+            std::cerr << "unknown option " << option << std::endl << USAGE << std::endl;
+            return 1;
+        };
+        if (!numeric) {
+            std::cerr << "bad value " << value << " for " << option << std::endl << USAGE << std::endl;
+            return 1;
+        };
+    }
+    std::ifstream input(argv[1]);
+    if (!input) {
+        std::cerr << "cannot open " << argv[1] << std::endl;
+        return 1;
+    };
+
+    ThreadPool pool(threads, 4 * (size_t)threads);
+    std::vector<Board*> boards;
+    std::vector<Eval*> engines;
+    std::vector<MateSolver*> solvers;
+    for (uint i = 0; i < pool.size(); i++) {
+        boards.push_back(new Board());
+        engines.push_back(new Eval(boards.back()));
+        engines.back()->resizeTranspositionCache(1);
+        solvers.push_back(new MateSolver(engines.back(), hashMegabytes));
+    }
+
+    std::mutex outputMutex;
+    std::atomic<u64> proven(0), failed(0), lengthDiffers(0), totalNodes(0), solveMilliseconds(0);
+    u64 startTime = steadyClockNanoseconds();
+    std::string line;
+    u64 lineNumber = 0, puzzles = 0;
+    while (std::getline(input, line)) {
+        lineNumber++;
+        Puzzle puzzle;
+        try {
+            if (!parsePuzzle(line, puzzle)) { continue; };
+        }
+        catch (const std::invalid_argument& error) {
+            std::lock_guard<std::mutex> lock(outputMutex);
+            std::cerr << "line " << lineNumber << ": " << error.what() << std::endl;
+            failed++;
+            continue;
+        }
+        puzzles++;
+        pool.submit([&, puzzle, lineNumber](uint worker) {
+            try {
+                boards[worker]->loadFEN(puzzle.position);
+            }
+            catch (const std::invalid_argument& error) {
+                std::lock_guard<std::mutex> lock(outputMutex);
+                std::cerr << "line " << lineNumber << ": " << error.what() << std::endl;
+                failed++;
+                return;
+            }
+            engines[worker]->resetGameHistory();
+            // Proofs from earlier puzzles would only crowd the table.
+            solvers[worker]->clear();
+            MateResult result = solvers[worker]->solve(nodeLimit, moveTime);
+            totalNodes += result.nodes;
+            solveMilliseconds += result.time;
+            uint moves = (result.plies + 1) / 2;
+            std::ostringstream text;
+            text << puzzle.position << "; ";
+            if (result.proven) { text << "mate " << moves; }
+            else { text << (result.disproven ? "no mate" : "unknown"); };
+            if (puzzle.expectedMoves && result.proven && moves != puzzle.expectedMoves) {
+                text << " (dm " << puzzle.expectedMoves << ")";
+                lengthDiffers++;
+            };
+            text << "; pv";
+            for (u16 move : result.pv) { text << " " << Eval::moveToString(move); }
+            text << "; nodes " << result.nodes << "; ms " << result.time;
+            if (result.proven) { proven++; }
+            else if (puzzle.expectedMoves) { failed++; };
+            std::lock_guard<std::mutex> lock(outputMutex);
+            std::cout << text.str() << std::endl;
+        });
+    }
+    pool.wait();
+
+    double seconds = secondsSince(startTime);
+    std::cerr << puzzles << " positions, " << proven << " mates proven, " << failed << " failed, " << lengthDiffers
+              << " with a different length, " << totalNodes << " nodes in " << seconds << "s (average "
+              << (puzzles ? (double)solveMilliseconds / puzzles : 0) << " ms)" << std::endl;
+    for (uint i = 0; i < pool.size(); i++) {
+        delete solvers[i];
+        delete engines[i];
+        delete boards[i];
+    }
+    return failed ? 1 : 0;
+}
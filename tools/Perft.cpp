@@ -0,0 +1,135 @@
+// Parallel move generation check.
+// Usage: perft <depth> [fen] [--threads N] [--hash MB] [--divide]
+//        perft --suite <file> [--max-depth D] [--threads N] [--hash MB]
+// Suite lines use the usual perft suite layout, "<fen> ;D1 20 ;D2 400 ...". Every mismatch is
+// reported and makes the exit status non-zero. --hash 0 turns the shared subtree table off.
+#include "../inc/Arguments.h"
+#include "../inc/Clock.h"
+#include "../inc/Perft.h"
+#include <fstream>
+#include <sstream>
+
+static int runSuite(Perft& perft, const std::string& path, uint maxDepth) {
+    std::ifstream input(path);
+    if (!input) {
+        std::cerr << "cannot open " << path << std::endl;
+        return 1;
+    };
+    u64 startTime = steadyClockNanoseconds();
+    std::string line;
+    uint positions = 0, checks = 0, failures = 0;
+    u64 totalNodes = 0;
+    while (std::getline(input, line)) {
+        size_t separator = line.find(';');
+        if (separator == std::string::npos) { continue; };
+        std::string fen = line.substr(0, separator);
+        positions++;
+        std::istringstream expectations(line.substr(separator));
+        std::string field;
+        while (std::getline(expectations, field, ';')) {
+            std::istringstream parts(field);
+            std::string label, count, extra;
+            if (!(parts >> label)) { continue; };
+            uint depth;
+            u64 expected;
+            if (label.size() < 2 || label[0] != 'D' || !parseCount(label.c_str() + 1, depth) || !(parts >> count)
+                || !parseCount(count.c_str(), expected) || parts >> extra) {
+                std::cerr << "line " << positions << ": bad expectation \"" << field << "\"" << std::endl;
+                failures++;
+                continue;
+            };
+            if (maxDepth && depth > maxDepth) { continue; };
+            u64 nodes;
+            try {
+                nodes = perft.run(fen, depth);
+            }
+            catch (const std::exception& error) {
+                std::cerr << "line " << positions << ": " << error.what() << std::endl;
+                failures++;
+                break;
+            }
+            checks++;
+            totalNodes += nodes;
+            if (nodes != expected) {
+                failures++;
+                std::cout << "FAIL " << fen << " depth " << depth << ": " << nodes << " != " << expected << std::endl;
+            };
+        }
+    }
+    double seconds = secondsSince(startTime);
+    std::cout << positions << " positions, " << checks << " counts checked, " << failures << " failed, "
+              << totalNodes << " nodes in " << seconds << "s (" << (u64)(totalNodes / (seconds > 0 ? seconds : 1)) << " nodes/s)" << std::endl;
+    return failures ? 1 : 0;
+}
+
+static int usage() {
+    std::cerr << "usage: perft <depth> [fen] [--threads N] [--hash MB] [--divide]" << std::endl;
+    std::cerr << "       perft --suite <file> [--max-depth D] [--threads N] [--hash MB]" << std::endl;
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    uint threads = ThreadPool::defaultThreadCount();
+    uint hashMegabytes = 64;
+    uint depth = 0;
+    uint maxDepth = 0;
+    bool divide = false;
+    std::string fen = STARTING_FEN;
+    std::string suite;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--divide") {
+            divide = true;
+            continue;
+        };
+        if (option.compare(0, 2, "--") != 0) {
+            // The first bare number is the depth; FENs always contain '/'.
+            if (depth == 0 && option.find('/') == std::string::npos) {
+                if (!parseCount(option.c_str(), depth) || depth == 0) {
+                    std::cerr << "bad depth " << option << std::endl;
+                    return usage();
+                };
+            }
+            else { fen = option; };
+            continue;
+        };
+        if (i + 1 == argc) {
+            std::cerr << "option " << option << " needs a value" << std::endl;
+            return usage();
+        };
+        const char* value = argv[++i];
+        bool numeric = true;
+        if (option == "--suite") { suite = value; }
+        else if (option == "--threads") { numeric = parseCount(value, threads); }
+        else if (option == "--hash") { numeric = parseCount(value, hashMegabytes); }
+        else if (option == "--max-depth") { numeric = parseCount(value, maxDepth); }
+        else {
+            std::cerr << "unknown option " << option << std::endl;
+            return usage();
+        };
+        if (!numeric) {
+            std::cerr << "bad value " << value << " for " << option << std::endl;
+            return usage();
+        };
+    }
+    if (suite.empty() && depth == 0) { return usage(); };
+
+    Perft perft(threads, hashMegabytes);
+    if (!suite.empty()) { return runSuite(perft, suite, maxDepth); };
+
+    u64 startTime = steadyClockNanoseconds();
+    std::vector<std::pair<u16, u64>> division;
+    u64 nodes;
+    try {
+        nodes = perft.run(fen, depth, divide ? &division : nullptr);
+    }
+    catch (const std::exception& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    double seconds = secondsSince(startTime);
+    for (const std::pair<u16, u64>& entry : division) { std::cout << Eval::moveToString(entry.first) << ": " << entry.second << "\n"; }
+    std::cout << "perft " << depth << ": " << nodes << " in " << seconds << "s ("
+              << (u64)(nodes / (seconds > 0 ? seconds : 1)) << " nodes/s)" << std::endl;
+    return 0;
+}
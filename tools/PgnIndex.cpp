@@ -0,0 +1,199 @@
+// Builds and queries position statistics from PGN game databases.
+// Usage: pgnIndex build <games.pgn> <output.idx> [--threads N] [--plies N] [--memory MB]
+//        pgnIndex query <index.idx> [startpos | <fen>] [moves <m1> <m2> ...]
+// build replays every game in parallel and writes, for each position reached in the first N plies
+// of any game (all plies by default), how many of those games white won, drew and lost. The
+// index is sorted by key, so query answers with a binary search: it prints the position's counts
+// and those of every legal move from it, most played first. Games with an illegal or unreadable
+// move, or without a result, are skipped and counted.
+#include "../inc/Arguments.h"
+#include "../inc/Clock.h"
+#include "../inc/Pgn.h"
+#include "../inc/PositionIndex.h"
+#include "../inc/ThreadPool.h"
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+
+#define PGN_INDEX_BATCH 256 // Games per pool task.
+#define PGN_INDEX_REPORTED_ERRORS 10
+
+static std::string percentages(const PositionStats& stats) {
+    double games = (double)std::max<u64>(1, stats.games());
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(1) << "white " << 100.0 * stats.whiteWins / games << "%  draw "
+         << 100.0 * stats.draws / games << "%  black " << 100.0 * stats.blackWins / games << "%";
+    return text.str();
+}
+
+static int usage() {
+    std::cerr << "usage: pgnIndex build <games.pgn> <output.idx> [--threads N] [--plies N] [--memory MB]" << std::endl
+              << "       pgnIndex query <index.idx> [startpos | <fen>] [moves <m1> <m2> ...]" << std::endl;
+    return 1;
+}
+
+static int build(int argc, char** argv) {
+    uint threads = ThreadPool::defaultThreadCount();
+    uint maxPlies = 0;
+    size_t memoryMegabytes = POSITION_INDEX_DEFAULT_MEMORY_MB;
+    for (int i = 4; i < argc; i += 2) {
+        std::string option = argv[i];
+        if (i + 1 == argc) {
+            std::cerr << "option " << option << " needs a value" << std::endl;
+            return usage();
+        };
+        unsigned long long memory = memoryMegabytes;
+        bool numeric;
+        if (option == "--threads") { numeric = parseCount(argv[i + 1], threads); }
+        else if (option == "--plies") { numeric = parseCount(argv[i + 1], maxPlies); }
+        else if (option == "--memory") { numeric = parseCount(argv[i + 1], memory); }
+        else {
+            std::cerr << "unknown option " << option << std::endl;
+            return usage();
+        };
+        if (!numeric) {
+            std::cerr << "bad value " << argv[i + 1] << " for " << option << std::endl;
+            return usage();
+        };
+        memoryMegabytes = (size_t)memory;
+    }
+    PgnReader reader;
+    if (!reader.open(argv[2])) {
+        std::cerr << "cannot open " << argv[2] << std::endl;
+        return 1;
+    };
+
+    ThreadPool pool(threads, 4 * (size_t)threads);
+    std::vector<Board*> boards;
+    std::vector<Eval*> engines;
+    for (uint i = 0; i < pool.size(); i++) {
+        boards.push_back(new Board());
+        engines.push_back(new Eval(boards.back()));
+        // Replaying never searches or evaluates, so the caches would only take memory.
+        engines.back()->resizeTranspositionCache(1);
+        engines.back()->resizeEvalCache(0);
+    }
+    PositionIndexBuilder builder(argv[3], pool.size(), memoryMegabytes << 20);
+
+    std::mutex outputMutex;
+    std::atomic<u64> indexed(0), unreadable(0), noResult(0);
+    std::atomic<bool> writeFailed(false);
+    u64 startTime = steadyClockNanoseconds();
+    u64 games = 0, nextReport = 64 << 20;
+    std::vector<PgnGame> batch;
+    auto submitBatch = [&]() {
+        pool.submit([&, batch](uint worker) {
+            std::vector<u64> keys;
+            std::string error;
+            for (const PgnGame& game : batch) {
+                uint result;
+                if (!Pgn::replay(engines[worker], game, maxPlies, keys, result, error)) {
+                    if (unreadable++ < PGN_INDEX_REPORTED_ERRORS) {
+                        std::lock_guard<std::mutex> lock(outputMutex);
+                        std::cerr << "game at byte " << game.offset << ": " << error << std::endl;
+                    };
+                    continue;
+                };
+                if (result == RESULT_UNKNOWN) {
+                    noResult++;
+                    continue;
+                };
+                if (!builder.addGame(worker, keys, result)) { writeFailed = true; };
+                indexed++;
+            }
+        });
+        batch.clear();
+    };
+    PgnGame game;
+    while (reader.next(game)) {
+        games++;
+        batch.push_back(game);
+        if (batch.size() == PGN_INDEX_BATCH) { submitBatch(); };
+        if (reader.bytesRead() >= nextReport) {
+            std::lock_guard<std::mutex> lock(outputMutex);
+            std::cerr << (reader.bytesRead() >> 20) << " of " << (reader.size() >> 20) << " MB, " << games << " games" << std::endl;
+            nextReport += 64 << 20;
+        };
+    }
+    if (!batch.empty()) { submitBatch(); };
+    pool.wait();
+    bool written = !writeFailed && builder.finish();
+
+    double seconds = secondsSince(startTime);
+    std::cerr << games << " games, " << indexed << " indexed, " << unreadable << " unreadable, " << noResult
+              << " without a result; " << builder.positions() << " positions in " << seconds << "s ("
+              << (seconds > 0 ? (reader.size() >> 20) / seconds : 0) << " MB/s)" << std::endl;
+    for (uint i = 0; i < pool.size(); i++) {
+        delete engines[i];
+        delete boards[i];
+    }
+    if (!written) {
+        std::cerr << "cannot write " << argv[3] << std::endl;
+        return 1;
+    };
+    return 0;
+}
+
+static int query(int argc, char** argv) {
+    PositionIndex index;
+    if (!index.open(argv[2])) {
+        std::cerr << "cannot open index " << argv[2] << std::endl;
+        return 1;
+    };
+    std::string fen;
+    int i = 3;
+    for (; i < argc && std::string(argv[i]) != "moves"; i++) { fen += (fen.empty() ? "" : " ") + std::string(argv[i]); }
+    if (fen.empty() || fen == "startpos") { fen = STARTING_FEN; };
+    Board board;
+    Eval engine(&board);
+    try {
+        board.loadFEN(fen);
+    }
+    catch (const std::invalid_argument& error) {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+    for (i++; i < argc; i++) {
+        MoveData* move = engine.findLegalMove(Eval::stringToMove(argv[i]));
+        if (!move) {
+            std::cerr << "illegal move " << argv[i] << std::endl;
+            return 1;
+        };
+        engine.doMove(move);
+        delete move;
+    }
+
+    PositionStats stats = {};
+    if (!index.find(board.positionKey(), stats)) {
+        std::cout << board.toFEN() << ": in no game" << std::endl;
+        return 0;
+    };
+    std::cout << board.toFEN() << ": " << stats.games() << " games, " << percentages(stats) << std::endl;
+    std::vector<std::pair<u16, PositionStats>> children;
+    std::vector<MoveData*> moves = engine.findLegalMoves(engine.isInCheck() ? engine.findEvasionMoves() : engine.findPseudoLegalMoves());
+    for (MoveData* move : moves) {
+        engine.doMove(move);
+        PositionStats child = {};
+        if (index.find(board.positionKey(), child)) { children.push_back({move->encode(), child}); };
+        engine.undoMove(move);
+    }
+    Eval::releaseMoves(moves);
+    std::sort(children.begin(), children.end(), [](const std::pair<u16, PositionStats>& a, const std::pair<u16, PositionStats>& b) {
+        return a.second.games() > b.second.games();
+    });
+    // A transposition can reach the same position from another line, so the counts need not add up.
+    for (const std::pair<u16, PositionStats>& child : children) {
+        std::cout << std::left << std::setw(7) << Eval::moveToString(child.first) << std::right << std::setw(10)
+                  << child.second.games() << " games  " << percentages(child.second) << std::endl;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::string command = argc > 1 ? argv[1] : "";
+    if (command == "build" && argc >= 4) { return build(argc, argv); };
+    if (command == "query" && argc >= 3) { return query(argc, argv); };
+    return usage();
+}
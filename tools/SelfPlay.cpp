@@ -0,0 +1,197 @@
+// Plays engine-vs-engine games in parallel and streams every searched position to a binary
+// position file (see PositionFile.h), labelled with the search score and the game result.
+// Usage: selfPlay <output.bin> [--games N] [--threads N] [--depth D] [--nodes N] [--hash MB]
+//                 [--random-plies N] [--max-plies N] [--seed S]
+//        selfPlay --output <output.bin> [options]
+//        selfPlay --dump <input.bin> [count]
+// Games open with random legal moves for variety and end on mate, stalemate, the fifty-move
+// rule, threefold repetition, bare kings or the ply cap. Positions in check are not recorded.
+#include "../inc/Arguments.h"
+#include "../inc/Clock.h"
+#include "../inc/Eval.h"
+#include "../inc/PositionFile.h"
+#include "../inc/ThreadPool.h"
+#include <atomic>
+#include <mutex>
+#include <random>
+
+struct SelfPlaySettings {
+    SearchLimits limits;
+    uint randomPlies = 8;
+    uint maxPlies = 400;
+    u64 seed = 1;
+};
+
+// Plays one game and returns its positions with the result filled in.
+static std::vector<PackedPosition> playGame(Board* board, Eval* engine, const SelfPlaySettings& settings, u64 gameIndex) {
+    std::mt19937_64 random(settings.seed * 0x9E3779B97F4A7C15ULL + gameIndex);
+    std::vector<PackedPosition> positions;
+    board->loadFEN(STARTING_FEN);
+    engine->resetGameHistory();
+    engine->clearSearchHeuristics();
+    unsigned char result = RESULT_DRAW;
+    for (uint ply = 0; ply < settings.maxPlies; ply++) {
+        std::vector<MoveData*> legal = engine->findLegalMoves(engine->isInCheck() ? engine->findEvasionMoves() : engine->findPseudoLegalMoves());
+        if (legal.empty()) {
+            if (engine->isInCheck()) { result = board->currentTurn ? RESULT_BLACK_WIN : RESULT_WHITE_WIN; };
+            break;
+        };
+        Eval::releaseMoves(legal);
+        if (board->halfMoveClock >= FIFTY_MOVE_PLIES || engine->isRepetition() || board->pieceLocations[0] == (board->pieceLocations[2] | board->pieceLocations[9])) {
+            break;
+        };
+
+        u16 chosen;
+        if (ply < settings.randomPlies) {
+            legal = engine->findLegalMoves(engine->isInCheck() ? engine->findEvasionMoves() : engine->findPseudoLegalMoves());
+            chosen = legal[random() % legal.size()]->encode();
+            Eval::releaseMoves(legal);
+        }
+        else {
+            engine->stopRequested = false;
+            SearchResult searched = engine->search(settings.limits);
+            chosen = searched.bestMove;
+            if (!engine->isInCheck()) {
+                positions.push_back(board->pack());
+                positions.back().score = searched.score;
+            };
+        };
+
+        MoveData* move = engine->findLegalMove(chosen);
+        if (!move) { break; };
+        engine->doMove(move);
+        delete move;
+    }
+    for (PackedPosition& position : positions) { position.result = result; }
+    return positions;
+}
+
+static int dump(const std::string& path, size_t count) {
+    PositionReader reader;
+    if (!reader.open(path)) {
+        std::cerr << "cannot read position file " << path << std::endl;
+        return 1;
+    };
+    static const char* RESULTS[4] = {"*", "1-0", "1/2-1/2", "0-1"};
+    Board board;
+    u64 results[4] = {};
+    for (size_t i = 0; i < reader.size(); i++) { results[reader[i].result & 3]++; }
+    u64 bad = 0;
+    for (size_t i = 0; i < reader.size() && i < count; i++) {
+        try {
+            board.unpack(reader[i]);
+        }
+        catch (const std::invalid_argument& error) {
+            std::cerr << "record " << i << ": " << error.what() << std::endl;
+            bad++;
+            continue;
+        }
+        std::cout << board.toFEN() << " | " << reader[i].score << " | " << RESULTS[reader[i].result & 3] << "\n";
+    }
+    std::cerr << reader.size() << " positions: " << results[1] << " from white wins, " << results[2]
+              << " from draws, " << results[3] << " from black wins" << std::endl;
+    return bad ? 1 : 0;
+}
+
+static int usage() {
+    std::cerr << "usage: selfPlay <output.bin> [--games N] [--threads N] [--depth D] [--nodes N] [--hash MB] [--random-plies N] [--max-plies N] [--seed S]" << std::endl;
+    std::cerr << "       selfPlay --output <output.bin> [options]" << std::endl;
+    std::cerr << "       selfPlay --dump <input.bin> [count]" << std::endl;
+    return 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 3 && std::string(argv[1]) == "--dump") {
+        unsigned long long count = 10;
+        if (argc > 4 || (argc == 4 && !parseCount(argv[3], count))) { return usage(); };
+        return dump(argv[2], count);
+    };
+    SelfPlaySettings settings;
+    uint threads = ThreadPool::defaultThreadCount();
+    u64 games = 100;
+    uint hashMegabytes = 16;
+    std::string outputPath;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option.compare(0, 2, "--") != 0) {
+            if (!outputPath.empty()) {
+                std::cerr << "unexpected argument " << option << std::endl;
+                return usage();
+            };
+            outputPath = option;
+            continue;
+        };
+        if (i + 1 == argc) {
+            std::cerr << "option " << option << " needs a value" << std::endl;
+            return usage();
+        };
+        std::string text = argv[++i];
+        if (option == "--output") {
+            outputPath = text;
+            continue;
+        };
+        unsigned long long value = 0;
+        bool numeric = parseCount(text.c_str(), value);
+        if (option == "--games") { games = value; }
+        else if (option == "--threads") { threads = (uint)value; }
+        else if (option == "--depth") { settings.limits.depth = (uint)value; }
+        else if (option == "--nodes") { settings.limits.nodes = value; }
+        else if (option == "--hash") { hashMegabytes = (uint)value; }
+        else if (option == "--random-plies") { settings.randomPlies = (uint)value; }
+        else if (option == "--max-plies") { settings.maxPlies = (uint)value; }
+        else if (option == "--seed") { settings.seed = value; }
+        else {
+            std::cerr << "unknown option " << option << std::endl;
+            return usage();
+        };
+        if (!numeric) {
+            std::cerr << "bad value " << text << " for " << option << std::endl;
+            return usage();
+        };
+    }
+    if (outputPath.empty()) { return usage(); };
+    if (settings.limits.depth == 0 && settings.limits.nodes == 0) { settings.limits.depth = 4; };
+
+    PositionWriter writer;
+    if (!writer.open(outputPath)) {
+        std::cerr << "cannot open " << outputPath << std::endl;
+        return 1;
+    };
+
+    ThreadPool pool(threads, 4 * (size_t)threads);
+    std::vector<Board*> boards;
+    std::vector<Eval*> engines;
+    for (uint i = 0; i < pool.size(); i++) {
+        boards.push_back(new Board());
+        engines.push_back(new Eval(boards.back()));
+        engines.back()->resizeTranspositionCache(hashMegabytes);
+    }
+
+    std::mutex writerMutex;
+    std::atomic<u64> finished(0);
+    bool writeFailed = false;
+    u64 startTime = steadyClockNanoseconds();
+    for (u64 game = 0; game < games; game++) {
+        pool.submit([&, game](uint worker) {
+            std::vector<PackedPosition> positions = playGame(boards[worker], engines[worker], settings, game);
+            std::lock_guard<std::mutex> lock(writerMutex);
+            writeFailed = !writer.write(positions.data(), positions.size()) || writeFailed;
+            if (++finished % 100 == 0) { std::cerr << finished << " games, " << writer.written() << " positions" << std::endl; };
+        });
+    }
+    pool.wait();
+    writeFailed = !writer.close() || writeFailed;
+    if (writeFailed) {
+        std::cerr << "writing " << outputPath << " failed" << std::endl;
+        return 1;
+    };
+
+    double seconds = secondsSince(startTime);
+    std::cerr << "played " << finished << " games with " << pool.size() << " threads in " << seconds << "s, "
+              << writer.written() << " positions (" << (u64)(writer.written() / (seconds > 0 ? seconds : 1)) << "/s)" << std::endl;
+    for (uint i = 0; i < pool.size(); i++) {
+        delete engines[i];
+        delete boards[i];
+    }
+    return 0;
+}
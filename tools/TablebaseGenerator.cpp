@@ -0,0 +1,65 @@
+// Generates endgame tablebases by retrograde analysis and writes them to a directory.
+// Usage: tablebaseGenerator <directory> [--all N] [NAME...]
+// Names follow the KQvKR convention; --all N generates every table with up to N pieces (N <= 4).
+// Smaller tables needed for captures and promotions are generated first, or read back when the
+// directory already holds them.
+#include "../inc/Arguments.h"
+#include "../inc/Tablebase.h"
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+static const char* USAGE = "usage: tablebaseGenerator <directory> [--all N] [NAME...]";
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << USAGE << std::endl;
+        return 1;
+    };
+    std::string directory = argv[1];
+    std::vector<std::string> names;
+    for (int i = 2; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--all") {
+            uint pieces;
+            if (i + 1 == argc || !parseCount(argv[i + 1], pieces)) {
+                std::cerr << "--all needs a piece count" << std::endl << USAGE << std::endl;
+                return 1;
+            };
+            i++;
+            if (pieces > TABLEBASE_MAX_PIECES) {
+                std::cerr << "tables are limited to " << TABLEBASE_MAX_PIECES << " pieces" << std::endl;
+                return 1;
+            };
+            std::vector<std::string> all = TablebaseGenerator::allMaterials((int)pieces);
+            names.insert(names.end(), all.begin(), all.end());
+        }
+        else {
+            names.push_back(argument);
+        };
+    }
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+
+    TablebaseGenerator generator(directory);
+    generator.onTableFinished = [](const std::string& name, const TablebaseGenerator::Stats& stats) {
+        std::cout << name << ": " << stats.wins << " wins, " << stats.draws << " draws, " << stats.losses
+                  << " losses, longest mate " << stats.longestMate << " plies, " << stats.seconds << " s" << std::endl;
+    };
+    try {
+        for (const std::string& name : names) {
+            TablebaseMaterial material = TablebaseMaterial::fromName(name);
+            std::vector<unsigned char> existing;
+            if (TablebaseGenerator::readTable(directory, material, existing)) {
+                std::cout << material.name << ": already generated" << std::endl;
+                continue;
+            };
+            generator.generate(material.name);
+        }
+    }
+    catch (const std::exception& exception) {
+        std::cerr << exception.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
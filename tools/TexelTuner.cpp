@@ -0,0 +1,284 @@
+// Texel-style tuning of the evaluation weights (inc/EvalWeights.h) against labelled positions.
+// Usage: texelTuner <positions.bin>... [--output EvalWeights.h] [--epochs N] [--rate R] [--k K]
+//                   [--lambda L] [--threads N]
+// Positions come from selfPlay files and are reduced once to their evaluation terms, so every
+// epoch is a parallel pass over a compact array. The loss is the mean squared error between the
+// target and sigmoid(K * eval), where the target blends the game result with the recorded search
+// score by lambda (1 uses results only). K is fitted to the starting weights unless given.
+// Weights are stepped with Adam on the full-batch gradient and written out after every epoch.
+#include "../inc/Arguments.h"
+#include "../inc/Clock.h"
+#include "../inc/Eval.h"
+#include "../inc/PositionFile.h"
+#include "../inc/ThreadPool.h"
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+
+#define TUNER_PARAMETERS 71 // Five piece values, pawn chain, pawn stack, 64 knight squares.
+#define TUNER_MAX_KNIGHTS 8 // Positions with more knights are skipped.
+#define TUNER_ADAM_BETA1 0.9
+#define TUNER_ADAM_BETA2 0.999
+
+// One position reduced to its evaluation terms, 20 bytes.
+struct TuningEntry {
+    signed char linear[7]; // Material for pawn to queen, then pawn chains and pawn stacks.
+    unsigned char knightCount;
+    unsigned char knights[TUNER_MAX_KNIGHTS]; // As in EvalTerms.
+    unsigned char result; // Half points for white: 0, 1 or 2.
+    unsigned char padding;
+    short score; // Search score in centipawns for white.
+};
+
+static void weightsToParameters(const EvalWeights& weights, double* parameters) {
+    for (int i = 0; i < 5; i++) { parameters[i] = weights.pieceValues[i + 2]; }
+    parameters[5] = weights.pawnChain;
+    parameters[6] = weights.pawnStack;
+    for (int i = 0; i < 64; i++) { parameters[7 + i] = weights.knightSquares[i]; }
+}
+
+static void parametersToWeights(const double* parameters, EvalWeights& weights) {
+    for (int i = 0; i < 5; i++) { weights.pieceValues[i + 2] = (float)parameters[i]; }
+    weights.pawnChain = (float)parameters[5];
+    weights.pawnStack = (float)parameters[6];
+    for (int i = 0; i < 64; i++) { weights.knightSquares[i] = (float)parameters[7 + i]; }
+}
+
+static bool makeEntry(Board* board, const PackedPosition& packed, TuningEntry& entry) {
+    if (packed.result < 1 || packed.result > 3) { return false; };
+    try {
+        board->unpack(packed);
+    }
+    catch (const std::invalid_argument&) {
+        return false;
+    }
+    EvalTerms terms;
+    Eval::findEvalTerms(board, terms);
+    if (terms.knightCount > TUNER_MAX_KNIGHTS) { return false; };
+    for (int i = 0; i < 5; i++) { entry.linear[i] = (signed char)terms.material[i + 2]; }
+    entry.linear[5] = (signed char)terms.pawnChains;
+    entry.linear[6] = (signed char)terms.pawnStacks;
+    entry.knightCount = (unsigned char)terms.knightCount;
+    for (int i = 0; i < terms.knightCount; i++) { entry.knights[i] = terms.knights[i]; }
+    entry.result = (unsigned char)(3 - packed.result); // 1-0 => 2, draw => 1, 0-1 => 0.
+    entry.padding = 0;
+    entry.score = packed.score;
+    return true;
+}
+
+static double evaluateEntry(const TuningEntry& entry, const double* parameters) {
+    double score = 0;
+    for (int i = 0; i < 7; i++) { score += entry.linear[i] * parameters[i]; }
+    for (int i = 0; i < entry.knightCount; i++) {
+        double bonus = parameters[7 + (entry.knights[i] & 63)];
+        score += entry.knights[i] & 64 ? -bonus : bonus;
+    }
+    return score;
+}
+
+class Tuner {
+    public:
+        Tuner(ThreadPool& setPool) : pool(setPool) {};
+
+        bool load(const std::string& path) {
+            PositionReader reader;
+            if (!reader.open(path)) { return false; };
+            size_t chunks = (size_t)pool.size() * 4;
+            std::vector<std::vector<TuningEntry>> loaded(chunks);
+            for (size_t chunk = 0; chunk < chunks; chunk++) {
+                pool.submit([&, chunk](uint) {
+                    Board board;
+                    size_t begin = reader.size() * chunk / chunks;
+                    size_t end = reader.size() * (chunk + 1) / chunks;
+                    loaded[chunk].reserve(end - begin);
+                    TuningEntry entry;
+                    for (size_t i = begin; i < end; i++) {
+                        if (makeEntry(&board, reader[i], entry)) { loaded[chunk].push_back(entry); };
+                    }
+                });
+            }
+            pool.wait();
+            for (const std::vector<TuningEntry>& part : loaded) { entries.insert(entries.end(), part.begin(), part.end()); }
+            return true;
+        };
+
+        // Mean squared error; adds the gradient to gradient when it is not null.
+        double loss(const double* parameters, double k, double lambda, double* gradient) {
+            double scale = k * std::log(10.0) / 4; // Eval is in pawns: sigmoid = 1 / (1 + 10^(-k * eval / 4)).
+            size_t chunks = (size_t)pool.size() * 4;
+            std::vector<double> chunkLoss(chunks, 0);
+            std::vector<std::vector<double>> chunkGradient(chunks, std::vector<double>(gradient ? TUNER_PARAMETERS : 0, 0));
+            for (size_t chunk = 0; chunk < chunks; chunk++) {
+                pool.submit([&, chunk](uint) {
+                    size_t begin = entries.size() * chunk / chunks;
+                    size_t end = entries.size() * (chunk + 1) / chunks;
+                    double total = 0;
+                    double* partial = gradient ? chunkGradient[chunk].data() : nullptr;
+                    for (size_t i = begin; i < end; i++) {
+                        const TuningEntry& entry = entries[i];
+                        double target = entry.result * 0.5;
+                        if (lambda < 1) { target = lambda * target + (1 - lambda) / (1 + std::exp(-scale * entry.score / 100)); };
+                        double predicted = 1 / (1 + std::exp(-scale * evaluateEntry(entry, parameters)));
+                        double error = predicted - target;
+                        total += error * error;
+                        if (!partial) { continue; };
+                        // d(error^2)/d(eval); each parameter's slope is its term count.
+                        double slope = 2 * error * scale * predicted * (1 - predicted);
+                        for (int j = 0; j < 7; j++) { partial[j] += slope * entry.linear[j]; }
+                        for (int j = 0; j < entry.knightCount; j++) {
+                            partial[7 + (entry.knights[j] & 63)] += entry.knights[j] & 64 ? -slope : slope;
+                        }
+                    }
+                    chunkLoss[chunk] = total;
+                });
+            }
+            pool.wait();
+            double total = 0;
+            for (size_t chunk = 0; chunk < chunks; chunk++) {
+                total += chunkLoss[chunk];
+                if (!gradient) { continue; };
+                for (int j = 0; j < TUNER_PARAMETERS; j++) { gradient[j] += chunkGradient[chunk][j] / entries.size(); }
+            }
+            return total / entries.size();
+        };
+
+        // Golden section search for the K that best fits the results with the starting weights.
+        double fitK(const double* parameters) {
+            const double ratio = (std::sqrt(5.0) - 1) / 2;
+            double low = 0.05, high = 10;
+            double a = high - ratio * (high - low), b = low + ratio * (high - low);
+            double lossA = loss(parameters, a, 1, nullptr), lossB = loss(parameters, b, 1, nullptr);
+            while (high - low > 0.001) {
+                if (lossA < lossB) {
+                    high = b; b = a; lossB = lossA;
+                    a = high - ratio * (high - low);
+                    lossA = loss(parameters, a, 1, nullptr);
+                }
+                else {
+                    low = a; a = b; lossA = lossB;
+                    b = low + ratio * (high - low);
+                    lossB = loss(parameters, b, 1, nullptr);
+                };
+            }
+            return (low + high) / 2;
+        };
+
+        std::vector<TuningEntry> entries;
+
+    private:
+        ThreadPool& pool;
+};
+
+static bool writeWeights(const std::string& path, const EvalWeights& weights) {
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream output(temporary);
+        if (!output) { return false; };
+        output << std::fixed << std::setprecision(3);
+        output << "#pragma once\n\n";
+        output << "// Evaluation weights in pawns. This file is written by the texelTuner tool; edit it by hand only\n";
+        output << "// to seed a new tuning run.\n";
+        output << "struct EvalWeights {\n";
+        output << "    float pieceValues[7] = {";
+        for (int i = 0; i < 7; i++) { output << (i ? ", " : "") << weights.pieceValues[i] << "f"; }
+        output << "}; // Indexed like Eval::PIECEVALUES.\n";
+        output << "    float pawnChain = " << weights.pawnChain << "f; // Per pawn defended by a friendly pawn.\n";
+        output << "    float pawnStack = " << weights.pawnStack << "f; // Per pawn with a friendly pawn behind it on the same file.\n";
+        output << "    float knightSquares[64] = { // Added to a knight's value, indexed from its owner's side of the board.\n";
+        for (int rank = 0; rank < 8; rank++) {
+            output << "       ";
+            for (int file = 0; file < 8; file++) { output << " " << weights.knightSquares[rank * 8 + file] << "f,"; }
+            output << "\n";
+        }
+        output << "    };\n};\n";
+        if (!output) { return false; };
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+static const char* USAGE = "usage: texelTuner <positions.bin>... [--output EvalWeights.h] [--epochs N] [--rate R] [--k K] [--lambda L] [--threads N]";
+
+int main(int argc, char** argv) {
+    std::vector<std::string> inputs;
+    std::string outputPath = "EvalWeights.h";
+    uint epochs = 100;
+    double rate = 0.01;
+    double k = 0;
+    double lambda = 1;
+    uint threads = ThreadPool::defaultThreadCount();
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option.compare(0, 2, "--") != 0) { inputs.push_back(option); continue; };
+        if (i + 1 >= argc) {
+            std::cerr << "missing value for " << option << std::endl << USAGE << std::endl;
+            return 1;
+        };
+        const char* value = argv[++i];
+        bool valid = true;
+        if (option == "--output") { outputPath = value; }
+        else if (option == "--epochs") { valid = parseCount(value, epochs); }
+        else if (option == "--rate") { valid = parseDecimal(value, rate) && rate > 0; }
+        else if (option == "--k") { valid = parseDecimal(value, k) && k >= 0; }
+        else if (option == "--lambda") { valid = parseDecimal(value, lambda) && lambda >= 0 && lambda <= 1; }
+        else if (option == "--threads") { valid = parseCount(value, threads); }
+        else {
+            std::cerr << "unknown option " << option << std::endl << USAGE << std::endl;
+            return 1;
+        };
+        if (!valid) {
+            std::cerr << "bad value " << value << " for " << option << std::endl << USAGE << std::endl;
+            return 1;
+        };
+    }
+    if (inputs.empty()) {
+        std::cerr << USAGE << std::endl;
+        return 1;
+    };
+
+    ThreadPool pool(threads);
+    Tuner tuner(pool);
+    u64 startTime = steadyClockNanoseconds();
+    for (const std::string& input : inputs) {
+        if (!tuner.load(input)) {
+            std::cerr << "cannot read position file " << input << std::endl;
+            return 1;
+        };
+    }
+    if (tuner.entries.empty()) {
+        std::cerr << "no labelled positions" << std::endl;
+        return 1;
+    };
+    double seconds = secondsSince(startTime);
+    std::cerr << "loaded " << tuner.entries.size() << " positions (" << tuner.entries.size() * sizeof(TuningEntry) / (1 << 20)
+              << " MB) in " << seconds << "s" << std::endl;
+
+    double parameters[TUNER_PARAMETERS];
+    weightsToParameters(EvalWeights(), parameters);
+    if (k <= 0) { k = tuner.fitK(parameters); };
+    std::cerr << "K = " << k << ", starting loss " << tuner.loss(parameters, k, lambda, nullptr) << std::endl;
+
+    double moment[TUNER_PARAMETERS] = {};
+    double velocity[TUNER_PARAMETERS] = {};
+    EvalWeights weights;
+    for (uint epoch = 1; epoch <= epochs; epoch++) {
+        u64 epochStart = steadyClockNanoseconds();
+        double gradient[TUNER_PARAMETERS] = {};
+        double loss = tuner.loss(parameters, k, lambda, gradient);
+        for (int j = 0; j < TUNER_PARAMETERS; j++) {
+            moment[j] = TUNER_ADAM_BETA1 * moment[j] + (1 - TUNER_ADAM_BETA1) * gradient[j];
+            velocity[j] = TUNER_ADAM_BETA2 * velocity[j] + (1 - TUNER_ADAM_BETA2) * gradient[j] * gradient[j];
+            double corrected = moment[j] / (1 - std::pow(TUNER_ADAM_BETA1, epoch));
+            double spread = velocity[j] / (1 - std::pow(TUNER_ADAM_BETA2, epoch));
+            parameters[j] -= rate * corrected / (std::sqrt(spread) + 1e-8);
+        }
+        parametersToWeights(parameters, weights);
+        if (!writeWeights(outputPath, weights)) {
+            std::cerr << "cannot write " << outputPath << std::endl;
+            return 1;
+        };
+        double epochSeconds = secondsSince(epochStart);
+        std::cerr << "epoch " << epoch << " loss " << std::setprecision(8) << loss << " (" << std::setprecision(3) << epochSeconds << "s)" << std::endl;
+    }
+    std::cerr << "final loss " << std::setprecision(8) << tuner.loss(parameters, k, lambda, nullptr) << ", weights in " << outputPath << std::endl;
+    return 0;
+}